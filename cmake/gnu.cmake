@@ -23,3 +23,11 @@ SET(CMAKE_SHARED_LINKER_FLAGS "${CMAKE_SHARED_LINKER_FLAGS} -z relro -z now")
 SET(CMAKE_EXE_LINKER_FLAGS "${CMAKE_EXE_LINKER_FLAGS} -z noexecstack")           # we do not need an executable stack
 SET(CMAKE_EXE_LINKER_FLAGS "${CMAKE_EXE_LINKER_FLAGS} -z relro -z now")          # re-arranges data sections to increase security
 SET(CMAKE_EXE_LINKER_FLAGS "${CMAKE_EXE_LINKER_FLAGS} -pie")                       # enables position independent execution for executable
+
+SET(FLAGS_AVX2 "")                                                     # flags for kernels selected at runtime on AVX2 CPUs
+SET(FLAGS_AVX2 "${FLAGS_AVX2} -mavx2 -mfma")                           # enables AVX2 and FMA instructions
+SET(FLAGS_AVX2 "${FLAGS_AVX2} -mlzcnt -mbmi -mbmi2 -mf16c")            # enables the bit manipulation and half float conversion instructions of AVX2 CPUs
+
+SET(FLAGS_AVX512 "${FLAGS_AVX2}")                                      # flags for kernels selected at runtime on AVX-512 CPUs
+SET(FLAGS_AVX512 "${FLAGS_AVX512} -mavx512f -mavx512cd")               # enables the AVX-512 foundation and conflict detection instructions
+SET(FLAGS_AVX512 "${FLAGS_AVX512} -mavx512dq -mavx512bw -mavx512vl")   # enables the AVX-512 instructions of Skylake server CPUs
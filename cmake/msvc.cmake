@@ -12,3 +12,9 @@ ENDIF()
 
 SET(CMAKE_EXE_LINKER_FLAGS "${CMAKE_EXE_LINKER_FLAGS} ${SECURE_LINKER_FLAGS}")
 SET(CMAKE_SHARED_LINKER_FLAGS "${CMAKE_SHARED_LINKER_FLAGS} ${SECURE_LINKER_FLAGS}")
+
+SET(FLAGS_AVX2 "")                                # flags for kernels selected at runtime on AVX2 CPUs
+SET(FLAGS_AVX2 "${FLAGS_AVX2} /arch:AVX2")        # enables AVX2 and FMA instructions
+
+SET(FLAGS_AVX512 "")                              # flags for kernels selected at runtime on AVX-512 CPUs
+SET(FLAGS_AVX512 "${FLAGS_AVX512} /arch:AVX512")  # enables the AVX-512 instructions of Skylake server CPUs
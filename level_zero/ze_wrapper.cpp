@@ -47,11 +47,14 @@ static decltype(zeRTASBuilderDestroyExp)* zeRTASBuilderDestroyExpInternal = null
 static decltype(zeDriverRTASFormatCompatibilityCheckExp)* zeDriverRTASFormatCompatibilityCheckExpInternal = nullptr;
 static decltype(zeRTASBuilderGetBuildPropertiesExp)* zeRTASBuilderGetBuildPropertiesExpInternal = nullptr;
 static decltype(zeRTASBuilderBuildExp)* zeRTASBuilderBuildExpInternal = nullptr;
+static decltype(zeRTASBuilderBuildBatchExpImpl)* zeRTASBuilderBuildBatchExpInternal = nullptr;
+static decltype(zeRTASRelocateExpImpl)* zeRTASRelocateExpInternal = nullptr;
   
 static decltype(zeRTASParallelOperationCreateExp)* zeRTASParallelOperationCreateExpInternal = nullptr;
 static decltype(zeRTASParallelOperationDestroyExp)* zeRTASParallelOperationDestroyExpInternal = nullptr; 
 static decltype(zeRTASParallelOperationGetPropertiesExp)* zeRTASParallelOperationGetPropertiesExpInternal = nullptr;
 static decltype(zeRTASParallelOperationJoinExp)* zeRTASParallelOperationJoinExpInternal = nullptr;
+static decltype(zeRTASBuilderSetThreadCountImpl)* zeRTASBuilderSetThreadCountInternal = nullptr;
 
 /* EXT version of API */
 static decltype(zeRTASBuilderCreateExt)* zeRTASBuilderCreateExtInternal = nullptr;
@@ -59,6 +62,8 @@ static decltype(zeRTASBuilderDestroyExt)* zeRTASBuilderDestroyExtInternal = null
 static decltype(zeDriverRTASFormatCompatibilityCheckExt)* zeDriverRTASFormatCompatibilityCheckExtInternal = nullptr;
 static decltype(zeRTASBuilderGetBuildPropertiesExt)* zeRTASBuilderGetBuildPropertiesExtInternal = nullptr;
 static decltype(zeRTASBuilderBuildExt)* zeRTASBuilderBuildExtInternal = nullptr;
+static decltype(zeRTASBuilderBuildBatchExtImpl)* zeRTASBuilderBuildBatchExtInternal = nullptr;
+static decltype(zeRTASRelocateExtImpl)* zeRTASRelocateExtInternal = nullptr;
 static decltype(zeRTASBuilderCommandListAppendCopyExt)* zeRTASBuilderCommandListAppendCopyExtInternal = nullptr;
   
 static decltype(zeRTASParallelOperationCreateExt)* zeRTASParallelOperationCreateExtInternal = nullptr;
@@ -133,6 +138,9 @@ ze_result_t selectLevelZeroRTASBuilderExp(ze_driver_handle_t hDriver)
   zeDriverRTASFormatCompatibilityCheckExpInternal = find_symbol<decltype(zeDriverRTASFormatCompatibilityCheckExp)*>(handle,"zeDriverRTASFormatCompatibilityCheckExp");
   zeRTASBuilderGetBuildPropertiesExpInternal = find_symbol<decltype(zeRTASBuilderGetBuildPropertiesExp)*>(handle,"zeRTASBuilderGetBuildPropertiesExp");
   zeRTASBuilderBuildExpInternal = find_symbol<decltype(zeRTASBuilderBuildExp)*>(handle,"zeRTASBuilderBuildExp");
+  zeRTASBuilderBuildBatchExpInternal = nullptr; // not provided by Level Zero
+  zeRTASRelocateExpInternal = nullptr;
+  zeRTASBuilderSetThreadCountInternal = nullptr;
   
   zeRTASParallelOperationCreateExpInternal = find_symbol<decltype(zeRTASParallelOperationCreateExp)*>(handle,"zeRTASParallelOperationCreateExp");
   zeRTASParallelOperationDestroyExpInternal = find_symbol<decltype(zeRTASParallelOperationDestroyExp)*>(handle,"zeRTASParallelOperationDestroyExp");
@@ -168,6 +176,9 @@ ze_result_t selectLevelZeroRTASBuilderExt(ze_driver_handle_t hDriver)
   zeDriverRTASFormatCompatibilityCheckExtInternal = find_symbol<decltype(zeDriverRTASFormatCompatibilityCheckExt)*>(handle,"zeDriverRTASFormatCompatibilityCheckExt");
   zeRTASBuilderGetBuildPropertiesExtInternal = find_symbol<decltype(zeRTASBuilderGetBuildPropertiesExt)*>(handle,"zeRTASBuilderGetBuildPropertiesExt");
   zeRTASBuilderBuildExtInternal = find_symbol<decltype(zeRTASBuilderBuildExt)*>(handle,"zeRTASBuilderBuildExt");
+  zeRTASBuilderBuildBatchExtInternal = nullptr; // not provided by Level Zero
+  zeRTASRelocateExtInternal = nullptr;
+  zeRTASBuilderSetThreadCountInternal = nullptr;
   zeRTASBuilderCommandListAppendCopyExtInternal = find_symbol<decltype(zeRTASBuilderCommandListAppendCopyExt)*>(handle,"zeRTASBuilderCommandListAppendCopyExt");
   
   zeRTASParallelOperationCreateExtInternal = find_symbol<decltype(zeRTASParallelOperationCreateExt)*>(handle,"zeRTASParallelOperationCreateExt");
@@ -201,6 +212,8 @@ ze_result_t selectInternalRTASBuilder()
   zeDriverRTASFormatCompatibilityCheckExpInternal = &zeDriverRTASFormatCompatibilityCheckExpImpl;
   zeRTASBuilderGetBuildPropertiesExpInternal = &zeRTASBuilderGetBuildPropertiesExpImpl;
   zeRTASBuilderBuildExpInternal = &zeRTASBuilderBuildExpImpl;
+  zeRTASBuilderBuildBatchExpInternal = &zeRTASBuilderBuildBatchExpImpl;
+  zeRTASRelocateExpInternal = &zeRTASRelocateExpImpl;
   
   zeRTASParallelOperationCreateExpInternal = &zeRTASParallelOperationCreateExpImpl;
   zeRTASParallelOperationDestroyExpInternal = &zeRTASParallelOperationDestroyExpImpl;
@@ -212,12 +225,16 @@ ze_result_t selectInternalRTASBuilder()
   zeDriverRTASFormatCompatibilityCheckExtInternal = &zeDriverRTASFormatCompatibilityCheckExtImpl;
   zeRTASBuilderGetBuildPropertiesExtInternal = &zeRTASBuilderGetBuildPropertiesExtImpl;
   zeRTASBuilderBuildExtInternal = &zeRTASBuilderBuildExtImpl;
+  zeRTASBuilderBuildBatchExtInternal = &zeRTASBuilderBuildBatchExtImpl;
+  zeRTASRelocateExtInternal = &zeRTASRelocateExtImpl;
   
   zeRTASParallelOperationCreateExtInternal = &zeRTASParallelOperationCreateExtImpl;
   zeRTASParallelOperationDestroyExtInternal = &zeRTASParallelOperationDestroyExtImpl;
   zeRTASParallelOperationGetPropertiesExtInternal = &zeRTASParallelOperationGetPropertiesExtImpl;
   zeRTASParallelOperationJoinExtInternal = &zeRTASParallelOperationJoinExtImpl;
 
+  zeRTASBuilderSetThreadCountInternal = &zeRTASBuilderSetThreadCountImpl;
+
   ZeWrapper::rtas_builder = ZeWrapper::INTERNAL;
 #endif
   return ZE_RESULT_SUCCESS;
@@ -530,6 +547,32 @@ ze_result_t ZeWrapper::zeRTASBuilderBuildExp(ze_rtas_builder_exp_handle_t hBuild
                                        hParallelOperation, pBuildUserPtr, pBounds, pRtasBufferSizeBytes);
 }
 
+ze_result_t ZeWrapper::zeRTASBuilderBuildBatchExp(ze_rtas_builder_exp_handle_t hBuilder,
+                                                  uint32_t numBuildOps, ze_rtas_builder_batch_build_op_exp_t* pBuildOps,
+                                                  ze_rtas_parallel_operation_exp_handle_t hParallelOperation)
+{
+  if (!handle)
+    throw std::runtime_error("ZeWrapper not initialized, call ZeWrapper::init() first.");
+
+  if (!zeRTASBuilderBuildBatchExpInternal)
+    return ZE_RESULT_ERROR_UNSUPPORTED_FEATURE;
+  
+  return zeRTASBuilderBuildBatchExpInternal(hBuilder, numBuildOps, pBuildOps, hParallelOperation);
+}
+
+ze_result_t ZeWrapper::zeRTASRelocateExp(void* pRtasBuffer, size_t rtasBufferSizeBytes,
+                                         uint32_t numRelocations, const ze_rtas_relocation_exp_t* pRelocations,
+                                         void* dispatchGlobalsPtr)
+{
+  if (!handle)
+    throw std::runtime_error("ZeWrapper not initialized, call ZeWrapper::init() first.");
+
+  if (!zeRTASRelocateExpInternal)
+    return ZE_RESULT_ERROR_UNSUPPORTED_FEATURE;
+  
+  return zeRTASRelocateExpInternal(pRtasBuffer, rtasBufferSizeBytes, numRelocations, pRelocations, dispatchGlobalsPtr);
+}
+
 ze_result_t ZeWrapper::zeRTASBuilderCommandListAppendCopyExp(ze_command_list_handle_t hCommandList,
                                                              void* dstptr,
                                                              const void* srcptr,
@@ -661,6 +704,32 @@ ze_result_t ZeWrapper::zeRTASBuilderBuildExt(ze_rtas_builder_ext_handle_t hBuild
                                        hParallelOperation, pBuildUserPtr, pBounds, pRtasBufferSizeBytes);
 }
 
+ze_result_t ZeWrapper::zeRTASBuilderBuildBatchExt(ze_rtas_builder_ext_handle_t hBuilder,
+                                                  uint32_t numBuildOps, ze_rtas_builder_batch_build_op_ext_t* pBuildOps,
+                                                  ze_rtas_parallel_operation_ext_handle_t hParallelOperation)
+{
+  if (!handle)
+    throw std::runtime_error("ZeWrapper not initialized, call ZeWrapper::init() first.");
+
+  if (!zeRTASBuilderBuildBatchExtInternal)
+    return ZE_RESULT_ERROR_UNSUPPORTED_FEATURE;
+  
+  return zeRTASBuilderBuildBatchExtInternal(hBuilder, numBuildOps, pBuildOps, hParallelOperation);
+}
+
+ze_result_t ZeWrapper::zeRTASRelocateExt(void* pRtasBuffer, size_t rtasBufferSizeBytes,
+                                         uint32_t numRelocations, const ze_rtas_relocation_ext_t* pRelocations,
+                                         void* dispatchGlobalsPtr)
+{
+  if (!handle)
+    throw std::runtime_error("ZeWrapper not initialized, call ZeWrapper::init() first.");
+
+  if (!zeRTASRelocateExtInternal)
+    return ZE_RESULT_ERROR_UNSUPPORTED_FEATURE;
+  
+  return zeRTASRelocateExtInternal(pRtasBuffer, rtasBufferSizeBytes, numRelocations, pRelocations, dispatchGlobalsPtr);
+}
+
 ze_result_t ZeWrapper::zeRTASBuilderCommandListAppendCopyExt(ze_command_list_handle_t hCommandList,
                                                              void* dstptr,
                                                              const void* srcptr,
@@ -706,3 +775,14 @@ ze_result_t ZeWrapper::zeRTASParallelOperationJoinExt( ze_rtas_parallel_operatio
   
   return zeRTASParallelOperationJoinExtInternal(hParallelOperation);
 }
+
+ze_result_t ZeWrapper::zeRTASBuilderSetThreadCount(uint32_t numThreads)
+{
+  if (!handle)
+    throw std::runtime_error("ZeWrapper not initialized, call ZeWrapper::init() first.");
+
+  if (!zeRTASBuilderSetThreadCountInternal)
+    return ZE_RESULT_ERROR_UNSUPPORTED_FEATURE;
+  
+  return zeRTASBuilderSetThreadCountInternal(numThreads);
+}
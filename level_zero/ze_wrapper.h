@@ -25,6 +25,244 @@ typedef struct _ze_rtas_builder_build_op_debug_desc_t
   
 } ze_rtas_builder_build_op_debug_desc_t;
 
+//////////////////////
+// Update extension
+
+#define ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_UPDATE_DESC ((ze_structure_type_t)0x00020F00)  ///< ::ze_rtas_builder_build_op_update_desc_t
+
+/* Chaining this structure to the build operation descriptor refits
+ * the acceleration structure stored in pRtasBuffer in place, instead
+ * of building a new one. The acceleration structure has to be built
+ * before from the same triangle and quad geometries with unchanged
+ * index buffers, only vertex positions may change. If a leaf does not
+ * match the geometries or contains invalid vertices, the acceleration
+ * structure is left unmodified and ZE_RESULT_ERROR_INVALID_ARGUMENT is
+ * returned. */
+
+typedef struct _ze_rtas_builder_build_op_update_desc_t
+{
+  ze_structure_type_t stype;                                              ///< [in] type of this structure
+  const void* pNext;                                                      ///< [in][optional] must be null or a pointer to an extension-specific
+                                                                          ///< structure (i.e. contains stype and pNext).
+} ze_rtas_builder_build_op_update_desc_t;
+
+//////////////////////
+// Measure extension
+
+#define ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_MEASURE_DESC ((ze_structure_type_t)0x00020F01)  ///< ::ze_rtas_builder_build_op_measure_desc_t
+
+/* Chaining this structure to the build operation descriptor performs
+ * a measure build, which runs the full topology build without
+ * writing the acceleration structure. The pRtasBuffer may be null
+ * and the exact acceleration structure size is returned in
+ * pRtasBufferSizeBytes. The scratch buffer content is kept together
+ * with a hash of the geometry content and buffer addresses, thus a
+ * following build with the same inputs and scratch buffer and an
+ * acceleration structure buffer of the returned size never returns
+ * ZE_RESULT_EXP_RTAS_BUILD_RETRY. Procedural geometries cannot get
+ * hashed, builds containing them start from scratch and the returned
+ * size is only an estimate. If the scratch buffer is smaller
+ * than the size reported by zeRTASBuilderGetBuildPropertiesExp the
+ * returned size may be inexact for high quality builds. */
+
+typedef struct _ze_rtas_builder_build_op_measure_desc_t
+{
+  ze_structure_type_t stype;                                              ///< [in] type of this structure
+  const void* pNext;                                                      ///< [in][optional] must be null or a pointer to an extension-specific
+                                                                          ///< structure (i.e. contains stype and pNext).
+} ze_rtas_builder_build_op_measure_desc_t;
+
+//////////////////////
+// Statistics extension
+
+#define ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_STATS_DESC ((ze_structure_type_t)0x00020F02)  ///< ::ze_rtas_builder_build_op_stats_desc_t
+
+/* Chaining this structure to the build operation descriptor returns
+ * timings and counters of the build. All output members are written
+ * by every build, phases that did not run report zero. A build that
+ * resumes from the scratch buffer content of a previous build skips
+ * the primitive reference creation, in this case only the hierarchy
+ * build timings are reported. */
+
+typedef struct _ze_rtas_builder_build_op_stats_desc_t
+{
+  ze_structure_type_t stype;                                              ///< [in] type of this structure
+  const void* pNext;                                                      ///< [in][optional] must be null or a pointer to an extension-specific
+                                                                          ///< structure (i.e. contains stype and pNext).
+  uint64_t quadificationNs;                                               ///< [out] time spent pairing triangles to quads
+  uint64_t primRefGenNs;                                                  ///< [out] time spent creating primitive references
+  uint64_t primRefCompactNs;                                              ///< [out] time spent compacting primitive references after invalid ones got filtered
+  uint64_t presplitNs;                                                    ///< [out] time spent presplitting primitives
+  uint64_t bvhBuildNs;                                                    ///< [out] time spent building the hierarchy
+  uint64_t optimizeNs;                                                    ///< [out] time spent optimizing the hierarchy
+  uint64_t layoutNs;                                                      ///< [out] time spent reordering the acceleration structure memory
+  uint64_t cacheNs;                                                       ///< [out] time spent hashing the inputs and accessing the RTAS cache
+  uint64_t totalNs;                                                       ///< [out] total build time
+  uint64_t numPrimitives;                                                 ///< [out] number of primitive references before presplitting
+  uint64_t numPrimRefs;                                                   ///< [out] number of primitive references after presplitting
+  uint64_t numSpatialSplits;                                              ///< [out] number of primitive references spatial splits added during the hierarchy build
+  uint64_t numQuadPairs;                                                  ///< [out] number of triangle pairs merged into a quad
+  uint64_t rtasBytesAllocated;                                            ///< [out] bytes used in the acceleration structure buffer
+  uint64_t rtasBytesUnused;                                               ///< [out] bytes of rtasBytesAllocated left unused at the end of per-thread allocation blocks
+  double sahBefore;                                                       ///< [out] SAH cost of the hierarchy before the treelet optimization of high quality builds
+  double sahAfter;                                                        ///< [out] SAH cost of the hierarchy after the treelet optimization of high quality builds
+  ze_bool_t compacted;                                                    ///< [out] primitive references got compacted as invalid primitives got filtered
+  ze_bool_t resumed;                                                      ///< [out] build continued from the scratch buffer of a previous build
+  ze_bool_t cacheHit;                                                     ///< [out] acceleration structure got loaded from the RTAS cache
+} ze_rtas_builder_build_op_stats_desc_t;
+
+//////////////////////
+// Layout extension
+
+#define ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_LAYOUT_DESC ((ze_structure_type_t)0x00020F03)  ///< ::ze_rtas_builder_build_op_layout_desc_t
+
+/* Order of the nodes and leaves in the acceleration structure
+ * buffer. By default they are stored in the order the parallel build
+ * allocated them, thus siblings of different subtrees can interleave
+ * and the order can change from build to build. */
+
+typedef enum _ze_rtas_builder_layout_exp_t
+{
+  ZE_RTAS_BUILDER_LAYOUT_EXP_DEFAULT = 0,                                 ///< allocation order of the build
+  ZE_RTAS_BUILDER_LAYOUT_EXP_DEPTH_FIRST = 1,                             ///< each subtree is stored contiguously in depth first order
+  ZE_RTAS_BUILDER_LAYOUT_EXP_PAGE_CLUSTERED = 2,                          ///< the top of each subtree fills a 4kB page, followed by the subtrees below
+  ZE_RTAS_BUILDER_LAYOUT_EXP_FORCE_UINT32 = 0x7fffffff
+} ze_rtas_builder_layout_exp_t;
+
+typedef ze_rtas_builder_layout_exp_t ze_rtas_builder_layout_ext_t;
+#define ZE_RTAS_BUILDER_LAYOUT_EXT_DEFAULT ZE_RTAS_BUILDER_LAYOUT_EXP_DEFAULT
+#define ZE_RTAS_BUILDER_LAYOUT_EXT_DEPTH_FIRST ZE_RTAS_BUILDER_LAYOUT_EXP_DEPTH_FIRST
+#define ZE_RTAS_BUILDER_LAYOUT_EXT_PAGE_CLUSTERED ZE_RTAS_BUILDER_LAYOUT_EXP_PAGE_CLUSTERED
+
+/* Chaining this structure to the build operation descriptor selects
+ * the layout of the acceleration structure. All layouts except the
+ * default one are deterministic and need a temporary host copy of
+ * the acceleration structure. */
+
+typedef struct _ze_rtas_builder_build_op_layout_desc_t
+{
+  ze_structure_type_t stype;                                              ///< [in] type of this structure
+  const void* pNext;                                                      ///< [in][optional] must be null or a pointer to an extension-specific
+                                                                          ///< structure (i.e. contains stype and pNext).
+  ze_rtas_builder_layout_exp_t layout;                                    ///< [in] order of nodes and leaves in the acceleration structure
+} ze_rtas_builder_build_op_layout_desc_t;
+
+//////////////////////
+// Deterministic extension
+
+#define ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_DETERMINISTIC_DESC ((ze_structure_type_t)0x00020F04)  ///< ::ze_rtas_builder_build_op_deterministic_desc_t
+
+/* Chaining this structure to the build operation descriptor makes
+ * the content and size of the acceleration structure only depend on
+ * the build inputs and options, independent of the number of threads
+ * and their scheduling. Such acceleration structures can get
+ * compared and deduplicated by hashing their bytes. Unless a layout
+ * is selected with ::ze_rtas_builder_build_op_layout_desc_t the
+ * depth first layout is used. */
+
+typedef struct _ze_rtas_builder_build_op_deterministic_desc_t
+{
+  ze_structure_type_t stype;                                              ///< [in] type of this structure
+  const void* pNext;                                                      ///< [in][optional] must be null or a pointer to an extension-specific
+                                                                          ///< structure (i.e. contains stype and pNext).
+} ze_rtas_builder_build_op_deterministic_desc_t;
+
+//////////////////////
+// Cache extension
+
+#define ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_CACHE_DESC ((ze_structure_type_t)0x00020F05)  ///< ::ze_rtas_builder_build_op_cache_desc_t
+
+/* Chaining this structure to the build operation descriptor stores
+ * the built acceleration structure in a directory, keyed by a hash of
+ * the geometry descriptors, the vertex and index data, and the build
+ * options. A later build with the same key copies the stored bytes
+ * into the acceleration structure buffer instead of building. The
+ * directory has to exist and can be shared by multiple processes.
+ * Builds with procedural geometries are never cached, as their
+ * bounds are provided by callbacks. Instances are keyed by the
+ * address of the instanced acceleration structure, thus entries of
+ * instance builds only hit while those stay at the same address.
+ * High quality builds copy nodes of the instantiated acceleration
+ * structures into the built one, thus such builds of instances are
+ * never cached. The keys include the library version and build id, thus entries
+ * written by other builds of the library are never loaded. */
+
+typedef struct _ze_rtas_builder_build_op_cache_desc_t
+{
+  ze_structure_type_t stype;                                              ///< [in] type of this structure
+  const void* pNext;                                                      ///< [in][optional] must be null or a pointer to an extension-specific
+                                                                          ///< structure (i.e. contains stype and pNext).
+  const char* pCacheDirectory;                                            ///< [in] directory of the cache files
+} ze_rtas_builder_build_op_cache_desc_t;
+
+//////////////////////
+// Presplit properties extension
+
+#define ZE_STRUCTURE_TYPE_RTAS_BUILDER_PRESPLIT_PROPERTIES ((ze_structure_type_t)0x00020F06)  ///< ::ze_rtas_builder_presplit_properties_t
+
+/* Chaining this structure to the properties returned by
+ * zeRTASBuilderGetBuildPropertiesExp returns the presplit budget the
+ * buffer sizes got computed for. High quality builds split large
+ * primitives into multiple primitive references, the budget of
+ * triangles and quads depends on how much of their bounds is empty
+ * space and gets estimated from a sample of the primitives. If the
+ * geometry data is not set yet, the maximal budget is reported. */
+
+typedef struct _ze_rtas_builder_presplit_properties_t
+{
+  ze_structure_type_t stype;                                              ///< [in] type of this structure
+  void* pNext;                                                            ///< [in,out][optional] must be null or a pointer to an extension-specific
+                                                                          ///< structure (i.e. contains stype and pNext).
+  uint64_t presplitBudget;                                                ///< [out] number of primitive references presplitting may add to the input primitives, zero if the build does not presplit
+} ze_rtas_builder_presplit_properties_t;
+
+//////////////////////
+// Batch build extension
+
+/* Describes one build of a batch build. The members correspond to the
+ * arguments of zeRTASBuilderBuildExp, the result of the build is
+ * returned in the result member. */
+typedef struct _ze_rtas_builder_batch_build_op_exp_t
+{
+  const ze_rtas_builder_build_op_exp_desc_t* pBuildOpDescriptor;  ///< [in] build operation descriptor
+  void* pScratchBuffer;                                            ///< [in] scratch buffer of the build
+  size_t scratchBufferSizeBytes;                                   ///< [in] size of the scratch buffer in bytes
+  void* pRtasBuffer;                                               ///< [in] acceleration structure buffer
+  size_t rtasBufferSizeBytes;                                      ///< [in] size of the acceleration structure buffer in bytes
+  void* pBuildUserPtr;                                             ///< [in][optional] pointer passed to callbacks
+  ze_rtas_aabb_exp_t* pBounds;                                     ///< [in,out][optional] returned bounds of the acceleration structure
+  size_t* pRtasBufferSizeBytes;                                    ///< [in,out][optional] returned acceleration structure size
+  ze_result_t result;                                              ///< [out] result of this build
+} ze_rtas_builder_batch_build_op_exp_t;
+
+typedef struct _ze_rtas_builder_batch_build_op_ext_t
+{
+  const ze_rtas_builder_build_op_ext_desc_t* pBuildOpDescriptor;  ///< [in] build operation descriptor
+  void* pScratchBuffer;                                            ///< [in] scratch buffer of the build
+  size_t scratchBufferSizeBytes;                                   ///< [in] size of the scratch buffer in bytes
+  void* pRtasBuffer;                                               ///< [in] acceleration structure buffer
+  size_t rtasBufferSizeBytes;                                      ///< [in] size of the acceleration structure buffer in bytes
+  void* pBuildUserPtr;                                             ///< [in][optional] pointer passed to callbacks
+  ze_rtas_aabb_ext_t* pBounds;                                     ///< [in,out][optional] returned bounds of the acceleration structure
+  size_t* pRtasBufferSizeBytes;                                    ///< [in,out][optional] returned acceleration structure size
+  ze_result_t result;                                              ///< [out] result of this build
+} ze_rtas_builder_batch_build_op_ext_t;
+
+//////////////////////
+// Relocation extension
+
+/* Describes the move of an instantiated acceleration structure from
+ * the address it had when an acceleration structure instantiating it
+ * got built, to its current address. */
+typedef struct _ze_rtas_relocation_exp_t
+{
+  const void* pOldRtasBuffer;                                      ///< [in] address of the instantiated acceleration structure during the build
+  void* pNewRtasBuffer;                                            ///< [in] current address of the instantiated acceleration structure
+  size_t rtasBufferSizeBytes;                                      ///< [in] size of the instantiated acceleration structure in bytes
+} ze_rtas_relocation_exp_t;
+
+typedef ze_rtas_relocation_exp_t ze_rtas_relocation_ext_t;
+
 ////////////////////
 
 struct ZeWrapper
@@ -67,6 +305,16 @@ struct ZeWrapper
                                            ze_rtas_parallel_operation_exp_handle_t hParallelOperation,
                                            void *pBuildUserPtr, ze_rtas_aabb_exp_t *pBounds, size_t *pRtasBufferSizeBytes);
 
+  /* only supported by the internal builder, returns ZE_RESULT_ERROR_UNSUPPORTED_FEATURE otherwise */
+  static ze_result_t zeRTASBuilderBuildBatchExp(ze_rtas_builder_exp_handle_t hBuilder,
+                                                uint32_t numBuildOps, ze_rtas_builder_batch_build_op_exp_t* pBuildOps,
+                                                ze_rtas_parallel_operation_exp_handle_t hParallelOperation);
+
+  /* only supported by the internal builder, returns ZE_RESULT_ERROR_UNSUPPORTED_FEATURE otherwise */
+  static ze_result_t zeRTASRelocateExp(void* pRtasBuffer, size_t rtasBufferSizeBytes,
+                                       uint32_t numRelocations, const ze_rtas_relocation_exp_t* pRelocations,
+                                       void* dispatchGlobalsPtr);
+
   static ze_result_t zeRTASBuilderCommandListAppendCopyExp(ze_command_list_handle_t hCommandList,
                                                            void* dstptr,
                                                            const void* srcptr,
@@ -96,6 +344,16 @@ struct ZeWrapper
                                            ze_rtas_parallel_operation_ext_handle_t hParallelOperation,
                                            void *pBuildUserPtr, ze_rtas_aabb_ext_t *pBounds, size_t *pRtasBufferSizeBytes);
 
+  /* only supported by the internal builder, returns ZE_RESULT_ERROR_UNSUPPORTED_FEATURE otherwise */
+  static ze_result_t zeRTASBuilderBuildBatchExt(ze_rtas_builder_ext_handle_t hBuilder,
+                                                uint32_t numBuildOps, ze_rtas_builder_batch_build_op_ext_t* pBuildOps,
+                                                ze_rtas_parallel_operation_ext_handle_t hParallelOperation);
+
+  /* only supported by the internal builder, returns ZE_RESULT_ERROR_UNSUPPORTED_FEATURE otherwise */
+  static ze_result_t zeRTASRelocateExt(void* pRtasBuffer, size_t rtasBufferSizeBytes,
+                                       uint32_t numRelocations, const ze_rtas_relocation_ext_t* pRelocations,
+                                       void* dispatchGlobalsPtr);
+
   static ze_result_t zeRTASBuilderCommandListAppendCopyExt(ze_command_list_handle_t hCommandList,
                                                            void* dstptr,
                                                            const void* srcptr,
@@ -109,6 +367,10 @@ struct ZeWrapper
   static ze_result_t zeRTASParallelOperationGetPropertiesExt( ze_rtas_parallel_operation_ext_handle_t hParallelOperation, ze_rtas_parallel_operation_ext_properties_t* pProperties );
   static ze_result_t zeRTASParallelOperationJoinExt( ze_rtas_parallel_operation_ext_handle_t hParallelOperation);
 
+  /* test hook of the internal builder to change its number of threads, 0 restores the default,
+   * returns ZE_RESULT_ERROR_UNSUPPORTED_FEATURE for other builders */
+  static ze_result_t zeRTASBuilderSetThreadCount(uint32_t numThreads);
+
   static RTAS_BUILD_MODE rtas_builder;
 };
 
@@ -28,6 +28,16 @@ namespace embree
       return tbb::task_scheduler_init::default_num_threads();
 #endif
     }
+
+    /* returns the index of the calling thread in the current task arena, or a value >= threadCount() outside of it */
+    static __forceinline size_t threadIndex() {
+#if TBB_INTERFACE_VERSION >= 9100
+      const int index = tbb::this_task_arena::current_thread_index();
+#else
+      const int index = tbb::task_arena::current_thread_index();
+#endif
+      return index < 0 ? std::numeric_limits<size_t>::max() : size_t(index);
+    }
   };
   
   /* parallel_for without range */
@@ -37,8 +37,10 @@ namespace embree
       init(numArrays,getSize,minStepSize);
     } 
 
+    /* the task partitioning only depends on the number of threads passed, thus passing a
+     * constant instead of the thread count makes the task borders reproducible */
     template<typename SizeFunc>
-    __forceinline void init ( const size_t numArrays, const SizeFunc& getSize, const size_t minStepSize )
+    __forceinline void init ( const size_t numArrays, const SizeFunc& getSize, const size_t minStepSize, const size_t numThreads = TaskScheduler::threadCount() )
     {
       /* first calculate total number of elements */
       size_t N = 0;
@@ -48,7 +50,6 @@ namespace embree
       this->N = N;
 
       /* calculate number of tasks to use */
-      const size_t numThreads = TaskScheduler::threadCount();
       const size_t numBlocks  = (N+minStepSize-1)/minStepSize;
       taskCount = max(size_t(1),min(numThreads,numBlocks,size_t(ParallelForForState::MAX_TASKS)));
       
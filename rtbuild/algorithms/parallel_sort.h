@@ -6,6 +6,7 @@
 #include "../simd/simd.h"
 #include "parallel_for.h"
 #include <algorithm>
+#include <vector>
 
 namespace embree
 {
@@ -451,4 +452,64 @@ namespace embree
     void radix_sort_u64(Ty* const src, Ty* const tmp, const size_t N, const size_t blockSize = 8192) {
     radix_sort<Ty,uint64_t>(src,tmp,N,blockSize);
   }
+
+  /* returns how many elements of a are among the first k elements of the merge of a and b,
+   * on equal elements the ones of a come first like in std::merge */
+  template<typename Ty, typename Less>
+    size_t merge_path(const Ty* a, const size_t na, const Ty* b, const size_t nb, const size_t k, const Less& less)
+  {
+    size_t lo = k > nb ? k-nb : 0;
+    size_t hi = std::min(k,na);
+    while (lo < hi)
+    {
+      const size_t i = (lo+hi)/2;
+      if (less(b[k-i-1],a[i])) hi = i;
+      else                     lo = i+1;
+    }
+    return lo;
+  }
+
+  /* comparison based merge sort, blocks get sorted with std::sort and then pairs of sorted runs get
+   * merged in rounds, where each output block is merged independently. The result does not depend
+   * on the number of threads, and equals the one of std::sort for a strict total order. */
+  template<typename Ty, typename Less>
+    void parallel_sort(Ty* const data, const size_t N, const Less& less, const size_t blockSize = 4096)
+  {
+    if (N <= blockSize) {
+      std::sort(data,data+N,less);
+      return;
+    }
+
+    const size_t numBlocks = (N+blockSize-1)/blockSize;
+    parallel_for(numBlocks, [&](size_t block) {
+      const size_t begin = block*blockSize;
+      std::sort(data+begin,data+std::min(begin+blockSize,N),less);
+    });
+
+    std::vector<Ty> tmp(N);
+    Ty* src = data;
+    Ty* dst = tmp.data();
+    for (size_t run=blockSize; run<N; run*=2)
+    {
+      /* runs are multiples of the block size, thus output blocks do not cross pairs of runs */
+      parallel_for(numBlocks, [&](size_t block) {
+        const size_t begin = block*blockSize/(2*run)*(2*run);
+        const size_t mid   = std::min(begin+run,N);
+        const size_t end   = std::min(begin+2*run,N);
+        const size_t k0 = block*blockSize-begin;
+        const size_t k1 = std::min((block+1)*blockSize,N)-begin;
+        const size_t i0 = merge_path(src+begin,mid-begin,src+mid,end-mid,k0,less);
+        const size_t i1 = merge_path(src+begin,mid-begin,src+mid,end-mid,k1,less);
+        std::merge(src+begin+i0,src+begin+i1,src+mid+(k0-i0),src+mid+(k1-i1),dst+begin+k0,less);
+      });
+      std::swap(src,dst);
+    }
+
+    if (src != data) {
+      parallel_for(numBlocks, [&](size_t block) {
+        const size_t begin = block*blockSize;
+        std::copy(src+begin,src+std::min(begin+blockSize,N),data+begin);
+      });
+    }
+  }
 }
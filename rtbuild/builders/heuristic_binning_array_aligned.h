@@ -4,6 +4,7 @@
 #pragma once
 
 #include "heuristic_binning.h"
+#include "../algorithms/parallel_sort.h"
 
 namespace embree
 {
@@ -119,13 +120,24 @@ namespace embree
             return find_block_size_template<true>(pinfo,blockSize);
         }
 
+        /*! finds the best split and returns the bounds of both sides */
+        __noinline const Split find_block_size(const PrimInfoRange& pinfo, const size_t blockSize, SplitInfo& info)
+        {
+          if (likely(pinfo.size() < PARALLEL_THRESHOLD))
+            return find_block_size_template<false>(pinfo,blockSize,&info);
+          else
+            return find_block_size_template<true>(pinfo,blockSize,&info);
+        }
+
         template<bool parallel>
-        __forceinline const Split find_block_size_template(const PrimInfoRange& pinfo, const size_t blockSize)
+        __forceinline const Split find_block_size_template(const PrimInfoRange& pinfo, const size_t blockSize, SplitInfo* info = nullptr)
         {
           Binner binner(empty);
           const BinMapping<BINS> mapping(pinfo);
           bin_serial_or_parallel<parallel>(binner,prims,pinfo.begin(),pinfo.end(),PARALLEL_FIND_BLOCK_SIZE,mapping);
-          return binner.best_block_size(mapping,blockSize);
+          const Split split = binner.best_block_size(mapping,blockSize);
+          if (info) binner.getSplitInfo(mapping,split,*info);
+          return split;
         }
 
         /*! array partitioning */
@@ -177,7 +189,7 @@ namespace embree
         void deterministic_order(const PrimInfoRange& pinfo)
         {
           /* required as parallel partition destroys original primitive order */
-          std::sort(&prims[pinfo.begin()],&prims[pinfo.end()]);
+          parallel_sort(&prims[pinfo.begin()],pinfo.size(),std::less<PrimRef>());
         }
 
         void splitFallback(const PrimInfoRange& pinfo, PrimInfoRange& linfo, PrimInfoRange& rinfo) {
@@ -7,8 +7,6 @@
 
 namespace embree
 {
-  static const unsigned int RESERVED_NUM_SPATIAL_SPLITS_GEOMID_BITS = 5;
-
   namespace isa
   {
 
@@ -19,31 +17,36 @@ namespace embree
       public:
         __forceinline SpatialBinMapping() {}
         
-        /*! calculates the mapping */
-        __forceinline SpatialBinMapping(const CentGeomBBox3fa& pinfo)
+        /*! calculates the mapping, the number of used bins can be smaller than BINS */
+        __forceinline SpatialBinMapping(const CentGeomBBox3fa& pinfo, size_t num = BINS)
+          : num(num)
         {
+          assert(num >= 1 && num <= BINS);
           const vfloat4 lower = (vfloat4) pinfo.geomBounds.lower;
           const vfloat4 upper = (vfloat4) pinfo.geomBounds.upper;
           const vfloat4 eps = 128.0f*vfloat4(ulp)*max(abs(lower),abs(upper));
           const vfloat4 diag = max(eps,(vfloat4) pinfo.geomBounds.size());
-          scale = select(upper-lower <= eps,vfloat4(0.0f),vfloat4(BINS)/diag);
+          scale = select(upper-lower <= eps,vfloat4(0.0f),vfloat4(float(num))/diag);
           ofs  = (vfloat4) pinfo.geomBounds.lower;
           inv_scale = 1.0f / scale; 
         }
 
+        /*! returns number of bins */
+        __forceinline size_t size() const { return num; }
+
         /*! slower but safe binning */
         __forceinline vint4 bin(const Vec3fa& p) const
         {
           const vint4 i = floori((vfloat4(p)-ofs)*scale);
-          return clamp(i,vint4(0),vint4(BINS-1));
+          return clamp(i,vint4(0),vint4(int(num)-1));
         }
 
         __forceinline std::pair<vint4,vint4> bin(const BBox3fa& b) const
         {
           const vint4 lower = floori((vfloat4(b.lower)-ofs)*scale);
           const vint4 upper = floori((vfloat4(b.upper)-ofs)*scale);
-          const vint4 c_lower = clamp(lower,vint4(0),vint4(BINS-1));
-          const vint4 c_upper = clamp(upper,vint4(0),vint4(BINS-1));
+          const vint4 c_lower = clamp(lower,vint4(0),vint4(int(num)-1));
+          const vint4 c_upper = clamp(upper,vint4(0),vint4(int(num)-1));
           return std::pair<vint4,vint4>(c_lower,c_upper);
         }
 
@@ -65,6 +68,7 @@ namespace embree
         }
         
       public:
+        size_t num;                   //!< number of bins
         vfloat4 ofs,scale,inv_scale;  //!< linear function that maps to bin ID
       };
 
@@ -151,16 +155,15 @@ namespace embree
         bounds  [binID][dim].extend(b);        
       }
 
-      /*! bins an array of primitives */
-      template<typename PrimitiveSplitterFactory>
-        __forceinline void bin2(const PrimitiveSplitterFactory& splitterFactory, const PrimRef* source, size_t begin, size_t end, const SpatialBinMapping<BINS>& mapping)
+      /*! bins an array of primitives, primitives that cannot get split are binned by their center */
+      template<typename PrimitiveSplitterFactory, typename SplittableFunc>
+        __forceinline void bin2(const PrimitiveSplitterFactory& splitterFactory, const SplittableFunc& splittable, const PrimRef* source, size_t begin, size_t end, const SpatialBinMapping<BINS>& mapping)
       {
         for (size_t i=begin; i<end; i++)
         {
           const PrimRef& prim = source[i];
-          unsigned splits = prim.geomID() >> (32-RESERVED_NUM_SPATIAL_SPLITS_GEOMID_BITS);
           
-          if (unlikely(splits <= 1))
+          if (unlikely(!splittable(prim)))
           {
             const vint4 bin = mapping.bin(center(prim.bounds()));
             for (size_t dim=0; dim<3; dim++) 
@@ -173,7 +176,16 @@ namespace embree
           {
             const vint4 bin0 = mapping.bin(prim.bounds().lower);
             const vint4 bin1 = mapping.bin(prim.bounds().upper);
+
+            /* creating the splitter may load the primitive, thus only do that if it overlaps multiple bins */
+            if (likely(bin0[0] == bin1[0] && bin0[1] == bin1[1] && bin0[2] == bin1[2]))
+            {
+              for (size_t dim=0; dim<3; dim++)
+                add(dim,bin0[dim],bin0[dim],bin0[dim],prim.bounds());
+              continue;
+            }
             
+            const auto splitter = splitterFactory(prim);
             for (size_t dim=0; dim<3; dim++) 
             {
               if (unlikely(mapping.invalid(dim))) 
@@ -197,7 +209,6 @@ namespace embree
               while (bin_start < bin_end && mapping.pos(bin_start+1,dim) <= rest.lower[dim]) bin_start++;
               while (bin_start < bin_end && mapping.pos(bin_end    ,dim) >= rest.upper[dim]) bin_end--;
               
-              const auto splitter = splitterFactory(prim);
               for (bin=bin_start; bin<bin_end; bin++) 
               {
                 const float pos = mapping.pos(bin+1,dim);
@@ -277,6 +288,76 @@ namespace embree
         return c;
       }
       
+      /*! finds the best split by scanning binning information, the SAH counts blocks of blockSize primitives like the object binner */
+      SpatialBinSplit<BINS> best_block_size(const SpatialBinMapping<BINS>& mapping, const size_t blockSize) const 
+      {
+        /* sweep from right to left and compute parallel prefix of merged bounds */
+        vfloat4 rAreas[BINS];
+        vuint4 rCounts[BINS];
+        vuint4 count = 0; BBox3fa bx = empty; BBox3fa by = empty; BBox3fa bz = empty;
+        for (size_t i=mapping.size()-1; i>0; i--)
+        {
+          count += numEnd[i];
+          rCounts[i] = count;
+          bx.extend(bounds[i][0]); rAreas[i][0] = expectedApproxHalfArea(bx);
+          by.extend(bounds[i][1]); rAreas[i][1] = expectedApproxHalfArea(by);
+          bz.extend(bounds[i][2]); rAreas[i][2] = expectedApproxHalfArea(bz);
+          rAreas[i][3] = 0.0f;
+        }
+        
+        /* sweep from left to right and compute SAH */
+        vuint4 blocks_add = blockSize-1;
+        vfloat4 blocks_factor = 1.0f/float(blockSize);
+        vuint4 ii = 1; vfloat4 vbestSAH = pos_inf; vuint4 vbestPos = 0; vuint4 vbestlCount = 0; vuint4 vbestrCount = 0;
+        count = 0; bx = empty; by = empty; bz = empty;
+        for (size_t i=1; i<mapping.size(); i++, ii+=1)
+        {
+          count += numBegin[i-1];
+          bx.extend(bounds[i-1][0]); float Ax = expectedApproxHalfArea(bx);
+          by.extend(bounds[i-1][1]); float Ay = expectedApproxHalfArea(by);
+          bz.extend(bounds[i-1][2]); float Az = expectedApproxHalfArea(bz);
+          const vfloat4 lArea = vfloat4(Ax,Ay,Az,Az);
+          const vfloat4 rArea = rAreas[i];
+          const vfloat4 lCount = floor(vfloat4(count     +blocks_add)*blocks_factor);
+          const vfloat4 rCount = floor(vfloat4(rCounts[i]+blocks_add)*blocks_factor);
+          const vfloat4 sah = madd(lArea,lCount,rArea*rCount);
+          const vbool4 mask = sah < vbestSAH;
+          vbestPos      = select(mask,ii ,vbestPos);
+          vbestSAH      = select(mask,sah,vbestSAH);
+          vbestlCount   = select(mask,count,vbestlCount);
+          vbestrCount   = select(mask,rCounts[i],vbestrCount);
+        }
+        
+        /* find best dimension */
+        float bestSAH = inf;
+        int   bestDim = -1;
+        int   bestPos = 0;
+        unsigned int   bestlCount = 0;
+        unsigned int   bestrCount = 0;
+        for (int dim=0; dim<3; dim++) 
+        {
+          /* ignore zero sized dimensions */
+          if (unlikely(mapping.invalid(dim)))
+            continue;
+          
+          /* test if this is a better dimension */
+          if (vbestSAH[dim] < bestSAH && vbestPos[dim] != 0) {
+            bestDim = dim;
+            bestPos = vbestPos[dim];
+            bestSAH = vbestSAH[dim];
+            bestlCount = vbestlCount[dim];
+            bestrCount = vbestrCount[dim];
+          }
+        }
+        
+        /* return invalid split if no split found */
+        if (bestDim == -1) 
+          return SpatialBinSplit<BINS>(inf,-1,0,mapping);
+        
+        /* return best found split */
+        return SpatialBinSplit<BINS>(bestSAH,bestDim,bestPos,bestlCount,bestrCount,1.0f,mapping);
+      }
+      
       /*! finds the best split by scanning binning information */
       SpatialBinSplit<BINS> best(const SpatialBinMapping<BINS>& mapping, const size_t blocks_shift) const 
       {
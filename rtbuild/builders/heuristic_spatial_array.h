@@ -0,0 +1,123 @@
+// Copyright 2009-2021 Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "heuristic_binning_array_aligned.h"
+#include "heuristic_spatial.h"
+
+#include <atomic>
+
+namespace embree
+{
+  namespace isa
+  {
+    /*! Performs spatial split binning. References that straddle the
+     *  split plane get clipped into two, the right parts are appended
+     *  behind the range into free slots of the primitive array. */
+    template<typename PrimRef, size_t BINS>
+      struct HeuristicArraySpatialSAH
+      {
+        typedef SpatialBinSplit<BINS> Split;
+        typedef SpatialBinInfo<BINS,PrimRef> Binner;
+
+        static const size_t PARALLEL_THRESHOLD = 3 * 1024;
+        static const size_t PARALLEL_FIND_BLOCK_SIZE = 1024;
+        static const size_t PARALLEL_PARTITION_BLOCK_SIZE = 128;
+
+        /*! remember prim array */
+        __forceinline HeuristicArraySpatialSAH (PrimRef* prims)
+          : prims(prims) {}
+
+        /*! finds the best split, the splitter factory returns a function that clips a primitive to some bounds */
+        template<typename PrimitiveSplitterFactory, typename SplittableFunc>
+        __noinline const Split find_block_size(const PrimInfoRange& pinfo, const size_t blockSize, const PrimitiveSplitterFactory& splitterFactory, const SplittableFunc& splittable)
+        {
+          /* like the object binning use fewer bins for few primitives, which reduces the number of clipped primitives */
+          const SpatialBinMapping<BINS> mapping(pinfo,min(BINS,size_t(4.0f + 0.05f*pinfo.size())));
+          Binner binner(empty);
+          if (likely(pinfo.size() < PARALLEL_THRESHOLD))
+            binner.bin2(splitterFactory,splittable,prims,pinfo.begin(),pinfo.end(),mapping);
+          else
+            binner = parallel_reduce(pinfo.begin(),pinfo.end(),PARALLEL_FIND_BLOCK_SIZE,binner,
+                                     [&](const range<size_t>& r) -> Binner { Binner binner(empty); binner.bin2(splitterFactory,splittable,prims,r.begin(),r.end(),mapping); return binner; },
+                                     [&](const Binner& b0, const Binner& b1) -> Binner { return Binner::reduce(b0,b1); });
+          return binner.best_block_size(mapping,blockSize);
+        }
+
+        /*! array partitioning, returns false without modifying the array if there are less than
+         *  ext_end-pinfo.end() free slots for the references that need to get clipped */
+        template<typename SplitterFunc, typename SplittableFunc>
+        bool split(const Split& split, const PrimInfoRange& set, const size_t ext_end, const SplitterFunc& splitter, const SplittableFunc& splittable,
+                   PrimInfoRange& lset, PrimInfoRange& rset)
+        {
+          assert(split.valid());
+          const size_t begin = set.begin();
+          const size_t end   = set.end();
+          const bool parallel = set.size() >= PARALLEL_THRESHOLD;
+          const int dim = split.dim;
+          const int pos = split.pos;
+          const float fpos = split.mapping.pos(pos,dim);
+
+          auto straddles = [&] (const PrimRef& ref) {
+            if (!splittable(ref)) return false;
+            const BBox3fa bounds = ref.bounds();
+            return split.mapping.bin(bounds.lower)[dim] < pos && split.mapping.bin(bounds.upper)[dim] >= pos;
+          };
+
+          /* count references to clip */
+          auto countStraddling = [&] (const range<size_t>& r) -> size_t {
+            size_t n = 0;
+            for (size_t i=r.begin(); i<r.end(); i++) n += straddles(prims[i]);
+            return n;
+          };
+          const size_t numSplits = parallel
+            ? parallel_reduce(begin,end,PARALLEL_FIND_BLOCK_SIZE,size_t(0),countStraddling,std::plus<size_t>())
+            : countStraddling(range<size_t>(begin,end));
+
+          if (numSplits > ext_end-end)
+            return false;
+
+          /* the left part replaces the reference, parts can be empty as the binning is conservative */
+          std::atomic<size_t> ext(end);
+          auto clip = [&] (const range<size_t>& r) {
+            for (size_t i=r.begin(); i<r.end(); i++)
+            {
+              if (!straddles(prims[i])) continue;
+              PrimRef left,right;
+              splitter(prims[i],dim,fpos,left,right);
+              if (left.bounds().empty()) { prims[i] = right; continue; }
+              prims[i] = left;
+              if (!right.bounds().empty()) prims[ext++] = right;
+            }
+          };
+          if (parallel) parallel_for(begin,end,PARALLEL_FIND_BLOCK_SIZE,clip);
+          else          clip(range<size_t>(begin,end));
+          const size_t newEnd = ext.load();
+
+          /* clipped references are on one side of the plane, all other references go to the side of their center */
+          CentGeomBBox3fa local_left(empty);
+          CentGeomBBox3fa local_right(empty);
+          auto isLeft = [&] (const PrimRef& ref) { return split.mapping.bin(center(ref.bounds()))[dim] < pos; };
+
+          size_t mid = 0;
+          if (!parallel)
+            mid = serial_partitioning(prims,begin,newEnd,local_left,local_right,isLeft,
+                                      [] (CentGeomBBox3fa& pinfo,const PrimRef& ref) { pinfo.extend_center2(ref); });
+          else
+            mid = parallel_partitioning(
+              prims,begin,newEnd,EmptyTy(),local_left,local_right,isLeft,
+              [] (CentGeomBBox3fa& pinfo,const PrimRef& ref) { pinfo.extend_center2(ref); },
+              [] (CentGeomBBox3fa& pinfo0,const CentGeomBBox3fa& pinfo1) { pinfo0.merge(pinfo1); },
+              PARALLEL_PARTITION_BLOCK_SIZE);
+
+          new (&lset) PrimInfoRange(begin,mid,local_left);
+          new (&rset) PrimInfoRange(mid,newEnd,local_right);
+          return true;
+        }
+
+      private:
+        PrimRef* const prims;
+      };
+  }
+}
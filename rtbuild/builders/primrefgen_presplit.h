@@ -225,11 +225,20 @@ namespace embree
     
 #endif
 
-    template<typename SplitPrimitiveFunc, typename ProjectedPrimitiveAreaFunc, typename PrimVector>
+    /* Splits the primitives with the highest priorities such that
+     * they fill the free slots [pinfo.size(),prims.size()) of the prims
+     * array. The presplitItems buffer has to hold 2*pinfo.size() items,
+     * maxSubPrims returns an upper bound of the number of sub-primitives
+     * splitPrimitive creates for a primitive and a requested number of
+     * sub-primitives. No other temporary memory proportional to the
+     * number of primitives gets allocated. */
+    template<typename SplitPrimitiveFunc, typename MaxSubPrimsFunc, typename ProjectedPrimitiveAreaFunc, typename PrimVector>
     PrimInfo createPrimRefArray_presplit(size_t numPrimRefs,
                                          PrimVector& prims,
                                          const PrimInfo& pinfo,
+                                         PresplitItem* presplitItems,
                                          const SplitPrimitiveFunc& splitPrimitive,
+                                         const MaxSubPrimsFunc& maxSubPrims,
                                          const ProjectedPrimitiveAreaFunc& primitiveArea)
     {
       static const size_t MIN_STEP_SIZE = 128;
@@ -239,27 +248,40 @@ namespace embree
       const size_t numPrimitivesExt = prims.size(); 
       const size_t numSplitPrimitivesBudget = numPrimitivesExt - numPrimitives;
 
-      /* allocate double buffer presplit items */
-      avector<PresplitItem> preSplitItem0(numPrimitivesExt);
-      avector<PresplitItem> preSplitItem1(numPrimitivesExt);
+      /* nothing to split if there are no free slots */
+      if (numSplitPrimitivesBudget == 0)
+        return pinfo;
+
+      /* double buffer presplit items */
+      PresplitItem* preSplitItem0 = presplitItems;
+      PresplitItem* preSplitItem1 = presplitItems + numPrimitives;
 
       /* compute grid */
       SplittingGrid grid(pinfo.geomBounds);
       
-      /* init presplit items and get total sum */
-      const float psum = parallel_reduce( size_t(0), numPrimitives, size_t(MIN_STEP_SIZE), 0.0f, [&](const range<size_t>& r) -> float {
-          float sum = 0.0f;
-          for (size_t i=r.begin(); i<r.end(); i++)
-          {		
-            preSplitItem0[i].index = (unsigned int)i;
-            const Vec2i mc = grid.computeMC(prims[i]);
-            /* if all bits are equal then we cannot split */
-            preSplitItem0[i].priority = (mc.x != mc.y) ? PresplitItem::compute_priority(primitiveArea,prims[i],mc) : 0.0f;    
-            /* FIXME: sum undeterministic */
-            sum += preSplitItem0[i].priority;
+      /* init presplit items and get total sum, the sums of fixed size blocks are added in
+       * order, such that the result does not depend on how the tasks got partitioned */
+      const size_t numSumBlocks = (numPrimitives+MIN_STEP_SIZE-1)/MIN_STEP_SIZE;
+      std::vector<float> blockSums(numSumBlocks);
+      parallel_for( size_t(0), numSumBlocks, [&](const range<size_t>& rb) -> void {
+          for (size_t b=rb.begin(); b<rb.end(); b++)
+          {
+            float sum = 0.0f;
+            for (size_t i=b*MIN_STEP_SIZE; i<std::min(numPrimitives,(b+1)*MIN_STEP_SIZE); i++)
+            {		
+              preSplitItem0[i].index = (unsigned int)i;
+              const Vec2i mc = grid.computeMC(prims[i]);
+              /* if all bits are equal then we cannot split */
+              preSplitItem0[i].priority = (mc.x != mc.y) ? PresplitItem::compute_priority(primitiveArea,prims[i],mc) : 0.0f;    
+              sum += preSplitItem0[i].priority;
+            }
+            blockSums[b] = sum;
           }
-          return sum;
-        },[](const float& a, const float& b) -> float { return a+b; });
+        });
+
+      float psum = 0.0f;
+      for (size_t b=0; b<numSumBlocks; b++)
+        psum += blockSums[b];
 
       /* compute number of splits per primitive */
       const float inv_psum = 1.0f / psum;
@@ -284,19 +306,54 @@ namespace embree
           }
         });
 
-      auto isLeft = [&] (const PresplitItem &ref) { return ref.data <= 1; };        
-      size_t center = parallel_partitioning(preSplitItem0.data(),0,numPrimitives,isLeft,1024);
+      /* move the items to split to the end, keeping them in index order, as the radix sort
+       * below is stable and the budget cut depends on the order of equal items */
+      static const size_t PARTITION_BLOCK_SIZE = 1024;
+      auto isLeft = [&] (const PresplitItem &ref) { return ref.data <= 1; };
+      const size_t numPartitionBlocks = (numPrimitives+PARTITION_BLOCK_SIZE-1)/PARTITION_BLOCK_SIZE;
+      std::vector<size_t> blockOffsets(numPartitionBlocks);
+      parallel_for( size_t(0), numPartitionBlocks, [&](const range<size_t>& rb) -> void {
+          for (size_t b=rb.begin(); b<rb.end(); b++)
+          {
+            size_t num = 0;
+            for (size_t i=b*PARTITION_BLOCK_SIZE; i<std::min(numPrimitives,(b+1)*PARTITION_BLOCK_SIZE); i++)
+              num += !isLeft(preSplitItem0[i]);
+            blockOffsets[b] = num;
+          }
+        });
+
+      size_t numRight = 0;
+      for (size_t b=0; b<numPartitionBlocks; b++) {
+        const size_t num = blockOffsets[b];
+        blockOffsets[b] = numRight;
+        numRight += num;
+      }
+      const size_t center = numPrimitives - numRight;
       assert(center <= numPrimitives);
 
+      parallel_for( size_t(0), numPartitionBlocks, [&](const range<size_t>& rb) -> void {
+          for (size_t b=rb.begin(); b<rb.end(); b++)
+          {
+            size_t dst = center + blockOffsets[b];
+            for (size_t i=b*PARTITION_BLOCK_SIZE; i<std::min(numPrimitives,(b+1)*PARTITION_BLOCK_SIZE); i++)
+              if (!isLeft(preSplitItem0[i])) preSplitItem1[dst++] = preSplitItem0[i];
+          }
+        });
+      
+      parallel_for( center, numPrimitives, size_t(MIN_STEP_SIZE), [&](const range<size_t>& r) -> void {
+          for (size_t i=r.begin(); i<r.end(); i++)
+            preSplitItem0[i] = preSplitItem1[i];
+        });
+
       /* anything to split ? */
       if (center >= numPrimitives)
         return pinfo;
             
-      size_t numPrimitivesToSplit = numPrimitives - center;
+      const size_t numPrimitivesToSplit = numPrimitives - center;
       assert(preSplitItem0[center].data >= 1.0f);
       
       /* sort presplit items in ascending order */
-      radix_sort_u32(preSplitItem0.data() + center,preSplitItem1.data() + center,numPrimitivesToSplit,1024);
+      radix_sort_u32(preSplitItem0 + center,preSplitItem1 + center,numPrimitivesToSplit,1024);
       
       CHECK_PRESPLIT(
         parallel_for( size_t(center+1), numPrimitives, size_t(MIN_STEP_SIZE), [&](const range<size_t>& r) -> void {
@@ -305,78 +362,91 @@ namespace embree
           });
       );
       
-      unsigned int* primOffset0 = (unsigned int*)preSplitItem1.data();
-      unsigned int* primOffset1 = (unsigned int*)preSplitItem1.data() + numPrimitivesToSplit;
-      
-      /* compute actual number of sub-primitives generated within the [center;numPrimitives-1] range */
-      const size_t totalNumSubPrims = parallel_reduce( size_t(center), numPrimitives, size_t(MIN_STEP_SIZE), size_t(0), [&](const range<size_t>& t) -> size_t {
-        size_t sum = 0;
-        for (size_t i=t.begin(); i<t.end(); i++)
-        {	
-          const unsigned int primrefID  = preSplitItem0[i].index;	
-          const unsigned int splitprims = preSplitItem0[i].data;
-          assert(splitprims >= 1 && splitprims <= MAX_PRESPLITS_PER_PRIMITIVE);
-          
+      /* upper bound of the number of additional sub-primitives of the items [center,i) */
+      unsigned int* maxExtraSubPrims = (unsigned int*)preSplitItem1;
+      unsigned int* maxExtraSubPrimsPrefix = (unsigned int*)preSplitItem1 + numPrimitivesToSplit;
+      parallel_for( center, numPrimitives, size_t(MIN_STEP_SIZE), [&](const range<size_t>& r) -> void {
+          for (size_t i=r.begin(); i<r.end(); i++)
+            maxExtraSubPrims[i-center] = maxSubPrims(prims[preSplitItem0[i].index],preSplitItem0[i].data)-1;
+        });
+      const size_t maxExtraSubPrimsTotal = parallel_prefix_sum(maxExtraSubPrims,maxExtraSubPrimsPrefix,numPrimitivesToSplit,(unsigned int)0,std::plus<unsigned int>());
+      auto maxExtraSubPrimsBefore = [&] (size_t i) -> size_t {
+        return i == numPrimitives ? maxExtraSubPrimsTotal : maxExtraSubPrimsPrefix[i-center];
+      };
+
+      /* Each primitive gets split only once. Its first sub-primitive replaces the primitive, the
+       * others go to the end of the free slots of the prims array, in index order of the items.
+       * The items get processed from the highest priority down in waves, that only contain items
+       * whose maximal number of sub-primitives fits into the remaining free slots, thus all items
+       * of a wave fit and the split stops at the same item for any thread count. The sub-primitives
+       * of a wave are stored at their maximal offsets first and get moved together afterwards. */
+      size_t end = numPrimitives;         // items [end,numPrimitives) are split
+      size_t freeEnd = numPrimitivesExt;  // additional sub-primitives are stored in [freeEnd,numPrimitivesExt)
+      while (end > center)
+      {
+        const size_t numFree = freeEnd - numPrimitives;
+        const size_t maxEnd = maxExtraSubPrimsBefore(end);
+        const unsigned int* first = maxExtraSubPrimsPrefix;
+        const unsigned int* last  = maxExtraSubPrimsPrefix + (end-center);
+        const size_t begin = center + (std::lower_bound(first,last,(unsigned int)(std::max(maxEnd,numFree)-numFree)) - first);
+
+        /* the next item may not fit, split it alone and stop if it does not */
+        if (begin == end)
+        {
+          const size_t i = end-1;
           unsigned int numSubPrims = 0;
-          PrimRef subPrims[MAX_PRESPLITS_PER_PRIMITIVE];	
-          splitPrimitive(prims[primrefID],splitprims,grid,subPrims,numSubPrims);
+          PrimRef subPrims[MAX_PRESPLITS_PER_PRIMITIVE];
+          splitPrimitive(prims[preSplitItem0[i].index],preSplitItem0[i].data,grid,subPrims,numSubPrims);
           assert(numSubPrims);
-          
-          numSubPrims--; // can reuse slot 
-          sum+=numSubPrims;
-          preSplitItem0[i].data = (numSubPrims << 16) | splitprims;
-          
-          primOffset0[i-center] = numSubPrims;
+          if (numSubPrims-1 > numFree) break;
+
+          prims[preSplitItem0[i].index] = subPrims[0];
+          freeEnd -= numSubPrims-1;
+          for (size_t k=1; k<numSubPrims; k++)
+            prims[freeEnd+k-1] = subPrims[k];
+          end = i;
+          continue;
         }
-        return sum;
-      },[](const size_t& a, const size_t& b) -> size_t { return a+b; });
 
-      /* if we are over budget, need to shrink the range */
-      if (totalNumSubPrims > numSplitPrimitivesBudget) 
-      {
-        size_t new_center = numPrimitives-1;
-        size_t sum = 0;
-        for (;new_center>=center;new_center--)
+        /* split all items of the wave and store their additional sub-primitives at the maximal offsets */
+        const size_t waveEnd = freeEnd;
+        parallel_for( begin, end, size_t(MIN_STEP_SIZE), [&](const range<size_t>& r) -> void {
+            for (size_t i=r.begin(); i<r.end(); i++)
+            {
+              const unsigned int primrefID  = preSplitItem0[i].index;	
+              const unsigned int splitprims = preSplitItem0[i].data;
+              assert(splitprims >= 1 && splitprims <= MAX_PRESPLITS_PER_PRIMITIVE);
+              
+              unsigned int numSubPrims = 0;
+              PrimRef subPrims[MAX_PRESPLITS_PER_PRIMITIVE];	
+              splitPrimitive(prims[primrefID],splitprims,grid,subPrims,numSubPrims);
+              assert(numSubPrims && numSubPrims-1 <= maxExtraSubPrims[i-center]);
+
+              prims[primrefID] = subPrims[0];
+              const size_t dst = waveEnd - (maxEnd - maxExtraSubPrimsPrefix[i-center]);
+              for (size_t k=1; k<numSubPrims; k++)
+                prims[dst+k-1] = subPrims[k];
+              preSplitItem0[i].data = numSubPrims-1;
+            }
+          });
+
+        /* move the sub-primitives together, towards the end of the free slots */
+        for (size_t i=end; i>begin; i--)
         {
-          const unsigned int numSubPrims = preSplitItem0[new_center].data >> 16;
-          if (unlikely(sum + numSubPrims >= numSplitPrimitivesBudget)) break;
-          sum += numSubPrims;
+          const unsigned int numExtraSubPrims = preSplitItem0[i-1].data;
+          const size_t src = waveEnd - (maxEnd - maxExtraSubPrimsPrefix[i-1-center]);
+          const size_t dst = (freeEnd -= numExtraSubPrims);
+          assert(dst >= src);
+          if (dst != src && numExtraSubPrims)
+            memmove((void*)&prims[dst],(void*)&prims[src],numExtraSubPrims*sizeof(PrimRef));
         }
-        new_center++;
-        
-        primOffset0 += new_center - center;
-        numPrimitivesToSplit -= new_center - center;
-        center = new_center;
-        assert(numPrimitivesToSplit == (numPrimitives - center));
+        end = begin;
       }
-      
-      /* parallel prefix sum to compute offsets for storing sub-primitives */
-      const unsigned int offset = parallel_prefix_sum(primOffset0,primOffset1,numPrimitivesToSplit,(unsigned int)0,std::plus<unsigned int>());
-      assert(numPrimitives+offset <= numPrimitivesExt);
-      
-      /* iterate over range, and split primitives into sub primitives and append them to prims array */		    
-      parallel_for( size_t(center), numPrimitives, size_t(MIN_STEP_SIZE), [&](const range<size_t>& rn) -> void {
-        for (size_t j=rn.begin(); j<rn.end(); j++)		    
-        {
-          const unsigned int primrefID = preSplitItem0[j].index;	
-          const unsigned int splitprims = preSplitItem0[j].data & 0xFFFF;
-          assert(splitprims >= 1 && splitprims <= MAX_PRESPLITS_PER_PRIMITIVE);
-          
-          unsigned int numSubPrims = 0;
-          PrimRef subPrims[MAX_PRESPLITS_PER_PRIMITIVE];
-          splitPrimitive(prims[primrefID],splitprims,grid,subPrims,numSubPrims);
 
-          const unsigned int numSubPrimsExpected MAYBE_UNUSED = preSplitItem0[j].data >> 16;
-          assert(numSubPrims-1 == numSubPrimsExpected);
-          
-          const size_t newID = numPrimitives + primOffset1[j-center];
-          assert(newID+numSubPrims-1 <= numPrimitivesExt);
-          
-          prims[primrefID] = subPrims[0];
-          for (size_t i=1;i<numSubPrims;i++)
-            prims[newID+i-1] = subPrims[i];
-        }
-      });
+      /* move the additional sub-primitives to the first free slot */
+      const size_t offset = numPrimitivesExt - freeEnd;
+      if (offset && freeEnd != numPrimitives)
+        memmove((void*)&prims[numPrimitives],(void*)&prims[freeEnd],offset*sizeof(PrimRef));
 
       numPrimitives += offset;
                 
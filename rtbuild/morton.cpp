@@ -0,0 +1,59 @@
+// Copyright 2009-2021 Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "morton.h"
+#include "morton_kernels.h"
+
+namespace embree
+{
+  /* spreads the lower 10 bits of x such that there are 2 zero bits between each bit */
+  static __forceinline uint32_t bitSpread3(uint32_t x)
+  {
+    x = (x | (x << 16)) & 0x030000FF;
+    x = (x | (x <<  8)) & 0x0300F00F;
+    x = (x | (x <<  4)) & 0x030C30C3;
+    x = (x | (x <<  2)) & 0x09249249;
+    return x;
+  }
+  
+  void computeMortonCodes_sse2(const float* prims, size_t N, const float base[3], const float scale[3], uint32_t* codes)
+  {
+    const Vec3fa vbase(base[0],base[1],base[2]);
+    const Vec3fa vscale(scale[0],scale[1],scale[2]);
+    
+    for (size_t i=0; i<N; i++)
+    {
+      const PrimRef& prim = ((const PrimRef*)prims)[i];
+      const Vec3fa c = (prim.center2() - vbase) * vscale;
+      const uint32_t x = (uint32_t) clamp(c.x,0.0f,1023.0f);
+      const uint32_t y = (uint32_t) clamp(c.y,0.0f,1023.0f);
+      const uint32_t z = (uint32_t) clamp(c.z,0.0f,1023.0f);
+      codes[i] = (bitSpread3(x) << 2) | (bitSpread3(y) << 1) | bitSpread3(z);
+    }
+  }
+
+  typedef void (*computeMortonCodesFunc)(const float* prims, size_t N, const float base[3], const float scale[3], uint32_t* codes);
+
+  static computeMortonCodesFunc selectComputeMortonCodes()
+  {
+    const int features = getCPUFeatures();
+#if defined(EMBREE_TARGET_AVX512)
+    if ((features & AVX512) == AVX512) return computeMortonCodes_avx512;
+#endif
+#if defined(EMBREE_TARGET_AVX2)
+    if ((features & AVX2) == AVX2) return computeMortonCodes_avx2;
+#endif
+    _unused(features);
+    return computeMortonCodes_sse2;
+  }
+
+  void computeMortonCodes(const PrimRef* prims, size_t N, const Vec3fa& base, const Vec3fa& scale, uint32_t* codes)
+  {
+    static_assert(sizeof(PrimRef) == 8*sizeof(float), "Morton code kernels expect primitive references of 8 floats");
+    static const computeMortonCodesFunc func = selectComputeMortonCodes();
+    
+    const float fbase [3] = { base.x,  base.y,  base.z  };
+    const float fscale[3] = { scale.x, scale.y, scale.z };
+    func((const float*)prims,N,fbase,fscale,codes);
+  }
+}
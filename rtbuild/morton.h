@@ -0,0 +1,17 @@
+// Copyright 2009-2021 Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "builders/primref.h"
+
+namespace embree
+{
+  /* Computes the 30 bit Morton code of the centroid of each primitive
+   * reference. The centroid is mapped to a 1024^3 grid as
+   * (center2-base)*scale and clamped to the grid, the x bits are the
+   * most significant ones of each bit triple. The function runs the
+   * widest kernel the CPU supports, all kernels compute identical
+   * codes. */
+  void computeMortonCodes(const PrimRef* prims, size_t N, const Vec3fa& base, const Vec3fa& scale, uint32_t* codes);
+}
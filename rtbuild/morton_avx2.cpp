@@ -0,0 +1,53 @@
+// Copyright 2009-2021 Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "morton_kernels.h"
+
+namespace embree
+{
+  static inline __m256i bitSpread3(__m256i x)
+  {
+    x = _mm256_and_si256(_mm256_or_si256(x,_mm256_slli_epi32(x,16)),_mm256_set1_epi32(0x030000FF));
+    x = _mm256_and_si256(_mm256_or_si256(x,_mm256_slli_epi32(x, 8)),_mm256_set1_epi32(0x0300F00F));
+    x = _mm256_and_si256(_mm256_or_si256(x,_mm256_slli_epi32(x, 4)),_mm256_set1_epi32(0x030C30C3));
+    x = _mm256_and_si256(_mm256_or_si256(x,_mm256_slli_epi32(x, 2)),_mm256_set1_epi32(0x09249249));
+    return x;
+  }
+
+  /* twice the centroid of a primitive reference */
+  static inline __m128 center2(const float* prim)
+  {
+    const __m256 v = _mm256_loadu_ps(prim);
+    return _mm_add_ps(_mm256_castps256_ps128(v),_mm256_extractf128_ps(v,1));
+  }
+
+  static inline __m256i gridCoordinate(__m256 c, float base, float scale)
+  {
+    c = _mm256_mul_ps(_mm256_sub_ps(c,_mm256_set1_ps(base)),_mm256_set1_ps(scale));
+    c = _mm256_max_ps(_mm256_min_ps(c,_mm256_set1_ps(1023.0f)),_mm256_setzero_ps());
+    return _mm256_cvttps_epi32(c);
+  }
+
+  void computeMortonCodes_avx2(const float* prims, size_t N, const float base[3], const float scale[3], uint32_t* codes)
+  {
+    size_t i=0;
+    for (; i+8<=N; i+=8)
+    {
+      /* transpose the centroids of 8 primitives into x, y, and z vectors */
+      __m128 c0 = center2(prims+8*(i+0)), c1 = center2(prims+8*(i+1)), c2 = center2(prims+8*(i+2)), c3 = center2(prims+8*(i+3));
+      __m128 c4 = center2(prims+8*(i+4)), c5 = center2(prims+8*(i+5)), c6 = center2(prims+8*(i+6)), c7 = center2(prims+8*(i+7));
+      _MM_TRANSPOSE4_PS(c0,c1,c2,c3);
+      _MM_TRANSPOSE4_PS(c4,c5,c6,c7);
+      const __m256 cx = _mm256_insertf128_ps(_mm256_castps128_ps256(c0),c4,1);
+      const __m256 cy = _mm256_insertf128_ps(_mm256_castps128_ps256(c1),c5,1);
+      const __m256 cz = _mm256_insertf128_ps(_mm256_castps128_ps256(c2),c6,1);
+
+      const __m256i x = bitSpread3(gridCoordinate(cx,base[0],scale[0]));
+      const __m256i y = bitSpread3(gridCoordinate(cy,base[1],scale[1]));
+      const __m256i z = bitSpread3(gridCoordinate(cz,base[2],scale[2]));
+      const __m256i code = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi32(x,2),_mm256_slli_epi32(y,1)),z);
+      _mm256_storeu_si256((__m256i*)(codes+i),code);
+    }
+    computeMortonCodes_sse2(prims+8*i,N-i,base,scale,codes+i);
+  }
+}
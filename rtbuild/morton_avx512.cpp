@@ -0,0 +1,58 @@
+// Copyright 2009-2021 Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+/* The unmasked AVX-512 intrinsics of GCC 12 internally pass an
+ * _mm512_undefined_* source operand, which triggers false
+ * -Wmaybe-uninitialized warnings once they get inlined (GCC bug
+ * 105593, fixed in GCC 13). */
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ < 13
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+#include "morton_kernels.h"
+
+namespace embree
+{
+  static inline __m512i bitSpread3(__m512i x)
+  {
+    x = _mm512_and_si512(_mm512_or_si512(x,_mm512_slli_epi32(x,16)),_mm512_set1_epi32(0x030000FF));
+    x = _mm512_and_si512(_mm512_or_si512(x,_mm512_slli_epi32(x, 8)),_mm512_set1_epi32(0x0300F00F));
+    x = _mm512_and_si512(_mm512_or_si512(x,_mm512_slli_epi32(x, 4)),_mm512_set1_epi32(0x030C30C3));
+    x = _mm512_and_si512(_mm512_or_si512(x,_mm512_slli_epi32(x, 2)),_mm512_set1_epi32(0x09249249));
+    return x;
+  }
+
+  static inline __m512i gridCoordinate(__m512 c, float base, float scale)
+  {
+    c = _mm512_mul_ps(_mm512_sub_ps(c,_mm512_set1_ps(base)),_mm512_set1_ps(scale));
+    c = _mm512_max_ps(_mm512_min_ps(c,_mm512_set1_ps(1023.0f)),_mm512_setzero_ps());
+    return _mm512_cvttps_epi32(c);
+  }
+
+  /* the masked gather with a zero source avoids reading the undefined source register of _mm512_i32gather_ps */
+  static inline __m512 gather(__m512i offsets, const float* ptr) {
+    return _mm512_mask_i32gather_ps(_mm512_setzero_ps(),0xFFFF,offsets,ptr,4);
+  }
+
+  void computeMortonCodes_avx512(const float* prims, size_t N, const float base[3], const float scale[3], uint32_t* codes)
+  {
+    /* a primitive reference is 8 floats large, the upper bounds follow the lower bounds */
+    const __m512i offsets = _mm512_mullo_epi32(_mm512_setr_epi32(0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15),_mm512_set1_epi32(8));
+    
+    size_t i=0;
+    for (; i+16<=N; i+=16)
+    {
+      const float* p = prims+8*i;
+      const __m512 cx = _mm512_add_ps(gather(offsets,p+0),gather(offsets,p+4));
+      const __m512 cy = _mm512_add_ps(gather(offsets,p+1),gather(offsets,p+5));
+      const __m512 cz = _mm512_add_ps(gather(offsets,p+2),gather(offsets,p+6));
+
+      const __m512i x = bitSpread3(gridCoordinate(cx,base[0],scale[0]));
+      const __m512i y = bitSpread3(gridCoordinate(cy,base[1],scale[1]));
+      const __m512i z = bitSpread3(gridCoordinate(cz,base[2],scale[2]));
+      const __m512i code = _mm512_or_si512(_mm512_or_si512(_mm512_slli_epi32(x,2),_mm512_slli_epi32(y,1)),z);
+      _mm512_storeu_si512((void*)(codes+i),code);
+    }
+    computeMortonCodes_sse2(prims+8*i,N-i,base,scale,codes+i);
+  }
+}
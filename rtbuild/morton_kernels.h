@@ -0,0 +1,22 @@
+// Copyright 2009-2021 Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+/* The kernels for wider ISAs only include this header, such that no
+ * inline function of the other headers gets compiled for a wider ISA
+ * and picked by the linker for all callers. */
+
+#include <immintrin.h>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace embree
+{
+  /* Morton code kernels for the individual ISAs, prims points to the
+   * primitive references of 8 floats each, the lower bounds followed
+   * by the upper bounds. */
+  void computeMortonCodes_sse2  (const float* prims, size_t N, const float base[3], const float scale[3], uint32_t* codes);
+  void computeMortonCodes_avx2  (const float* prims, size_t N, const float base[3], const float scale[3], uint32_t* codes);
+  void computeMortonCodes_avx512(const float* prims, size_t N, const float base[3], const float scale[3], uint32_t* codes);
+}
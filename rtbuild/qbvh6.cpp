@@ -5,8 +5,13 @@
 
 namespace embree
 {
+  /* 4kB page of some BVH address, relative to the BVH start as the buffer is page aligned on the device */
+  static uint64_t getPage(const char* accel, const char* ptr) {
+    return uint64_t(ptr - accel) >> 12;
+  }
+  
   template<typename InternalNode>
-  void computeInternalNodeStatistics(BVHStatistics& stats, QBVH6::Node node, const BBox1f time_range, const float node_bounds_area, const float root_bounds_area)
+  void computeInternalNodeStatistics(BVHStatistics& stats, const char* accel, QBVH6::Node node, const BBox1f time_range, const float node_bounds_area, const float root_bounds_area)
   {
     InternalNode* inner = node.innerNode<InternalNode>();
 
@@ -16,7 +21,12 @@ namespace embree
       if (inner->valid(i))
       {
         size++;
-        computeStatistics(stats, inner->child(i), time_range, area(inner->bounds(i)), root_bounds_area, InternalNode::NUM_CHILDREN);
+        const QBVH6::Node child = inner->child(i);
+        const float child_bounds_area = area(inner->bounds(i));
+        if (getPage(accel,(const char*)inner) != getPage(accel,child.node))
+          stats.pageCrossingSAH += time_range.size() * child_bounds_area / root_bounds_area;
+        
+        computeStatistics(stats, accel, child, time_range, child_bounds_area, root_bounds_area, InternalNode::NUM_CHILDREN);
       }
     }
 
@@ -28,7 +38,7 @@ namespace embree
     stats.internalNode.numBytes += sizeof(InternalNode);
   }
 
-  void computeStatistics(BVHStatistics& stats, QBVH6::Node node, const BBox1f time_range, const float node_bounds_area, const float root_bounds_area, uint32_t numChildren)
+  void computeStatistics(BVHStatistics& stats, const char* accel, QBVH6::Node node, const BBox1f time_range, const float node_bounds_area, const float root_bounds_area, uint32_t numChildren)
   {
     switch (node.type)
     {
@@ -108,7 +118,7 @@ namespace embree
     }
     case NODE_TYPE_INTERNAL:
     {
-      computeInternalNodeStatistics<QBVH6::InternalNode6>(stats, node, time_range, node_bounds_area, root_bounds_area);
+      computeInternalNodeStatistics<QBVH6::InternalNode6>(stats, accel, node, time_range, node_bounds_area, root_bounds_area);
       break;
     }
     default:
@@ -120,7 +130,7 @@ namespace embree
   {
     BVHStatistics stats;
     if (empty()) return stats;
-    embree::computeStatistics(stats,root(),BBox1f(0,1),area(bounds),area(bounds),6);
+    embree::computeStatistics(stats,(const char*)this,root(),BBox1f(0,1),area(bounds),area(bounds),6);
     return stats;
   }
 
@@ -6,6 +6,7 @@
 #include "qbvh6.h"
 #include "statistics.h"
 #include "quadifier.h"
+#include "morton.h"
 #include "rtbuild.h"
 #include <atomic>
 
@@ -13,12 +14,16 @@
 #include "builders/priminfo.h"
 #include "builders/primrefgen_presplit.h"
 #include "builders/heuristic_binning_array_aligned.h"
+#include "builders/heuristic_spatial_array.h"
 #include "algorithms/parallel_for_for_prefix_sum.h"
+#include "algorithms/parallel_sort.h"
 #else
 #include "../../builders/priminfo.h"
 #include "../../builders/primrefgen_presplit.h"
 #include "../../builders/heuristic_binning_array_aligned.h"
+#include "../../builders/heuristic_spatial_array.h"
 #include "../../../common/algorithms/parallel_for_for_prefix_sum.h"
+#include "../../../common/algorithms/parallel_sort.h"
 #endif
 
 namespace embree
@@ -33,42 +38,218 @@ namespace embree
       /* the type of primitive that is referenced */
       enum Type { TRIANGLE=0, QUAD=1, PROCEDURAL=2, INSTANCE=3, UNKNOWN=4, NUM_TYPES=5 };
 
-      /* check when we use spatial splits */
+      /* check when we use spatial splits, these duplicate primitive references and are thus disabled for compact builds */
       static bool useSpatialSplits(ze_rtas_builder_build_quality_hint_exp_t build_quality, ze_rtas_builder_build_op_exp_flags_t build_flags) {
-        return build_quality == ZE_RTAS_BUILDER_BUILD_QUALITY_HINT_EXP_HIGH && !(build_flags & ZE_RTAS_BUILDER_BUILD_OP_EXP_FLAG_NO_DUPLICATE_ANYHIT_INVOCATION);
+        return build_quality == ZE_RTAS_BUILDER_BUILD_QUALITY_HINT_EXP_HIGH && !(build_flags & (ZE_RTAS_BUILDER_BUILD_OP_EXP_FLAG_NO_DUPLICATE_ANYHIT_INVOCATION | ZE_RTAS_BUILDER_BUILD_OP_EXP_FLAG_COMPACT));
       }
 
-      /* BVH allocator */
+      /* Records with free slots behind their primitive range may use a
+       * spatial split instead of the object split. Spatial binning
+       * clips primitives and is only tried if the children of the object
+       * split overlap, and the spatial split has to lower the SAH. */
+      static constexpr float SPATIAL_SPLIT_OVERLAP_THRESHOLD = 0.5f; // minimal overlap area of the object split children relative to the record area
+      static constexpr float SPATIAL_SPLIT_SAH_THRESHOLD = 0.95f;     // maximal SAH of the spatial split relative to the SAH of the object split
+
+      /* The presplit budget is given as factor of the number of input
+       * primitives. The factor of triangles and quads depends on their
+       * shape and gets sampled per scene, instances always get a fifth
+       * more references. */
+      static constexpr double INSTANCE_PRESPLIT_FACTOR = 1.2;
+      static constexpr double MAX_PRESPLIT_FACTOR = 2.0;
+      static const size_t PRESPLIT_FACTOR_STEPS = 16;    // the factor gets rounded up to multiples of 1/16
+      static const size_t PRESPLIT_SAMPLES = 4096;       // maximal number of sampled triangles and quads
+      static constexpr float PRESPLIT_AREA_RATIO = 4.0f; // primitives whose bounds have more area are worth splitting
+
+      /* Estimates the presplit factor of triangles and quads from
+       * evenly spaced samples. As for the presplit priority the area of
+       * the bounds of a primitive gets compared to its projected area.
+       * Each sampled primitive whose bounds are mostly empty accounts
+       * for two additional references. The getMeshPrimitiveArea
+       * function returns false if the data of a geometry is not
+       * available yet, in that case the maximal factor is used. */
+      template<typename getSizeFunc, typename getTypeFunc, typename getMeshPrimitiveAreaFunc>
+      static double estimatePresplitFactor(size_t numGeometries,
+                                           const getSizeFunc& getSize,
+                                           const getTypeFunc& getType,
+                                           const getMeshPrimitiveAreaFunc& getMeshPrimitiveArea)
+      {
+        std::vector<size_t> meshPrimitivesPrefix(numGeometries+1,0);
+        for (size_t geomID=0; geomID<numGeometries; geomID++)
+        {
+          size_t N = getSize(geomID);
+          if (N && getType(geomID) != QBVH6BuilderSAH::TRIANGLE && getType(geomID) != QBVH6BuilderSAH::QUAD) N = 0;
+          meshPrimitivesPrefix[geomID+1] = meshPrimitivesPrefix[geomID] + N;
+        }
+
+        const size_t numMeshPrimitives = meshPrimitivesPrefix[numGeometries];
+        const size_t numSamples = std::min(numMeshPrimitives,size_t(PRESPLIT_SAMPLES));
+        size_t numValid = 0;
+        size_t numSplit = 0;
+        
+        for (size_t i=0; i<numSamples; i++)
+        {
+          const size_t index = (2*i+1)*numMeshPrimitives/(2*numSamples);
+          const size_t geomID = std::upper_bound(meshPrimitivesPrefix.begin(),meshPrimitivesPrefix.end(),index) - meshPrimitivesPrefix.begin() - 1;
+          
+          BBox3fa bounds = empty;
+          float primArea = 0.0f;
+          if (!getMeshPrimitiveArea((uint32_t)geomID,(uint32_t)(index-meshPrimitivesPrefix[geomID]),bounds,primArea))
+            return MAX_PRESPLIT_FACTOR;
+          
+          if (bounds.empty()) continue;
+          numValid++;
+          numSplit += primArea > 0.0f && area(bounds) > PRESPLIT_AREA_RATIO*primArea;
+        }
+        
+        if (numValid == 0) return 1.0;
+        const double factor = std::min(1.0 + 2.0*double(numSplit)/double(numValid), MAX_PRESPLIT_FACTOR);
+        return std::ceil(factor*PRESPLIT_FACTOR_STEPS)/PRESPLIT_FACTOR_STEPS;
+      }
+
+      /* BVH allocator, for measure builds the data buffer is nullptr
+       * and allocations only count the required bytes, the returned
+       * addresses are then relative to a dummy base address and must
+       * never get dereferenced. Small
+       * allocations can get served from per-thread blocks taken from
+       * the shared buffer, such that threads building different
+       * subtrees do not contend on the shared pointer. */
       struct Allocator
       {
+        static const size_t THREAD_BLOCK_BYTES = 8192;    // bytes a thread takes from the shared buffer at once
+        static const size_t MAX_THREAD_BLOCK_ALLOC = 512; // larger allocations always use the shared buffer
+        static const uintptr_t MEASURE_BASE = 4096;       // non-null base address of measure builds, such that no allocation returns nullptr
+
+        struct __aligned(64) ThreadBlock
+        {
+          size_t cur = 0; // offset to allocate next data block from
+          size_t end = 0; // end offset of the block
+        };
+
         Allocator() {}
 
-        void init(char* data_in, size_t bytes_in) {
-          ptr = data_in;
+        /* upper bound of the bytes left unused in thread blocks when allocating usedBytes, as a block
+         * only gets replaced when an allocation does not fit, each replaced block is mostly used */
+        static size_t maxThreadBlockWaste(size_t usedBytes, size_t numThreads) {
+          return usedBytes/(THREAD_BLOCK_BYTES/MAX_THREAD_BLOCK_ALLOC-1) + numThreads*THREAD_BLOCK_BYTES;
+        }
+
+        void init(char* data_in, size_t bytes_in, size_t numThreadBlocks = 0) {
+          base = data_in ? (uintptr_t) data_in : MEASURE_BASE;
           end = bytes_in;
           cur.store(0);
+          wasted.store(0);
+          threadBlocks.clear();
+          threadBlocks.resize(numThreadBlocks);
         }
 
         size_t bytesAllocated() const {
           return cur.load();
         }
 
+        /* bytes taken from the shared buffer by thread blocks that did not get used */
+        size_t bytesUnused() const
+        {
+          size_t bytes = wasted.load();
+          for (const ThreadBlock& block : threadBlocks)
+            bytes += block.end - block.cur;
+          return bytes;
+        }
+
         __forceinline void* malloc(size_t bytes, size_t align = 16)
         {
           assert(align <= 128); //ZE_RAYTRACING_ACCELERATION_STRUCTURE_ALIGNMENT_EXT
-          if (unlikely(cur.load() >= end)) return nullptr;
+          if (bytes <= MAX_THREAD_BLOCK_ALLOC && align <= 64 && threadBlocks.size())
+          {
+            const size_t threadIndex = TaskScheduler::threadIndex();
+            if (threadIndex < threadBlocks.size())
+              return mallocThreadBlock(threadBlocks[threadIndex],bytes,align);
+          }
+
+          size_t offset;
+          if (unlikely(!mallocShared(bytes,align,offset))) return nullptr;
+          return (void*) (base + offset);
+        }
+
+      private:
+        
+        __forceinline bool mallocShared(size_t bytes, size_t align, size_t& offset)
+        {
+          if (unlikely(cur.load() >= end)) return false;
           const size_t extra = (align - cur) & (align-1);
           const size_t bytes_align = bytes + extra;
           const size_t cur_old = cur.fetch_add(bytes_align);
           const size_t cur_new = cur_old + bytes_align;
-          if (unlikely(cur_new >= end)) return nullptr;
-          return &ptr[cur_old + extra];
+          if (unlikely(cur_new > end)) return false;
+          offset = cur_old + extra;
+          return true;
         }
 
+        __forceinline void* mallocThreadBlock(ThreadBlock& block, size_t bytes, size_t align)
+        {
+          size_t extra = (align - block.cur) & (align-1);
+          if (unlikely(block.cur + extra + bytes > block.end))
+          {
+            size_t offset;
+            if (unlikely(!mallocShared(THREAD_BLOCK_BYTES,64,offset))) return nullptr;
+            wasted += block.end - block.cur;
+            block.cur = offset;
+            block.end = offset + THREAD_BLOCK_BYTES;
+            extra = 0;
+          }
+          void* data = (void*) (base + block.cur + extra);
+          block.cur += extra + bytes;
+          return data;
+        }
+        
       private:
-        char* ptr = nullptr;                       // data buffer pointer
+        uintptr_t base = 0;                        // address of the data buffer, MEASURE_BASE for measure builds
         size_t end = 0;                            // size of data buffer in bytes
         __aligned(64) std::atomic<size_t> cur = 0; // current pointer to allocate next data block from
+        std::atomic<size_t> wasted = 0;            // unused bytes of replaced thread blocks
+        std::vector<ThreadBlock> threadBlocks;     // allocation block of each thread, empty if not used
+      };
+
+      /* Header at the start of the scratch buffer. When a build runs
+       * out of RTAS memory the quadification table and final primref
+       * array stay in the scratch buffer and the header marks them as
+       * resumable, such that a retry with the same inputs can directly
+       * continue with the hierarchy build. The input hash covers the
+       * content of all geometries, thus builds whose content cannot
+       * get hashed never mark the scratch buffer as resumable. */
+      struct __aligned(64) ScratchHeader
+      {
+        static const uint64_t RESUMABLE = 0x454D55534552ULL;
+
+        uint64_t magick;     // RESUMABLE if the scratch buffer content can get reused
+        uint64_t inputHash;  // hash of the build inputs the scratch buffer content was created for
+        size_t numPrimRefs;  // number of primrefs after presplitting
+        PrimInfo pinfo;      // bounds of all primrefs
+      };
+
+      /* Morton code of the primitive centroid with the type in the upper 2 bits, and the index of the primitive before sorting */
+      struct MortonKey
+      {
+        MortonKey () {}
+        MortonKey (uint32_t code, uint32_t index)
+          : index(index), code(code) {}
+        
+        __forceinline operator uint32_t() const { return code; }
+
+        uint32_t index;
+        uint32_t code;
+      };
+
+      /* temporary host buffers of a build, kept alive by the builder such that
+       * repeated builds do not have to allocate them again */
+      struct BuildArena
+      {
+        std::vector<uint16_t*> quadification;     // start of the quadification table of each geometry
+        std::vector<uint16_t> quadificationData;  // only used if quadification table does not fit into scratch buffer
+        std::vector<PresplitItem> presplitItemsData; // only used if presplit items do not fit into scratch buffer
+        std::vector<MortonKey> mortonKeys;        // sorted Morton keys, only used for LOW quality builds
+        std::vector<MortonKey> mortonKeysTmp;     // temporary keys for radix sort
+        std::vector<PrimRef> primsTmp;            // copy of primrefs for Morton reordering and compaction
+        std::vector<char> layoutData;             // copy of the BVH, only used if the layout gets optimized
       };
 
       /* triangle data for leaf creation */
@@ -135,6 +316,7 @@ namespace embree
         size_t numQuads = 0;
         size_t numProcedurals = 0;
         size_t numInstances = 0;
+        size_t numPresplitItems = 0; // presplitting uses two items per primitive before splitting
         
         /* assume some reasonable quadification rate */
         void estimate_quadification()
@@ -143,11 +325,11 @@ namespace embree
           numTriangles = 0;
         }
         
-        void estimate_presplits( double factor )
+        void estimate_presplits( double meshFactor, double instanceFactor )
         {
-          numTriangles = max(numTriangles, size_t(numTriangles*factor));
-          numQuads     = max(numQuads    , size_t(numQuads*factor));
-          numInstances = max(numInstances, size_t(numInstances*factor));
+          numTriangles = max(numTriangles, size_t(numTriangles*meshFactor));
+          numQuads     = max(numQuads    , size_t(numQuads*meshFactor));
+          numInstances = max(numInstances, size_t(numInstances*instanceFactor));
         }
         
         size_t size() {
@@ -162,17 +344,21 @@ namespace embree
           return (bytes+127)&-128;
         }
         
-        size_t worst_case_bvh_bytes()
+        size_t worst_case_bvh_bytes_unpadded()
         {
           const size_t numPrimitives = size();
           const size_t blocks = (numPrimitives+5)/6;
-          const size_t worst_case_bytes = 128 + 64*(1+blocks + numPrimitives) + numTriangles*64 + numQuads*64 + numProcedurals*64 + numInstances*128;
-          const size_t bytes = 2*4096 + size_t(1.1*worst_case_bytes); // FIXME: FastAllocator wastes memory and always allocates 4kB per thread
+          return 128 + 64*(1+blocks + numPrimitives) + numTriangles*64 + numQuads*64 + numProcedurals*64 + numInstances*128;
+        }
+        
+        size_t worst_case_bvh_bytes()
+        {
+          const size_t bytes = 2*4096 + size_t(1.1*worst_case_bvh_bytes_unpadded()); // FIXME: FastAllocator wastes memory and always allocates 4kB per thread
           return (bytes+127)&-128;
         }
         
         size_t scratch_space_bytes() {
-          return size()*sizeof(PrimRef)+64;  // 64 to align to 64 bytes
+          return sizeof(ScratchHeader) + size()*sizeof(PrimRef) + numPresplitItems*sizeof(PresplitItem) + numTriangles*sizeof(uint16_t) + 256;  // 256 to align scratch buffer, primref array, presplit items, and quadification table to 64 bytes
         }
       };
       
@@ -184,6 +370,20 @@ namespace embree
         size_t sahBlockSize = 6;     //!< blocksize for SAH heuristic
         size_t leafSize[NUM_TYPES] = { 9,9,6,6,6 }; //!< target size of a leaf
         size_t typeSplitSize = 128;  //!< number of primitives when performing type splitting
+        size_t singleThreadThreshold = 1024; //!< nodes with fewer primitives get built by a single thread
+        bool concurrentSplits = true; //!< split children of similar area concurrently while filling a node
+
+        /* high quality builds split the child with largest area one by one, as concurrent splits change the topology */
+        void setHighQuality() {
+          concurrentSplits = false;
+        }
+
+        /* compact builds fill fat quad leaves up to 6 children with 3 quads each, which saves internal nodes */
+        void setCompact()
+        {
+          leafSize[TRIANGLE] = 12;
+          leafSize[QUAD] = 12;
+        }
       };
       
       /*! recursive state of builder */
@@ -193,7 +393,10 @@ namespace embree
         __forceinline BuildRecord () {}
         
         __forceinline BuildRecord (size_t depth, const PrimInfoRange& prims, Type type)
-          : depth(depth), prims(prims), type(type) {}
+          : depth(depth), prims(prims), type(type), ext_end(prims.end()) {}
+        
+        __forceinline BuildRecord (size_t depth, const PrimInfoRange& prims, Type type, size_t ext_end)
+          : depth(depth), prims(prims), type(type), ext_end(ext_end) {}
         
         __forceinline BBox3fa bounds() const { return prims.geomBounds; }
         
@@ -203,16 +406,18 @@ namespace embree
         __forceinline size_t begin() const { return prims.begin(); }
         __forceinline size_t end  () const { return prims.end(); }
         __forceinline size_t size () const { return prims.size(); }
+        __forceinline size_t ext_size () const { return ext_end - prims.end(); }
         __forceinline bool   equalType() const { return type != UNKNOWN; }
         
         friend inline std::ostream& operator<<(std::ostream& cout, const BuildRecord& r) {
-          return cout << "BuildRecord { depth = " << r.depth << ", pinfo = " << r.prims << ", type = " << r.type << " }";
+          return cout << "BuildRecord { depth = " << r.depth << ", pinfo = " << r.prims << ", type = " << r.type << ", ext_end = " << r.ext_end << " }";
         }
         
       public:
         size_t depth;        //!< Depth of the root of this subtree.
         PrimInfoRange prims; //!< The list of primitives.
         Type type;           //!< shared type when type of primitives are equal otherwise UNKNOWN
+        size_t ext_end;      //!< end of the free slots behind the primitives, spatial splits store duplicated references there
       };
       
       struct PrimRange
@@ -304,12 +509,15 @@ namespace embree
                typename getTriangleIndicesFunc,
                typename getQuadFunc,
                typename getProceduralFunc,
-               typename getInstanceFunc>
+               typename getInstanceFunc,
+               typename getContentHashFunc>
       class BuilderT
       {
       public:
         static const size_t BINS = 32;
         typedef HeuristicArrayBinningSAH<PrimRef,BINS> CentroidBinner;
+        typedef HeuristicArraySpatialSAH<PrimRef,BINS> SpatialBinner;
+        static constexpr float CONCURRENT_SPLIT_AREA_THRESHOLD = 0.7f; // minimal area relative to the largest child to get split in the same round
         
         BuilderT (Device* device,
                   const getSizeFunc& getSize,
@@ -320,11 +528,13 @@ namespace embree
                   const getQuadFunc& getQuad,
                   const getProceduralFunc& getProcedural,
                   const getInstanceFunc& getInstance,
+                  const getContentHashFunc& getContentHash,
                   void* scratch_ptr, size_t scratch_bytes,
                   ze_rtas_format_exp_t rtas_format,
                   ze_rtas_builder_build_quality_hint_exp_t build_quality,
                   ze_rtas_builder_build_op_exp_flags_t build_flags,
-                  bool verbose)
+                  bool verbose,
+                  BuildArena& arena)
           : getSize(getSize),
             getType(getType),
             createPrimRefArray(createPrimRefArray),
@@ -333,17 +543,41 @@ namespace embree
             getQuad(getQuad),
             getProcedural(getProcedural),
             getInstance(getInstance),
+            getContentHash(getContentHash),
+            scratch_ptr((char*)scratch_ptr),
+            scratch_bytes(scratch_bytes),
             prims(scratch_ptr,scratch_bytes),
+            mortonKeys(arena.mortonKeys),
+            mortonKeysTmp(arena.mortonKeysTmp),
+            primsTmp(arena.primsTmp),
+            layoutData(arena.layoutData),
+            quadification(arena.quadification),
+            quadificationData(arena.quadificationData),
+            presplitItemsData(arena.presplitItemsData),
             rtas_format((ze_raytracing_accel_format_internal_t)rtas_format),
             build_quality(build_quality),
             build_flags(build_flags),
-            verbose(verbose) {} 
+            verbose(verbose)
+        {
+          if (build_flags & ZE_RTAS_BUILDER_BUILD_OP_EXP_FLAG_COMPACT)
+            cfg.setCompact();
+          if (build_quality == ZE_RTAS_BUILDER_BUILD_QUALITY_HINT_EXP_HIGH)
+            cfg.setHighQuality();
+        }
+        
+        /* a measure build only allocates memory and does not write any nodes */
+        ReductionTy measuredNode(char* curAddr, size_t curBytes) {
+          return ReductionTy(curAddr, NODE_TYPE_INTERNAL, 0x00, PrimRange(curBytes/64));
+        }
         
         ReductionTy setInternalNode(char* curAddr, size_t curBytes, NodeType nodeTy, char* childAddr,
                                     BuildRecord children[BVH_WIDTH], ReductionTy values[BVH_WIDTH], size_t numChildren)
         {
           assert(curBytes >= sizeof(QBVH6::InternalNode6));
           assert(numChildren <= QBVH6::InternalNode6::NUM_CHILDREN);
+
+          if (measure)
+            return measuredNode(curAddr,curBytes);
           
           BBox3f bounds = empty;
           for (size_t i=0; i<numChildren; i++)
@@ -435,6 +669,9 @@ namespace embree
           if (!childData)
             return ReductionTy();
 
+          if (measure)
+            return measuredNode(curAddr,curBytes);
+
           /* create each child */
           ReductionTy values[BVH_WIDTH];
           for (size_t i=0, j=0; i<numChildren; i++) {
@@ -450,8 +687,11 @@ namespace embree
           const uint32_t numPrims MAYBE_UNUSED = curRecord.size();
           assert(numPrims <= QBVH6::InternalNode6::NUM_CHILDREN);
           
-          PrimRange ranges[QBVH6::InternalNode6::NUM_CHILDREN+1];
-          QBVH6::InternalNode6* qnode = new (curAddr) QBVH6::InternalNode6(curRecord.bounds(),NODE_TYPE_PROCEDURAL);
+          /* group primitives of the same geometry, this minimizes the number of
+           * procedural leaves and makes their number independent of primitive order */
+          std::sort(prims.data()+curRecord.begin(),prims.data()+curRecord.end(),[](const PrimRef& a, const PrimRef& b) {
+                                                                                   return std::make_pair(a.geomID(),a.primID()) < std::make_pair(b.geomID(),b.primID());
+                                                                                 });
           
           /* allocate data for all procedural leaves */
           size_t numGeometries = 1;
@@ -468,6 +708,12 @@ namespace embree
           if (!childData)
             return ReductionTy();
 
+          if (measure)
+            return measuredNode(curAddr,curBytes);
+
+          PrimRange ranges[QBVH6::InternalNode6::NUM_CHILDREN+1];
+          QBVH6::InternalNode6* qnode = new (curAddr) QBVH6::InternalNode6(curRecord.bounds(),NODE_TYPE_PROCEDURAL);
+
           ProceduralLeafBuilder procedural_leaf_builder(childData, numGeometries);
           ProceduralLeaf* first_procedural = procedural_leaf_builder.getCurProcedural();
           
@@ -504,6 +750,9 @@ namespace embree
           if (!childData)
             return ReductionTy();
 
+          if (measure)
+            return measuredNode(curAddr,curBytes);
+
           QBVH6::InternalNode6* qnode = new (curAddr) QBVH6::InternalNode6(curRecord.bounds(),NODE_TYPE_INSTANCE);
           qnode->setChildOffset(childData);
           
@@ -526,26 +775,30 @@ namespace embree
           return ReductionTy(curAddr, NODE_TYPE_INTERNAL, nodeMask, PrimRange(curBytes/64));
         }
         
-        /* finds the index of the child with largest surface area */
-        int findChildWithLargestArea(BuildRecord children[BVH_WIDTH], size_t numChildren, size_t leafThreshold)
+        /* finds the indices of up to maxChildren children with largest surface area, which get split in the same
+         * round. Further children are only included if their area is close to the largest one, as splitting the
+         * largest child first would otherwise produce larger children to split next. */
+        size_t findChildrenWithLargestArea(BuildRecord children[BVH_WIDTH], size_t numChildren, size_t leafThreshold, size_t maxChildren, int bestChildren[BVH_WIDTH])
         {
-          /*! find best child to split */
-          float bestArea = neg_inf;
-          int bestChild = -1;
+          size_t numBest = 0;
           for (uint32_t i=0; i<(uint32_t)numChildren; i++)
           {
             /* ignore leaves as they cannot get split */
             if (children[i].prims.size() <= leafThreshold) continue;
-            
-            /* find child with largest surface area */
-            const float area = halfArea(children[i].prims.geomBounds);
-            if (area > bestArea)
-            {
-              bestArea = area;
-              bestChild = i;
-            }
+            bestChildren[numBest++] = i;
           }
-          return bestChild;
+          if (numBest == 0) return 0;
+          
+          /* children of equal area keep their order */
+          std::stable_sort(bestChildren,bestChildren+numBest,[&](int a, int b) {
+                                                               return halfArea(children[a].prims.geomBounds) > halfArea(children[b].prims.geomBounds);
+                                                             });
+          
+          const float minArea = CONCURRENT_SPLIT_AREA_THRESHOLD*halfArea(children[bestChildren[0]].prims.geomBounds);
+          size_t num = 1;
+          while (num < std::min(numBest,maxChildren) && halfArea(children[bestChildren[num]].prims.geomBounds) >= minArea)
+            num++;
+          return num;
         }
         
         /* finds the index of the child with most primitives */
@@ -579,34 +832,175 @@ namespace embree
           return -1;
         }
         
-        void SAHSplit(size_t depth, size_t sahBlockSize, int bestChild, BuildRecord children[BVH_WIDTH], size_t& numChildren)
+        /* spatial binning clips the remaining part of a primitive at each bin border, thus the
+         * vertices of the triangle pair or quad get loaded only once */
+        struct PolygonSplitter
+        {
+          PolygonSplitter (const BuilderT& builder, const PrimRef& prim)
+            : numTriangles(0)
+          {
+            const uint32_t geomID = prim.geomID();
+            const uint32_t primID = prim.primID();
+            if (builder.getType(geomID) == QBVH6BuilderSAH::QUAD)
+            {
+              const Quad quad = builder.getQuad(geomID,primID);
+              const Vec3fa v[5] = { quad.p0, quad.p1, quad.p2, quad.p3, quad.p0 };
+              std::copy(v,v+5,q);
+              return;
+            }
+            
+            const uint16_t pair = builder.quadification[geomID][primID];
+            const Triangle tri0 = builder.getTriangle(geomID,primID);
+            const Vec3fa v0[4] = { tri0.p0, tri0.p1, tri0.p2, tri0.p0 };
+            std::copy(v0,v0+4,t[0]);
+            numTriangles = 1;
+            
+            if (pair != QUADIFIER_TRIANGLE)
+            {
+              const Triangle tri1 = builder.getTriangle(geomID,primID+pair);
+              const Vec3fa v1[4] = { tri1.p0, tri1.p1, tri1.p2, tri1.p0 };
+              std::copy(v1,v1+4,t[1]);
+              numTriangles = 2;
+            }
+          }
+          
+          void operator() (const BBox3fa& bounds, const size_t dim, const float pos, BBox3fa& left_o, BBox3fa& right_o) const
+          {
+            if (numTriangles == 0)
+              return splitPolygon<4>(bounds,dim,pos,q,left_o,right_o);
+
+            splitPolygon<3>(bounds,dim,pos,t[0],left_o,right_o);
+            if (numTriangles == 2)
+            {
+              BBox3fa left1,right1;
+              splitPolygon<3>(bounds,dim,pos,t[1],left1,right1);
+              left_o.extend(left1);
+              right_o.extend(right1);
+            }
+          }
+
+          uint32_t numTriangles; // zero for quads
+          Vec3fa t[2][4];        // vertices of the triangle pair, the first vertex is repeated
+          Vec3fa q[5];           // vertices of the quad
+        };
+        
+        static bool isSplittable(Type type) {
+          return type == QBVH6BuilderSAH::TRIANGLE || type == QBVH6BuilderSAH::QUAD;
+        }
+        
+        /* SBVH style spatial split, which clips the triangles and quads that straddle the split plane. It is
+         * performed if it has a lower SAH than the object split and the clipped parts fit into the free slots. */
+        bool SpatialSplit(const BuildRecord& brecord, size_t sahBlockSize, const CentroidBinner::Split& objectSplit, const SplitInfo& objectInfo,
+                          PrimInfoRange& linfo, PrimInfoRange& rinfo)
+        {
+          /* mostly disjoint children of the object split cannot get improved much */
+          if (objectSplit.valid())
+          {
+            const BBox3fa overlap = intersect(objectInfo.leftBounds,objectInfo.rightBounds);
+            if (safeArea(overlap) <= SPATIAL_SPLIT_OVERLAP_THRESHOLD*safeArea(brecord.bounds()))
+              return false;
+          }
+
+          auto splittable = [&] (const PrimRef& prim) {
+            return isSplittable(getType(prim.geomID()));
+          };
+          
+          auto splitter = [&] (const PrimRef& prim, const size_t dim, const float pos, PrimRef& left_o, PrimRef& right_o) {
+            splitTriangleOrQuad(prim,dim,pos,left_o,right_o);
+          };
+          
+          auto splitterFactory = [&] (const PrimRef& prim) {
+            return PolygonSplitter(*this,prim);
+          };
+          
+          SpatialBinner spatial_binner(prims.data());
+          const SpatialBinner::Split spatialSplit = spatial_binner.find_block_size(brecord.prims,sahBlockSize,splitterFactory,splittable);
+          if (!spatialSplit.valid() || spatialSplit.splitSAH() >= SPATIAL_SPLIT_SAH_THRESHOLD*objectSplit.splitSAH())
+            return false;
+
+          /* the binning estimates the number of clipped primitives */
+          if (size_t(spatialSplit.left)+size_t(spatialSplit.right) > brecord.size()+brecord.ext_size())
+            return false;
+
+          if (!spatial_binner.split(spatialSplit,brecord.prims,brecord.ext_end,splitter,splittable,linfo,rinfo))
+            return false;
+
+          numSpatialSplits += linfo.size()+rinfo.size()-brecord.size();
+
+          /* the clipped primitives may all end up on one side in degenerated cases */
+          if (linfo.size() == 0 || rinfo.size() == 0)
+          {
+            CentGeomBBox3fa bounds = linfo;
+            bounds.merge(rinfo);
+            deterministicFallbackSplit(PrimInfoRange(linfo.begin(),rinfo.end(),bounds),linfo,rinfo);
+          }
+          return true;
+        }
+
+        /* distributes the free slots of a record to both children proportional to their size, for
+         * that the right child gets moved behind the free slots that belong to the left child */
+        void splitExtendedRange(const BuildRecord& brecord, PrimInfoRange& linfo, PrimInfoRange& rinfo, size_t& lext_end, size_t& rext_end)
+        {
+          assert(linfo.end() == rinfo.begin());
+          const size_t lsize = linfo.size();
+          const size_t rsize = rinfo.size();
+          const size_t lfree = (brecord.ext_end-rinfo.end())*lsize/std::max(lsize+rsize,size_t(1));
+          
+          if (lfree)
+          {
+            /* only the first lfree primitives have to move if the ranges overlap */
+            const size_t src = rinfo.begin();
+            const size_t dst = lfree < rsize ? rinfo.end() : rinfo.begin()+lfree;
+            const size_t num = std::min(lfree,rsize);
+            parallel_for(size_t(0), num, size_t(4096), [&](const range<size_t>& r) {
+              memcpy((void*)&prims[dst+r.begin()],(void*)&prims[src+r.begin()],r.size()*sizeof(PrimRef));
+            });
+            rinfo = PrimInfoRange(rinfo.begin()+lfree,rinfo.end()+lfree,rinfo);
+          }
+          
+          lext_end = linfo.end()+lfree;
+          rext_end = brecord.ext_end;
+        }
+        
+        /* splits brecord into lrecord and rrecord, which may alias brecord */
+        void SAHSplit(size_t depth, size_t sahBlockSize, const BuildRecord brecord, BuildRecord& lrecord, BuildRecord& rrecord)
         {
           PrimInfoRange linfo, rinfo;
-          BuildRecord brecord = children[bestChild];
           
           /* first perform centroid binning */
           CentroidBinner centroid_binner(prims.data());
-          CentroidBinner::Split bestSplit = centroid_binner.find_block_size(brecord.prims,sahBlockSize);
+          SplitInfo objectInfo;
+          CentroidBinner::Split bestSplit = brecord.ext_size()
+            ? centroid_binner.find_block_size(brecord.prims,sahBlockSize,objectInfo)
+            : centroid_binner.find_block_size(brecord.prims,sahBlockSize);
           
-          /* now split the primitive list */
-          if (bestSplit.valid())
-            centroid_binner.split(bestSplit,brecord.prims,linfo,rinfo);
-          
-          /* the above techniques may fail, and we fall back to some brute force split in the middle */
-          else
-            centroid_binner.splitFallback(brecord.prims,linfo,rinfo);
+          /* records with free slots may perform a spatial split instead */
+          if (!brecord.ext_size() || !SpatialSplit(brecord,sahBlockSize,bestSplit,objectInfo,linfo,rinfo))
+          {
+            /* now split the primitive list */
+            if (bestSplit.valid())
+              centroid_binner.split(bestSplit,brecord.prims,linfo,rinfo);
+            
+            /* the above techniques may fail, and we fall back to some brute force split in the middle */
+            else
+              deterministicFallbackSplit(brecord.prims,linfo,rinfo);
+          }
           
-          children[bestChild  ] = BuildRecord(depth+1, linfo, brecord.type);
-          children[numChildren] = BuildRecord(depth+1, rinfo, brecord.type);
-          numChildren++;
+          size_t lext_end, rext_end;
+          splitExtendedRange(brecord,linfo,rinfo,lext_end,rext_end);
+          lrecord = BuildRecord(depth+1, linfo, brecord.type, lext_end);
+          rrecord = BuildRecord(depth+1, rinfo, brecord.type, rext_end);
         }
         
         void TypeSplit(size_t depth, int bestChild, BuildRecord children[BVH_WIDTH], size_t& numChildren)
         {
           BuildRecord brecord = children[bestChild];
           
+          /* split off the smallest type, such that the split does not depend on the primitive order */
           PrimInfoRange linfo, rinfo;
-          auto type = getType(prims[brecord.prims.begin()].geomID());
+          Type type = getType(prims[brecord.prims.begin()].geomID());
+          for (size_t i=brecord.prims.begin()+1; i<brecord.prims.end(); i++)
+            type = std::min(type,getType(prims[i].geomID()));
           performTypeSplit(getType,type,prims.data(),brecord.prims.get_range(),linfo,rinfo);
           
           for (size_t i=linfo.begin(); i<linfo.end(); i++)
@@ -617,17 +1011,34 @@ namespace embree
           for (size_t i=rinfo.begin()+1; i<rinfo.end(); i++)
             equalTy &= rtype == getType(prims[i].geomID());
           
-          children[bestChild  ] = BuildRecord(depth+1, linfo, type);
-          children[numChildren] = BuildRecord(depth+1, rinfo, equalTy ? rtype : UNKNOWN);
+          size_t lext_end, rext_end;
+          splitExtendedRange(brecord,linfo,rinfo,lext_end,rext_end);
+          children[bestChild  ] = BuildRecord(depth+1, linfo, type, lext_end);
+          children[numChildren] = BuildRecord(depth+1, rinfo, equalTy ? rtype : UNKNOWN, rext_end);
           numChildren++;
         }
         
+        /* total order of primitives, fragments of a presplit primitive share the ID and get ordered by their bounds */
+        static bool deterministicLess(const PrimRef& a, const PrimRef& b)
+        {
+          if (a.ID64() != b.ID64()) return a.ID64() < b.ID64();
+          return memcmp(&a,&b,sizeof(PrimRef)) < 0;
+        }
+        
+        /* splits in the middle after sorting by ID, thus the split does not depend on the
+         * primitive order which keeps the BVH size of a measure build exact */
+        void deterministicFallbackSplit(const PrimInfoRange& pinfo, PrimInfoRange& linfo, PrimInfoRange& rinfo)
+        {
+          parallel_sort(prims.data()+pinfo.begin(),pinfo.size(),deterministicLess);
+          performFallbackSplit(prims.data(),pinfo,linfo,rinfo);
+        }
+        
         void FallbackSplit(size_t depth, int bestChild, BuildRecord children[BVH_WIDTH], size_t& numChildren)
         {
           BuildRecord brecord = children[bestChild];
           
           PrimInfoRange linfo, rinfo;
-          performFallbackSplit(prims.data(),brecord.prims,linfo,rinfo);
+          deterministicFallbackSplit(brecord.prims,linfo,rinfo);
           
           children[bestChild  ] = BuildRecord(depth+1, linfo, brecord.type);
           children[numChildren] = BuildRecord(depth+1, rinfo, brecord.type);
@@ -667,8 +1078,8 @@ namespace embree
           
           else
           {
-            /*! initialize child list with first child */
-            children[0] = curRecord;
+            /*! initialize child list with first child, leaves do not use spatial splits */
+            children[0] = BuildRecord(curRecord.depth, curRecord.prims, curRecord.type);
             numChildren = 1;
             
             /*! split until node is full */
@@ -676,7 +1087,8 @@ namespace embree
             {
               const int bestChild = findChildWithMostPrimitives(children,numChildren,1);
               if (bestChild == -1) break;
-              SAHSplit(curRecord.depth,1,bestChild,children,numChildren);
+              SAHSplit(curRecord.depth,1,children[bestChild],children[bestChild],children[numChildren]);
+              numChildren++;
             }
             
             /* fallback in case largest leaf if still too large */
@@ -723,6 +1135,10 @@ namespace embree
           if (curRecord.depth > cfg.maxDepth)
             throw std::runtime_error("BVH too deep");
                       
+          /* the parallel partitioning leaves the primitives in an order that depends on the thread count */
+          if (deterministic)
+            std::sort(prims.data()+curRecord.begin(),prims.data()+curRecord.end(),deterministicLess);
+          
           /* all primitives have to have the same type */
           Type ty MAYBE_UNUSED = getType(prims[curRecord.begin()].geomID());
           for (size_t i=curRecord.begin(); i<curRecord.end(); i++)
@@ -807,12 +1223,24 @@ namespace embree
             }
           }
           
-          /*! perform SAH splits until node is full */
+          /*! perform SAH splits until node is full, in each round the children with largest area that
+           *  still fit into the node get split concurrently, as they cover disjoint primitive ranges,
+           *  high quality builds keep splitting only the child with largest area in each round */
           while (numChildren < BVH_WIDTH)
           {
-            const int bestChild = findChildWithLargestArea(children,numChildren,cfg.leafSize[curRecord.type]);
-            if (bestChild == -1) break;
-            SAHSplit(curRecord.depth,cfg.sahBlockSize,bestChild,children,numChildren);
+            int bestChildren[BVH_WIDTH];
+            const size_t maxSplits = cfg.concurrentSplits ? BVH_WIDTH-numChildren : 1;
+            const size_t numSplits = findChildrenWithLargestArea(children,numChildren,cfg.leafSize[curRecord.type],maxSplits,bestChildren);
+            if (numSplits == 0) break;
+
+            auto split = [&] (size_t i) {
+              SAHSplit(curRecord.depth,cfg.sahBlockSize,children[bestChildren[i]],children[bestChildren[i]],children[numChildren+i]);
+            };
+            if (numSplits > 1 && curRecord.size() > cfg.singleThreadThreshold)
+              parallel_for(numSplits,split);
+            else
+              for (size_t i=0; i<numSplits; i++) split(i);
+            numChildren += numSplits;
           }
           
           /* sort build records for faster shadow ray traversal */
@@ -826,7 +1254,7 @@ namespace embree
             return ReductionTy();
 
           /* spawn tasks */
-          if (curRecord.size() > 1024) // cfg.singleThreadThreshold
+          if (curRecord.size() > cfg.singleThreadThreshold)
           {
             std::atomic<bool> success = true;
             parallel_for(size_t(0), numChildren, [&] (const range<size_t>& r) {
@@ -861,10 +1289,153 @@ namespace embree
           }
         }
 
+        /* sorts all primitives by type and the Morton code of their centroid, the
+         * sorted keys are kept for the Morton hierarchy build */
+        void mortonSort(const PrimInfo& pinfo)
+        {
+          const size_t N = pinfo.size();
+          mortonKeys.resize(N);
+          mortonKeysTmp.resize(N);
+
+          /* use the same scale for all dimensions, such that splits remain useful for flat scenes */
+          const Vec3fa base  = pinfo.centBounds.lower;
+          const float  diag  = reduce_max(pinfo.centBounds.size());
+          const Vec3fa scale = Vec3fa(1023.0f / max(diag,1E-19f));
+          
+          /* the Morton codes of each range are temporarily stored in the radix sort buffer */
+          uint32_t* codes = (uint32_t*) mortonKeysTmp.data();
+          parallel_for(size_t(0), N, size_t(4096), [&](const range<size_t>& r) {
+            computeMortonCodes(prims.data()+r.begin(),r.size(),base,scale,codes+r.begin());
+            for (size_t i=r.begin(); i<r.end(); i++)
+            {
+              const uint32_t type = getType(prims[i].geomID());
+              mortonKeys[i] = MortonKey((type << 30) | codes[i],(uint32_t)i);
+            }
+          });
+          
+          radix_sort_u32(mortonKeys.data(),mortonKeysTmp.data(),N);
+
+          /* reorder primitives into Morton order */
+          primsTmp.assign(prims.begin(),prims.begin()+N);
+          parallel_for(size_t(0), N, size_t(4096), [&](const range<size_t>& r) {
+            for (size_t i=r.begin(); i<r.end(); i++)
+              prims[i] = primsTmp[mortonKeys[i].index];
+          });
+        }
+
+        /* computes bounds of a range of primitives */
+        PrimInfoRange computePrimInfoRange(size_t begin, size_t end)
+        {
+          const CentGeomBBox3fa bounds = parallel_reduce(begin, end, size_t(1024), size_t(4096), CentGeomBBox3fa(empty), [&](const range<size_t>& r) {
+              CentGeomBBox3fa b(empty);
+              for (size_t i=r.begin(); i<r.end(); i++) b.extend_center2(prims[i]);
+              return b;
+            }, [](const CentGeomBBox3fa& a, const CentGeomBBox3fa& b) { return CentGeomBBox3fa::merge2(a,b); });
+          return PrimInfoRange(begin,end,bounds);
+        }
+
+        /* splits a Morton sorted range at the highest bit its codes differ in, which
+         * also separates primitives of different type as the type is stored in the top bits */
+        size_t MortonSplit(const range<size_t>& r)
+        {
+          const uint32_t code0 = mortonKeys[r.begin()].code;
+          const uint32_t code1 = mortonKeys[r.end()-1].code;
+
+          /* split in the middle if all codes are equal, sorting by ID makes the split independent of primitive order */
+          if (code0 == code1) {
+            parallel_sort(prims.data()+r.begin(),r.size(),std::less<PrimRef>());
+            return (r.begin()+r.end())/2;
+          }
+
+          const uint32_t bit = 1u << bsr(code0 ^ code1);
+          const size_t center = std::partition_point(mortonKeys.data()+r.begin(),mortonKeys.data()+r.end(),[&](const MortonKey& k) { return !(k.code & bit); }) - mortonKeys.data();
+          assert(center > r.begin() && center < r.end());
+          return center;
+        }
+
+        Type getRangeType(size_t begin, size_t end) const
+        {
+          const uint32_t type0 = mortonKeys[begin].code >> 30;
+          const uint32_t type1 = mortonKeys[end-1].code >> 30;
+          return type0 == type1 ? (Type) type0 : UNKNOWN;
+        }
+
+        /* creates hierarchy for LOW quality builds directly from the Morton sorted primitives */
+        const ReductionTy createMortonNode(const BuildRecord& curRecord, char* curAddr, size_t curBytes)
+        {
+          /* create leaf when threshold reached or we are too deep */
+          const bool createLeaf = curRecord.equalType() &&
+            (curRecord.size() <= cfg.leafSize[curRecord.type] || curRecord.depth+MIN_LARGE_LEAF_LEVELS >= cfg.maxDepth);
+          
+          if (createLeaf)
+            return createLargeLeaf(curRecord,curAddr,curBytes);
+          
+          /*! split children until node is full, only ranges get computed here */
+          range<size_t> ranges[BVH_WIDTH];
+          ranges[0] = range<size_t>(curRecord.begin(),curRecord.end());
+          size_t numChildren = 1;
+          
+          while (numChildren < BVH_WIDTH)
+          {
+            int bestChild = -1;
+            size_t bestSize = 0;
+            for (size_t i=0; i<numChildren; i++)
+            {
+              const size_t size = ranges[i].size();
+              const Type type = getRangeType(ranges[i].begin(),ranges[i].end());
+              if (type != UNKNOWN && size <= cfg.leafSize[type]) continue;
+              if (size > bestSize) { bestSize = size; bestChild = (int) i; }
+            }
+            if (bestChild == -1) break;
+
+            const size_t center = MortonSplit(ranges[bestChild]);
+            ranges[numChildren++] = range<size_t>(center,ranges[bestChild].end());
+            ranges[bestChild] = range<size_t>(ranges[bestChild].begin(),center);
+          }
+
+          /* compute bounds of all children */
+          ReductionTy values[BVH_WIDTH];
+          BuildRecord children[BVH_WIDTH];
+          for (size_t i=0; i<numChildren; i++) {
+            const PrimInfoRange pinfo = computePrimInfoRange(ranges[i].begin(),ranges[i].end());
+            children[i] = BuildRecord(curRecord.depth+1,pinfo,getRangeType(ranges[i].begin(),ranges[i].end()));
+          }
+
+          /*! allocate data for all children */
+          size_t childrenBytes = numChildren*sizeof(QBVH6::InternalNode6);
+          char* childBase = (char*) allocator.malloc(childrenBytes, 64);
+
+          if (!childBase)
+            return ReductionTy();
+
+          /* recurse into each child, in parallel for large subtrees */
+          std::atomic<bool> success = true;
+          auto recurse = [&] (size_t i) {
+            values[i] = createMortonNode(children[i],childBase+i*sizeof(QBVH6::InternalNode6),sizeof(QBVH6::InternalNode6));
+            if (!values[i].valid()) success = false;
+          };
+          
+          if (curRecord.size() > cfg.singleThreadThreshold)
+          {
+            parallel_for(size_t(0), numChildren, [&] (const range<size_t>& r) {
+              for (size_t i=r.begin(); i<r.end() && success; i++) recurse(i);
+            });
+          }
+          else
+          {
+            for (size_t i=0; i<numChildren && success; i++) recurse(i);
+          }
+
+          if (!success)
+            return ReductionTy();
+
+          return setNode(curAddr,curBytes,NODE_TYPE_INTERNAL,childBase,children,values,numChildren);
+        }
+        
         const ReductionTy createEmptyNode(char* addr)
         {
           const size_t curBytes = sizeof(QBVH6::InternalNode6);
-          new (addr) QBVH6::InternalNode6(NODE_TYPE_INTERNAL);
+          if (!measure) new (addr) QBVH6::InternalNode6(NODE_TYPE_INTERNAL);
           return ReductionTy(addr, NODE_TYPE_INTERNAL, 0x00, PrimRange(curBytes/64));
         }
         
@@ -946,20 +1517,48 @@ namespace embree
           }
         }
 
-        void openInstance(const PrimRef& prim,
-                          const unsigned int splitprims,
-                          PrimRef subPrims[MAX_PRESPLITS_PER_PRIMITIVE],
-                          unsigned int& numSubPrims)
+        /* The nodes openInstance creates only depend on the instantiated
+         * BVH and the number of requested sub-primitives. Thus each BVH
+         * gets opened once and all its instances just transform the
+         * cached node bounds. Opening step k replaces the node with the
+         * largest surface area by its children. Node i got created by
+         * step nodes[i].created and got opened by step nodes[i].opened,
+         * thus the nodes after k steps are the ones with
+         * created <= k < opened. */
+        struct OpenedInstance
+        {
+          struct Node
+          {
+            BBox3f bounds;      // object space bounds of the node
+            int32_t ofs;        // offset of the node to the root node in 64 byte blocks
+            uint32_t created;   // step that created the node
+            uint32_t opened;    // step that opened the node, or UINT_MAX
+          };
+
+          OpenedInstance (void* accel)
+            : accel(accel) {}
+
+          bool operator< (const OpenedInstance& other) const {
+            return accel < other.accel;
+          }
+          
+          void* accel;
+          std::vector<Node> nodes;
+          std::vector<uint32_t> numNodes; // number of nodes after each step
+        };
+
+        void openInstanceNodes(OpenedInstance& opened)
         {
           struct Item
           {
             QBVH6::InternalNode6* node;
             float priority;
+            uint32_t index;
 
             Item () {}
             
-            Item (QBVH6::InternalNode6* node)
-              : node(node), priority(halfArea(node->bounds()))
+            Item (QBVH6::InternalNode6* node, uint32_t index)
+              : node(node), priority(halfArea(node->bounds())), index(index)
             {
               /* fat leaves cannot get opened */
               if (node->isFatLeaf())
@@ -970,24 +1569,24 @@ namespace embree
               return priority < other.priority;
             }
           };
-          
-          const uint32_t targetSubPrims = splitprims;
-          const uint32_t geomID = prim.geomID();
-          const uint32_t primID MAYBE_UNUSED = prim.primID();
-          assert(primID == 0); // has to be zero as we encode root offset here
 
-          const Instance instance = getInstance(geomID,0);
-          QBVH6::InternalNode6* root = static_cast<QBVH6*>(instance.accel)->root().innerNode<QBVH6::InternalNode6>();
+          QBVH6::InternalNode6* root = static_cast<QBVH6*>(opened.accel)->root().innerNode<QBVH6::InternalNode6>();
+
+          auto createNode = [&] (QBVH6::InternalNode6* node, uint32_t step) -> Item
+          {
+            const int64_t ofs = ((int64_t)node-(int64_t)root)/64;
+            assert(ofs >= INT_MIN && ofs <= INT_MAX);
+            opened.nodes.push_back({ node->bounds(), (int32_t) ofs, step, UINT_MAX });
+            return Item(node, (uint32_t) opened.nodes.size()-1);
+          };
           
           darray_t<Item,MAX_PRESPLITS_PER_PRIMITIVE> heap;
-          heap.push_back(root);
+          heap.push_back(createNode(root,0));
+          opened.numNodes.push_back(1);
 
+          /* open until the sub-primitive limit is reached, smaller requests stop at an earlier step */
           while (heap.size() + (QBVH6::InternalNode6::NUM_CHILDREN-1) <= MAX_PRESPLITS_PER_PRIMITIVE)
           {
-            /* terminate when budget exceeded */
-            if (heap.size() >= targetSubPrims)
-              break;
-
             /* get top heap element */
             std::pop_heap(heap.begin(), heap.end());
             auto top = heap.back();
@@ -996,23 +1595,64 @@ namespace embree
             if (top.priority == 0.0f) break;
             heap.pop_back();
 
+            const uint32_t step = (uint32_t) opened.numNodes.size();
+            opened.nodes[top.index].opened = step;
+            
             /* add all children to the heap */
             for (uint32_t i=0; i<QBVH6::InternalNode6::NUM_CHILDREN; i++)
             {
               if (!top.node->valid(i)) continue;
-              heap.push_back(top.node->child(i).template innerNode<QBVH6::InternalNode6>());
+              heap.push_back(createNode(top.node->child(i).template innerNode<QBVH6::InternalNode6>(),step));
               std::push_heap(heap.begin(), heap.end());
             }
+            opened.numNodes.push_back((uint32_t) heap.size());
           }
+        }
+
+        /* opens each instantiated BVH once, such that presplitting scales with the number of instances */
+        void openInstances(uint32_t numGeometries)
+        {
+          std::vector<uint64_t> accels(numGeometries), accelsTmp(numGeometries);
+          parallel_for(size_t(0), size_t(numGeometries), size_t(1024), [&](const range<size_t>& r) {
+            for (size_t geomID=r.begin(); geomID<r.end(); geomID++)
+              accels[geomID] = getSize(geomID) && getType(geomID) == QBVH6BuilderSAH::INSTANCE ? (uint64_t) getInstance((unsigned int)geomID,0).accel : 0;
+          });
+          radix_sort_u64(accels.data(),accelsTmp.data(),accels.size());
+          accels.erase(std::unique(accels.begin(),accels.end()),accels.end());
+          
+          openedInstances.clear();
+          for (uint64_t accel : accels)
+            if (accel) openedInstances.emplace_back((void*)accel);
+
+          parallel_for(openedInstances.size(), [&](size_t i) {
+            openInstanceNodes(openedInstances[i]);
+          });
+        }
+        
+        void openInstance(const PrimRef& prim,
+                          const unsigned int splitprims,
+                          PrimRef subPrims[MAX_PRESPLITS_PER_PRIMITIVE],
+                          unsigned int& numSubPrims)
+        {
+          const uint32_t geomID = prim.geomID();
+          const uint32_t primID MAYBE_UNUSED = prim.primID();
+          assert(primID == 0); // has to be zero as we encode root offset here
+
+          const Instance instance = getInstance(geomID,0);
+          auto opened = std::lower_bound(openedInstances.begin(),openedInstances.end(),OpenedInstance(instance.accel));
+          assert(opened != openedInstances.end() && opened->accel == instance.accel);
+
+          /* the first step that reaches the requested number of sub-primitives */
+          uint32_t step = 0;
+          while (step+1 < opened->numNodes.size() && opened->numNodes[step] < splitprims)
+            step++;
 
           /* create primrefs */
-          for (size_t i=0; i<heap.size(); i++)
+          for (const typename OpenedInstance::Node& node : opened->nodes)
           {
-            QBVH6::InternalNode6* node = heap[i].node;
-            BBox3fa bounds = xfmBounds(instance.local2world,node->bounds());
-            int64_t ofs = ((int64_t)node-(int64_t)root)/64;
-            assert(ofs >= INT_MIN && ofs <= INT_MAX);
-            subPrims[numSubPrims++] = PrimRef(bounds,geomID,(int32_t)ofs);
+            if (node.created > step || node.opened <= step) continue;
+            const BBox3fa bounds = xfmBounds(instance.local2world,node.bounds);
+            subPrims[numSubPrims++] = PrimRef(bounds,geomID,node.ofs);
           }
         }
 
@@ -1058,27 +1698,88 @@ namespace embree
           }
         }
 
-        ReductionTy build(uint32_t numGeometries, PrimInfo& pinfo_o, char* root)
+        static uint64_t toNanoseconds(double seconds) {
+          return uint64_t(seconds*1E9);
+        }
+
+        PrimInfo createPrimRefs(uint32_t numGeometries, bool hasInstances)
         {
-          double t1 = verbose ? getSeconds() : 0.0;
+          const size_t numInputPrimitives = prims.size();
+          double t1 = timing ? getSeconds() : 0.0;
 
-          /* quadify all triangles */
+          /* quadify all triangles, each task pairs the triangles from the first even primitive ID of its range on,
+           * such that triangle strips, where triangle 2i pairs with triangle 2i+1, keep all pairs at task borders */
+          auto pairBorder = [&] (size_t geomID, size_t primID) -> size_t {
+            return std::min((primID+1) & ~size_t(1), getSize(geomID));
+          };
+          
           ParallelForForPrefixSumState<PrimInfo> pstate;
-          pstate.init(numGeometries,getSize,size_t(1024));
+          pstate.init(numGeometries,getSize,size_t(1024),deterministic ? size_t(ParallelForForState::MAX_TASKS) : TaskScheduler::threadCount());
           PrimInfo pinfo = parallel_for_for_prefix_sum0_( pstate, size_t(1), getSize, PrimInfo(empty), [&](size_t geomID, const range<size_t>& r, size_t k) -> PrimInfo {
             if (getType(geomID) == QBVH6BuilderSAH::TRIANGLE)
-              return PrimInfo(pair_triangles(geomID,(QuadifierType*) quadification[geomID].data(), r.begin(), r.end(), getTriangleIndices));
+              return PrimInfo(pair_triangles(geomID,(QuadifierType*) quadification[geomID], (uint32_t)pairBorder(geomID,r.begin()), (uint32_t)pairBorder(geomID,r.end()), getTriangleIndices));
             else
               return PrimInfo(r.size());
           }, [](const PrimInfo& a, const PrimInfo& b) -> PrimInfo { return PrimInfo::merge(a,b); });
 
-          double t2 = verbose ? getSeconds() : 0.0;
-          if (verbose) std::cout << "quadification: " << std::setw(10) << (t2-t1)*1000.0 << "ms, " << std::endl; //<< std::setw(10) << 1E-6*double(numTriangles)/(t2-t1) << " Mtris/s" << std::endl;
+          /* each task quadified its range independently, thus pair triangles across task borders inside a geometry */
+          if (pstate.taskCount > 1)
+          {
+            parallel_for(size_t(1), pstate.taskCount, [&](const range<size_t>& r)
+            {
+              for (size_t taskIndex=r.begin(); taskIndex<r.end(); taskIndex++)
+              {
+                const size_t geomID = pstate.i0[taskIndex];
+                const size_t primIDm = pairBorder(geomID,pstate.j0[taskIndex]);
+                if (primIDm == 0 || primIDm >= getSize(geomID) || getType(geomID) != QBVH6BuilderSAH::TRIANGLE)
+                  continue;
+
+                const size_t primID0 = pstate.i0[taskIndex-1] == geomID ? pairBorder(geomID,pstate.j0[taskIndex-1]) : 0;
+                const size_t primID1 = taskIndex+1 < pstate.taskCount && pstate.i0[taskIndex+1] == geomID ? pairBorder(geomID,pstate.j0[taskIndex+1]) : getSize(geomID);
+                const size_t numPairs = stitch_triangles((uint32_t)geomID,(QuadifierType*) quadification[geomID], (uint32_t)primID0, (uint32_t)primIDm, (uint32_t)primID1, getTriangleIndices);
+                pstate.prefix_state.counts[taskIndex] = PrimInfo(pstate.prefix_state.counts[taskIndex].size()-numPairs);
+              }
+            });
+
+            /* the triangle before an odd task border got quadified by the previous task, but its primref belongs to the next task */
+            for (size_t taskIndex=1; taskIndex<pstate.taskCount; taskIndex++)
+            {
+              const size_t geomID = pstate.i0[taskIndex];
+              const size_t primID = pstate.j0[taskIndex];
+              if (primID == pairBorder(geomID,primID) || getType(geomID) != QBVH6BuilderSAH::TRIANGLE)
+                continue;
+              if (((QuadifierType*) quadification[geomID])[primID] == QUADIFIER_PAIRED)
+                continue;
+              
+              pstate.prefix_state.counts[taskIndex-1] = PrimInfo(pstate.prefix_state.counts[taskIndex-1].size()-1);
+              pstate.prefix_state.counts[taskIndex  ] = PrimInfo(pstate.prefix_state.counts[taskIndex  ].size()+1);
+            }
+
+            pinfo = PrimInfo(empty);
+            for (size_t i=0; i<pstate.taskCount; i++) {
+              pstate.prefix_state.sums[i] = pinfo;
+              pinfo = PrimInfo::merge(pinfo,pstate.prefix_state.counts[i]);
+            }
+          }
+
+          double t2 = timing ? getSeconds() : 0.0;
+          if (buildStats) {
+            buildStats->quadificationNs = toNanoseconds(t2-t1);
+            buildStats->numQuadPairs = numInputPrimitives - pinfo.size();
+          }
+          if (verbose) {
+            const size_t numPairs = numInputPrimitives - pinfo.size();
+            std::cout << "quadification: " << std::setw(10) << (t2-t1)*1000.0 << "ms, " << std::setw(10) << numPairs << " quads ("
+                      << std::setw(5) << 200.0*double(numPairs)/double(std::max(numInputPrimitives,size_t(1))) << "% of primitives paired)" << std::endl;
+          }
 
           size_t numPrimitives = pinfo.size();
+
+          /* remember where each task writes its primrefs to, as the prefix sum gets recalculated with the number of valid primitives */
+          size_t taskOffsets[ParallelForForState::MAX_TASKS];
+          for (size_t i=0; i<pstate.taskCount; i++)
+            taskOffsets[i] = pstate.prefix_state.sums[i].size();
           
-          /* first try */
-          //pstate.init(numGeometries,getSize,size_t(1024));
           pinfo = parallel_for_for_prefix_sum1_( pstate, size_t(1), getSize, PrimInfo(empty), [&](size_t geomID, const range<size_t>& r, size_t k, const PrimInfo& base) -> PrimInfo {
             if (getType(geomID) == QBVH6BuilderSAH::TRIANGLE)
               return createTrianglePairPrimRefArray(prims.data(),r,base.size(),(unsigned)geomID);
@@ -1086,30 +1787,58 @@ namespace embree
               return createPrimRefArray(prims,BBox1f(0,1),r,base.size(),(unsigned)geomID);
           }, [](const PrimInfo& a, const PrimInfo& b) -> PrimInfo { return PrimInfo::merge(a,b); });
 
-          double t3 = verbose ? getSeconds() : 0.0;
+          double t3 = timing ? getSeconds() : 0.0;
+          if (buildStats) buildStats->primRefGenNs = toNanoseconds(t3-t2);
           if (verbose) std::cout << "primrefgen   : " << std::setw(10) << (t3-t2)*1000.0 << "ms, " << std::setw(10) << 1E-6*double(numPrimitives)/(t3-t2) << " Mprims/s" << std::endl;
           
-          /* if we need to filter out geometry, run again */
+          /* invalid primitives leave a gap at the end of the primrefs of their task, thus compact the primref array */
           if (pinfo.size() != numPrimitives)
           {
             numPrimitives = pinfo.size();
-            
-            pinfo = parallel_for_for_prefix_sum1_( pstate, size_t(1), getSize, PrimInfo(empty), [&](size_t geomID, const range<size_t>& r, size_t k, const PrimInfo& base) -> PrimInfo {
-              if (getType(geomID) == QBVH6BuilderSAH::TRIANGLE) {
-                return createTrianglePairPrimRefArray(prims.data(),r,base.size(),(unsigned)geomID);
+            if (buildStats) buildStats->compacted = true;
+
+            /* all tasks before the first one with a gap already are in place */
+            size_t firstMoved = numPrimitives;
+            for (size_t i=0; i<pstate.taskCount; i++) {
+              if (taskOffsets[i] != pstate.prefix_state.sums[i].size()) {
+                firstMoved = pstate.prefix_state.sums[i].size();
+                break;
+              }
+            }
+
+            /* source and destination ranges of neighbouring tasks overlap, thus copy the moving
+             * primrefs to their final position inside a temporary buffer and then back */
+            primsTmp.resize(numPrimitives-firstMoved);
+            parallel_for(size_t(0), pstate.taskCount, size_t(1), [&](const range<size_t>& t)
+            {
+              for (size_t i=t.begin(); i<t.end(); i++)
+              {
+                const size_t src = taskOffsets[i];
+                const size_t dst = pstate.prefix_state.sums[i].size();
+                const size_t num = pstate.prefix_state.counts[i].size();
+                if (dst < firstMoved || num == 0) continue;
+                
+                parallel_for(size_t(0), num, size_t(4096), [&](const range<size_t>& r) {
+                  memcpy((void*)&primsTmp[dst-firstMoved+r.begin()],(void*)&prims[src+r.begin()],r.size()*sizeof(PrimRef));
+                });
               }
-              else                                                                               
-                return createPrimRefArray(prims,BBox1f(0,1),r,base.size(),(unsigned)geomID);
-            }, [](const PrimInfo& a, const PrimInfo& b) -> PrimInfo { return PrimInfo::merge(a,b); });
+            });
+            
+            parallel_for(firstMoved, numPrimitives, size_t(4096), [&](const range<size_t>& r) {
+              memcpy((void*)&prims[r.begin()],(void*)&primsTmp[r.begin()-firstMoved],r.size()*sizeof(PrimRef));
+            });
           }
-          assert(pinfo.size() == numPrimitives);
           
-          double t4 = verbose ? getSeconds() : 0.0;
-          if (verbose) std::cout << "primrefgen2  : " << std::setw(10) << (t4-t3)*1000.0 << "ms, " << std::setw(10) << 1E-6*double(numPrimitives)/(t4-t3) << " Mprims/s" << std::endl;
+          double t4 = timing ? getSeconds() : 0.0;
+          if (buildStats) buildStats->primRefCompactNs = toNanoseconds(t4-t3);
+          if (verbose) std::cout << "compaction   : " << std::setw(10) << (t4-t3)*1000.0 << "ms" << std::endl;
           
           /* perform pre-splitting */
           if (useSpatialSplits(build_quality,build_flags) &&  numPrimitives)
           {
+            /* the budget adds to the slots that got free by quadification and compaction */
+            prims.resize(std::min(numInputPrimitives+presplitBudget,prims.capacity()));
+            
             auto splitter = [this] (const PrimRef& prim, const size_t dim, const float pos, PrimRef& left_o, PrimRef& right_o) {
               splitTriangleOrQuad(prim,dim,pos,left_o,right_o);
             };
@@ -1127,33 +1856,110 @@ namespace embree
               }
             };
 
+            /* opening an instance may exceed the requested number of sub-primitives by the children of one node */
+            auto maxSubPrims = [&] (const PrimRef& prim, const unsigned int splitprims) -> unsigned int
+            {
+              if (getType(prim.geomID()) == QBVH6BuilderSAH::INSTANCE)
+                return std::min(splitprims+(unsigned int)BVH_WIDTH-2,(unsigned int)MAX_PRESPLITS_PER_PRIMITIVE);
+              return splitprims;
+            };
+
             auto primitiveArea1 = [this] (const PrimRef& prim) -> float {
               return primitiveArea(prim);
             };
             
-            pinfo = createPrimRefArray_presplit(numPrimitives, prims, pinfo, splitter1, primitiveArea1);
+            if (hasInstances)
+              openInstances(numGeometries);
+            
+            pinfo = createPrimRefArray_presplit(numPrimitives, prims, pinfo, presplitItems, splitter1, maxSubPrims, primitiveArea1);
+          }
+
+          double t5 = timing ? getSeconds() : 0.0;
+          if (buildStats) {
+            buildStats->presplitNs = toNanoseconds(t5-t4);
+            buildStats->numPrimitives = numPrimitives;
           }
+          if (verbose) std::cout << "presplit     : " << std::setw(10) << (t5-t4)*1000.0 << "ms" << std::endl;
+
+          return pinfo;
+        }
 
+        ReductionTy createHierarchy(const PrimInfo& pinfo, char* root)
+        {
+          double t0 = timing ? getSeconds() : 0.0;
+          
           /* exit early if scene is empty */
-          if (pinfo.size() == 0) {
-            pinfo_o = pinfo;
+          if (pinfo.size() == 0)
             return createEmptyNode(root);
-          }
           
-          /* build hierarchy */
-          BuildRecord record(1,pinfo,UNKNOWN);
-          ReductionTy r = createInternalNode(record,root,sizeof(QBVH6::InternalNode6));
+          /* build hierarchy, LOW quality builds use a linear Morton code based build */
+          ReductionTy r;
+          if (build_quality == ZE_RTAS_BUILDER_BUILD_QUALITY_HINT_EXP_LOW)
+          {
+            mortonSort(pinfo);
+            BuildRecord record(1,pinfo,getRangeType(0,pinfo.size()));
+            r = createMortonNode(record,root,sizeof(QBVH6::InternalNode6));
+            mortonKeys.clear();
+          }
+          else
+          {
+            /* spatial splits may use the primref slots presplitting left free */
+            const size_t ext_end = useSpatialSplits(build_quality,build_flags) ? prims.size() : pinfo.size();
+            BuildRecord record(1,pinfo,UNKNOWN,ext_end);
+            r = createInternalNode(record,root,sizeof(QBVH6::InternalNode6));
+          }
           
-          double t5 = verbose ? getSeconds() : 0.0;
-          if (verbose) std::cout << "bvh_build    : " << std::setw(10) << (t5-t4)*1000.0 << "ms, " << std::setw(10) << 1E-6*double(numPrimitives)/(t5-t4) << " Mprims/s" << std::endl;
+          double t1 = timing ? getSeconds() : 0.0;
+          if (buildStats) buildStats->bvhBuildNs = toNanoseconds(t1-t0);
+          if (verbose) std::cout << "bvh_build    : " << std::setw(10) << (t1-t0)*1000.0 << "ms, " << std::setw(10) << 1E-6*double(pinfo.size())/(t1-t0) << " Mprims/s" << std::endl;
 
-          pinfo_o = pinfo;
           return r;
         }
 
-        bool build(size_t numGeometries, char* accel, size_t bytes, BBox3f* boundsOut, size_t* accelBufferBytesOut, void* dispatchGlobalsPtr)
+        /* hash of all build inputs that determine the content of the scratch buffer, returns false if the geometry content cannot get hashed */
+        bool computeInputHash(size_t numGeometries, uint64_t& hash) const
+        {
+          uint64_t contentHash = 0;
+          if (!getContentHash(contentHash))
+            return false;
+          
+          hash = 0xcbf29ce484222325ULL;
+          auto add = [&] (uint64_t v) { hash = (hash ^ v) * 0x100000001b3ULL; };
+          add(contentHash);
+          add(numGeometries);
+          for (size_t geomID=0; geomID<numGeometries; geomID++) {
+            const size_t N = getSize(geomID);
+            add(N);
+            if (N) add(getType(geomID));
+          }
+          add(scratch_bytes);
+          add(rtas_format);
+          add(build_quality);
+          add(build_flags);
+          add(deterministic);
+          add(presplitBudget);
+          return true;
+        }
+
+        bool build(size_t numGeometries, char* accel, size_t bytes, BBox3f* boundsOut, size_t* accelBufferBytesOut, void* dispatchGlobalsPtr, bool measure_in,
+                   ze_rtas_builder_build_op_stats_desc_t* buildStats_in, ze_rtas_builder_layout_exp_t layout, bool deterministic_in, double presplitFactor_in)
         {
-          double t0 = verbose ? getSeconds() : 0.0;
+          measure = measure_in;
+          deterministic = deterministic_in;
+          presplitFactor = presplitFactor_in;
+          numSpatialSplits = 0;
+          buildStats = buildStats_in;
+          timing = verbose || buildStats;
+          double t0 = timing ? getSeconds() : 0.0;
+
+          /* clear all outputs of the statistics struct */
+          if (buildStats) {
+            const ze_structure_type_t stype = buildStats->stype;
+            const void* pNext = buildStats->pNext;
+            memset(buildStats,0,sizeof(ze_rtas_builder_build_op_stats_desc_t));
+            buildStats->stype = stype;
+            buildStats->pNext = pNext;
+          }
 
           Stats stats;
           size_t numPrimitives = 0;
@@ -1165,10 +1971,7 @@ namespace embree
             if (N == 0) continue;
 
             switch (getType(geomID)) {
-            case QBVH6BuilderSAH::TRIANGLE  :
-              stats.numTriangles += numPrimitives;
-              quadification[geomID].resize(N);
-              break;
+            case QBVH6BuilderSAH::TRIANGLE  : stats.numTriangles += N; break;
             case QBVH6BuilderSAH::QUAD      : stats.numQuads += N; break;
             case QBVH6BuilderSAH::PROCEDURAL: stats.numProcedurals += N; break;
             case QBVH6BuilderSAH::INSTANCE  : stats.numInstances += N; break;
@@ -1176,44 +1979,165 @@ namespace embree
             }
           }
 
-          stats.estimate_presplits(1.2);
+          /* the quadification table goes to the end of the scratch buffer if there is enough space, otherwise we cannot resume builds */
+          const size_t numTriangles = stats.numTriangles;
+          const size_t quadificationBytes = (numTriangles*sizeof(uint16_t)+63) & ~size_t(63);
+          const size_t scratchBytesAligned = scratch_bytes & ~size_t(63);
+          const size_t primRefBytes = scratchBytesAligned - std::min(scratchBytesAligned, sizeof(ScratchHeader) + quadificationBytes);
+          ScratchHeader* header = nullptr;
+          uint16_t* quadificationPtr = nullptr;
+          
+          /* the presplit items go in front of the quadification table if there is enough space left for the primrefs */
+          const size_t numPresplitItems = useSpatialSplits(build_quality,build_flags) ? 2*numPrimitives : 0;
+          const size_t presplitBytes = (numPresplitItems*sizeof(PresplitItem)+63) & ~size_t(63);
+          presplitItems = nullptr;
+          
+          if (primRefBytes >= numPrimitives*sizeof(PrimRef))
+          {
+            header = (ScratchHeader*) scratch_ptr;
+            quadificationPtr = (uint16_t*) (scratch_ptr + scratchBytesAligned - quadificationBytes);
+            if (primRefBytes >= numPrimitives*sizeof(PrimRef) + presplitBytes) {
+              prims = evector<PrimRef>((void*)(scratch_ptr+sizeof(ScratchHeader)),primRefBytes-presplitBytes);
+              presplitItems = (PresplitItem*) ((char*)quadificationPtr - presplitBytes);
+            } else {
+              prims = evector<PrimRef>((void*)(scratch_ptr+sizeof(ScratchHeader)),primRefBytes);
+            }
+          }
+          else
+          {
+            quadificationData.resize(numTriangles);
+            quadificationPtr = quadificationData.data();
+          }
+
+          if (!presplitItems && numPresplitItems) {
+            presplitItemsData.resize(numPresplitItems);
+            presplitItems = presplitItemsData.data();
+          }
+
+          for (size_t geomID=0; geomID<numGeometries; geomID++)
+          {
+            quadification[geomID] = nullptr;
+            const uint32_t N = getSize(geomID);
+            if (N == 0 || getType(geomID) != QBVH6BuilderSAH::TRIANGLE) continue;
+            quadification[geomID] = quadificationPtr;
+            quadificationPtr += N;
+          }
+
+          /* The presplit budget depends on the vertex positions. If the acceleration structure buffer got sized
+           * for other positions, the budget gets reduced until the worst case size fits again. Smaller buffers
+           * never fit the worst case, these builds keep the full budget and may get retried. */
+          presplitBudget = 0;
+          if (useSpatialSplits(build_quality,build_flags))
+          {
+            Stats minStats = stats;
+            minStats.estimate_presplits(1.0,INSTANCE_PRESPLIT_FACTOR);
+            const bool reduce = !measure && bytes >= minStats.worst_case_bvh_bytes();
+            
+            Stats presplitStats = stats;
+            for (double factor = presplitFactor; ; factor -= 1.0/PRESPLIT_FACTOR_STEPS)
+            {
+              presplitStats = stats;
+              presplitStats.estimate_presplits(std::max(factor,1.0),INSTANCE_PRESPLIT_FACTOR);
+              if (!reduce || factor <= 1.0 || presplitStats.worst_case_bvh_bytes() <= bytes) break;
+            }
+            presplitBudget = presplitStats.size() - stats.size();
+            stats = presplitStats;
+          }
+          
           size_t worstCaseBytes = stats.worst_case_bvh_bytes();
+          const size_t worstCaseBytesUnpadded = stats.worst_case_bvh_bytes_unpadded();
           if (accelBufferBytesOut) *accelBufferBytesOut = std::min(std::max(bytes+64,size_t(1.2*bytes)), worstCaseBytes);
 
-          prims.resize(numPrimitives);
-          
-          double t1 = verbose ? getSeconds() : 0.0;
+          double t1 = timing ? getSeconds() : 0.0;
           if (verbose) std::cout << "scene_size   : " << std::setw(10) << (t1-t0)*1000.0 << "ms" << std::endl;
 
+          /* either continue from the primrefs of a previous build that ran out of memory, or create all primrefs */
           PrimInfo pinfo;
+          uint64_t inputHash = 0;
+          bool hashed = false;
+          if (header && header->magick == ScratchHeader::RESUMABLE && (hashed = computeInputHash(numGeometries,inputHash)) && header->inputHash == inputHash)
+          {
+            if (verbose) std::cout << "resuming build from scratch buffer" << std::endl;
+            prims.resize(header->numPrimRefs);
+            pinfo = header->pinfo;
+            if (buildStats) buildStats->resumed = true;
+          }
+          else
+          {
+            if (header) header->magick = 0;
+            prims.resize(numPrimitives);
+            pinfo = createPrimRefs(numGeometries, stats.numInstances != 0);
+          }
+
           BBox3f bounds = empty;
 
+          /* a measure build has unlimited memory but does not write any data */
+          if (measure) {
+            accel = nullptr;
+            bytes = std::numeric_limits<size_t>::max()/2;
+          }
+
           if (verbose) std::cout << "trying BVH build with " << bytes << " bytes" << std::endl;
             
+          /* use per-thread allocation blocks if the buffer is large enough that their unused ends cannot make the build fail,
+           * measure, deterministic, and compact builds never use them, such that they return the exact size */
+          const size_t numThreads = TaskScheduler::threadCount();
+          const bool useThreadBlocks = !measure && !deterministic && !(build_flags & ZE_RTAS_BUILDER_BUILD_OP_EXP_FLAG_COMPACT) && numThreads > 1 && bytes >= worstCaseBytesUnpadded + Allocator::maxThreadBlockWaste(worstCaseBytesUnpadded,numThreads);
+          if (verbose && useThreadBlocks) std::cout << "using per-thread allocation blocks" << std::endl;
+          
           /* allocate BVH memory */
-          allocator.init(accel,bytes);
+          allocator.init(accel,bytes,useThreadBlocks ? numThreads : 0);
           allocator.malloc(128); // header
 
           uint32_t numRoots = 1;
           QBVH6::InternalNode6* roots = (QBVH6::InternalNode6*) allocator.malloc(numRoots*sizeof(QBVH6::InternalNode6),64);
-          assert(roots);
 
-          /* build BVH static BVH */
+          /* build BVH static BVH, a buffer too small for the root node fails like any build that runs out of memory */
           QBVH6::InternalNode6* root = roots+0;
-          ReductionTy r = build(numGeometries,pinfo,(char*)root);
+          ReductionTy r = roots ? createHierarchy(pinfo,(char*)root) : ReductionTy();
 
-          /* check if build failed */
-          if (!r.valid()) {
+          if (buildStats) {
+            buildStats->numPrimRefs = pinfo.size();
+            buildStats->numSpatialSplits = numSpatialSplits;
+            buildStats->rtasBytesAllocated = allocator.bytesAllocated();
+            buildStats->rtasBytesUnused = allocator.bytesUnused();
+          }
+          if (verbose && useThreadBlocks) std::cout << "unused bytes : " << std::setw(10) << allocator.bytesUnused() << " of " << allocator.bytesAllocated() << " bytes in per-thread allocation blocks" << std::endl;
+
+          /* check if build failed, the primref array is only reordered by the hierarchy build, thus we can resume from it,
+           * except if spatial splits used the free slots behind the primrefs, which moves and clips primrefs */
+          if (!r.valid() || measure)
+          {
+            const bool extended = useSpatialSplits(build_quality,build_flags) && prims.size() > pinfo.size();
+            if (header && !extended && !hashed)
+              hashed = computeInputHash(numGeometries,inputHash);
+            
+            if (header && !extended && hashed) {
+              header->inputHash = inputHash;
+              header->numPrimRefs = prims.size();
+              header->pinfo = pinfo;
+              header->magick = ScratchHeader::RESUMABLE;
+            }
+
+            /* a measure build returns the exact number of bytes a build from the same scratch buffer will use */
+            if (buildStats) buildStats->totalNs = toNanoseconds(getSeconds()-t0);
+            
+            if (measure) {
+              if (boundsOut) *boundsOut = pinfo.geomBounds;
+              if (accelBufferBytesOut) *accelBufferBytesOut = allocator.bytesAllocated();
+              return true;
+            }
             return false;
           }
 
+          if (header) header->magick = 0;
+
           bounds.extend(pinfo.geomBounds);
 
           if (boundsOut) *boundsOut = bounds;
-          if (accelBufferBytesOut)
-            *accelBufferBytesOut = allocator.bytesAllocated();
 
-          /* fill QBVH6 header */
+          /* fill QBVH6 header, the reserved fields are cleared as well */
+          memset(accel,0,sizeof(QBVH6));
           QBVH6* qbvh = new (accel) QBVH6(QBVH6::SizeEstimate());
           qbvh->rtas_format = rtas_format;
           qbvh->numPrims = 0; //numPrimitives;
@@ -1224,6 +2148,50 @@ namespace embree
           qbvh->numTimeSegments = 1; 
           qbvh->dispatchGlobalsPtr = (uint64_t) dispatchGlobalsPtr;
 
+          /* trade additional build time for lower traversal cost for HIGH quality builds */
+          if (build_quality == ZE_RTAS_BUILDER_BUILD_QUALITY_HINT_EXP_HIGH)
+          {
+            const double sah0 = (verbose || buildStats) ? qbvh->computeStatistics().sah() : 0.0;
+            double t2 = timing ? getSeconds() : 0.0;
+            const double gain = TreeletOptimizer(qbvh).optimize();
+            double t3 = timing ? getSeconds() : 0.0;
+            const double sah1 = (verbose || buildStats) && gain > 0.0 ? qbvh->computeStatistics().sah() : sah0;
+            if (buildStats) {
+              buildStats->optimizeNs = toNanoseconds(t3-t2);
+              buildStats->sahBefore = sah0;
+              buildStats->sahAfter = sah1;
+            }
+            if (verbose)
+              std::cout << "treelet_opt  : " << std::setw(10) << (t3-t2)*1000.0 << "ms, SAH " << sah0 << " -> " << sah1 << std::endl;
+          }
+
+          size_t bytesUsed = allocator.bytesAllocated();
+
+          /* store each subtree contiguously, independent of the order the parallel build allocated the nodes */
+          if (deterministic && layout == ZE_RTAS_BUILDER_LAYOUT_EXP_DEFAULT)
+            layout = ZE_RTAS_BUILDER_LAYOUT_EXP_DEPTH_FIRST;
+          
+          if (layout != ZE_RTAS_BUILDER_LAYOUT_EXP_DEFAULT)
+          {
+            double t2 = timing ? getSeconds() : 0.0;
+            const double pages0 = verbose ? qbvh->computeStatistics().pageCrossingSAH : 0.0;
+            const size_t end = LayoutOptimizer(qbvh,bytesUsed,layoutData).layout(layout);
+
+            /* the layout packs the nodes, clear the stale tail such that no old nodes remain behind the reported size */
+            if (end < bytesUsed) memset((char*)accel + end, 0, bytesUsed-end);
+            bytesUsed = end;
+            double t3 = timing ? getSeconds() : 0.0;
+            if (buildStats) buildStats->layoutNs = toNanoseconds(t3-t2);
+            if (verbose) {
+              const double pages1 = qbvh->computeStatistics().pageCrossingSAH;
+              std::cout << "layout       : " << std::setw(10) << (t3-t2)*1000.0 << "ms, page crossings " << pages0 << " -> " << pages1 << std::endl;
+            }
+          }
+
+          /* report the size only after the last pass that changes the layout */
+          if (accelBufferBytesOut)
+            *accelBufferBytesOut = bytesUsed;
+
 #if 0
           BVHStatistics stats = qbvh->computeStatistics();
           stats.print(std::cout);
@@ -1238,6 +2206,7 @@ namespace embree
           }
           std::cout << std::endl << "};" << std::endl;*/
 #endif
+          if (buildStats) buildStats->totalNs = toNanoseconds(getSeconds()-t0);
           return true;
         }
         
@@ -1250,14 +2219,32 @@ namespace embree
         const getQuadFunc getQuad;
         const getProceduralFunc getProcedural;
         const getInstanceFunc getInstance;
+        const getContentHashFunc getContentHash;
         Settings cfg;
+        char* scratch_ptr;
+        size_t scratch_bytes;
         evector<PrimRef> prims;
         Allocator allocator;
-        std::vector<std::vector<uint16_t>> quadification;
+        std::vector<MortonKey>& mortonKeys;    // sorted Morton keys, only used for LOW quality builds
+        std::vector<MortonKey>& mortonKeysTmp;
+        std::vector<PrimRef>& primsTmp;        // copy of primrefs for Morton reordering and compaction
+        std::vector<char>& layoutData;         // only used if the layout gets optimized
+        std::vector<uint16_t*>& quadification;
+        std::vector<uint16_t>& quadificationData; // only used if quadification table does not fit into scratch buffer
+        PresplitItem* presplitItems = nullptr;    // two presplit items per primitive
+        std::vector<PresplitItem>& presplitItemsData; // only used if presplit items do not fit into scratch buffer
+        std::vector<OpenedInstance> openedInstances; // instantiated BVHs opened for presplitting, sorted by address
+        double presplitFactor = 1.0;  // presplit factor of triangles and quads sampled from the inputs
+        size_t presplitBudget = 0;    // number of primrefs presplitting may add to the input primitives
+        std::atomic<size_t> numSpatialSplits; // number of primrefs spatial splits added during the hierarchy build
         ze_raytracing_accel_format_internal_t rtas_format;
         ze_rtas_builder_build_quality_hint_exp_t build_quality;
         ze_rtas_builder_build_op_exp_flags_t build_flags;
         bool verbose;
+        bool timing = false;   // measure phase timings for verbose output or build statistics
+        bool measure = false;
+        bool deterministic = false; // output only depends on the inputs, not on the thread count or scheduling
+        ze_rtas_builder_build_op_stats_desc_t* buildStats = nullptr;
         
       };
 
@@ -1270,9 +2257,11 @@ namespace embree
                                ze_rtas_format_exp_t rtas_format,
                                ze_rtas_builder_build_quality_hint_exp_t build_quality,
                                ze_rtas_builder_build_op_exp_flags_t build_flags,
+                               double presplitFactor,
                                size_t& expectedBytes,
                                size_t& worstCaseBytes,
-                               size_t& scratchBytes)
+                               size_t& scratchBytes,
+                               size_t& presplitBudget)
       {
         Stats stats;
         for (size_t geomID=0; geomID<numGeometries; geomID++)
@@ -1289,8 +2278,13 @@ namespace embree
           };
         }
         
-        if (useSpatialSplits(build_quality,build_flags))
-          stats.estimate_presplits(1.2);
+        presplitBudget = 0;
+        if (useSpatialSplits(build_quality,build_flags)) {
+          const size_t numPrimitives = stats.size();
+          stats.numPresplitItems = 2*numPrimitives;
+          stats.estimate_presplits(presplitFactor,INSTANCE_PRESPLIT_FACTOR);
+          presplitBudget = stats.size() - numPrimitives;
+        }
         
         worstCaseBytes = stats.worst_case_bvh_bytes();
         scratchBytes = stats.scratch_space_bytes();
@@ -1305,7 +2299,8 @@ namespace embree
                typename getTriangleIndicesFunc,
                typename getQuadFunc,
                typename getProceduralFunc,
-               typename getInstanceFunc>
+               typename getInstanceFunc,
+               typename getContentHashFunc>
        
       static bool build(size_t numGeometries,
                           Device* device,
@@ -1317,6 +2312,7 @@ namespace embree
                           const getQuadFunc& getQuad,
                           const getProceduralFunc& getProcedural,
                           const getInstanceFunc& getInstance,
+                          const getContentHashFunc& getContentHash,
                           char* accel_ptr, size_t accel_bytes,
                           void* scratch_ptr, size_t scratch_bytes,
                           BBox3f* boundsOut,
@@ -1325,18 +2321,871 @@ namespace embree
                           ze_rtas_builder_build_quality_hint_exp_t build_quality,
                           ze_rtas_builder_build_op_exp_flags_t build_flags,
                           bool verbose,
-                          void* dispatchGlobalsPtr)
+                          void* dispatchGlobalsPtr,
+                          bool measure = false,
+                          BuildArena* arena = nullptr,
+                          ze_rtas_builder_build_op_stats_desc_t* buildStats = nullptr,
+                          ze_rtas_builder_layout_exp_t layout = ZE_RTAS_BUILDER_LAYOUT_EXP_DEFAULT,
+                          bool deterministic = false,
+                          double presplitFactor = 1.0)
       {
         /* align scratch buffer to 64 bytes */
         bool scratchAligned = std::align(64,0,scratch_ptr,scratch_bytes);
         if (!scratchAligned)
           throw std::runtime_error("scratch buffer cannot get aligned");
     
-        BuilderT<getSizeFunc, getTypeFunc, createPrimRefArrayFunc, getTriangleFunc, getTriangleIndicesFunc, getQuadFunc, getProceduralFunc, getInstanceFunc> builder
-          (device, getSize, getType, createPrimRefArray, getTriangle, getTriangleIndices, getQuad, getProcedural, getInstance, scratch_ptr, scratch_bytes, rtas_format, build_quality, build_flags, verbose);
+        /* use temporary buffers for this build only if the caller does not keep an arena */
+        BuildArena localArena;
+        if (!arena) arena = &localArena;
+    
+        BuilderT<getSizeFunc, getTypeFunc, createPrimRefArrayFunc, getTriangleFunc, getTriangleIndicesFunc, getQuadFunc, getProceduralFunc, getInstanceFunc, getContentHashFunc> builder
+          (device, getSize, getType, createPrimRefArray, getTriangle, getTriangleIndices, getQuad, getProcedural, getInstance, getContentHash, scratch_ptr, scratch_bytes, rtas_format, build_quality, build_flags, verbose, *arena);
         
-        return builder.build(numGeometries, accel_ptr, accel_bytes, boundsOut, accelBufferBytesOut, dispatchGlobalsPtr);
+        return builder.build(numGeometries, accel_ptr, accel_bytes, boundsOut, accelBufferBytesOut, dispatchGlobalsPtr, measure, buildStats, layout, deterministic, presplitFactor);
       }
+
+      /* Refits an existing BVH to the current vertex positions of its
+       * triangle and quad geometries. All nodes and leaves are validated
+       * against the buffer size and the current geometries before any
+       * node gets modified, such that invalid inputs leave the BVH
+       * untouched. */
+      template<typename getSizeFunc,
+               typename getTypeFunc,
+               typename getTriangleFunc,
+               typename getQuadFunc>
+      class RefitterT
+      {
+        static const size_t PARALLEL_DEPTH = 4; //!< spawn tasks for children up to that depth
+        static const size_t MAX_DEPTH = 27;     //!< maximum depth of BVHs the builder creates
+        
+      public:
+        RefitterT (size_t numGeometries,
+                   const getSizeFunc& getSize,
+                   const getTypeFunc& getType,
+                   const getTriangleFunc& getTriangle,
+                   const getQuadFunc& getQuad,
+                   char* accel, size_t accelBytes)
+          : numGeometries(numGeometries), getSize(getSize), getType(getType), getTriangle(getTriangle), getQuad(getQuad), accel(accel), accelBytes(accelBytes) {}
+
+        /* reads the current vertices of a quad leaf from the geometry, returns false if the leaf does not match the geometries */
+        bool computeQuadLeaf(const QuadLeaf* leaf, Vec3f v[4]) const
+        {
+          const uint32_t geomID = leaf->leafDesc.geomIndex;
+          const uint32_t primID = leaf->primIndex0;
+          if (geomID >= numGeometries || primID >= getSize(geomID))
+            return false;
+
+          const Type type = getType(geomID);
+          if (type == QUAD)
+          {
+            const Quad quad = getQuad(geomID,primID);
+            v[0] = quad.p0;
+            v[1] = quad.p1;
+            v[2] = quad.p3;
+            v[3] = quad.p2;
+          }
+          else if (type == TRIANGLE)
+          {
+            const Triangle tri0 = getTriangle(geomID,primID);
+            if (!tri0.valid())
+              return false;
+            
+            v[0] = tri0.p0;
+            v[1] = tri0.p1;
+            v[2] = tri0.p2;
+            v[3] = tri0.p2;
+
+            /* the local indices of the second triangle stay valid as the topology is unchanged */
+            if (leaf->valid2())
+            {
+              const uint32_t primID1 = leaf->primIndex(1);
+              if (primID1 >= getSize(geomID))
+                return false;
+              
+              const Triangle tri1 = getTriangle(geomID,primID1);
+              if (!tri1.valid())
+                return false;
+              
+              if (leaf->j0 == 3) v[3] = tri1.p0;
+              if (leaf->j1 == 3) v[3] = tri1.p1;
+              if (leaf->j2 == 3) v[3] = tri1.p2;
+            }
+          }
+          else
+            return false;
+
+          for (size_t i=0; i<4; i++)
+            if (unlikely(!isvalid(v[i]))) return false;
+          
+          return true;
+        }
+
+        /* re-reads the vertices of a validated quad leaf from the geometry */
+        BBox3f refitQuadLeaf(QuadLeaf* leaf)
+        {
+          Vec3f v[4];
+          const bool valid = computeQuadLeaf(leaf,v);
+          assert(valid);
+          _unused(valid);
+          
+          leaf->v0 = v[0];
+          leaf->v1 = v[1];
+          leaf->v2 = v[2];
+          leaf->v3 = v[3];
+          return leaf->bounds();
+        }
+
+        /* checks that all quads of a leaf list are inside the buffer and match the geometries */
+        bool validateQuads(const QuadLeaf* leaf) const
+        {
+          for (;; leaf++) {
+            if (size_t((const char*)(leaf+1) - accel) > accelBytes) return false;
+            Vec3f v[4];
+            if (!computeQuadLeaf(leaf,v)) return false;
+            if (leaf->isLast()) return true;
+          }
+        }
+
+        bool validateChild(const QBVH6::Node& child, size_t depth) const
+        {
+          switch (child.type) {
+          case NODE_TYPE_INTERNAL: return validateNode(child.template innerNode<QBVH6::InternalNode6>(),depth+1);
+          case NODE_TYPE_QUAD    : return validateQuads(child.leafNodeQuad());
+          default: return false; // refit is only supported for triangle and quad geometries
+          }
+        }
+
+        /* checks that the node is inside the buffer and validates all children, a too deep
+         * BVH can only be corrupt and may even contain cycles */
+        bool validateNode(const QBVH6::InternalNode6* node, size_t depth) const
+        {
+          if (depth > MAX_DEPTH)
+            return false;
+          
+          if ((const char*)node < accel || size_t((const char*)(node+1) - accel) > accelBytes)
+            return false;
+          
+          size_t numChildren = 0;
+          while (numChildren < BVH_WIDTH && node->valid(numChildren))
+            numChildren++;
+
+          if (depth < PARALLEL_DEPTH && !node->isFatLeaf())
+          {
+            bool valid[BVH_WIDTH];
+            parallel_for(size_t(0), numChildren, [&] (const range<size_t>& r) {
+              for (size_t i=r.begin(); i<r.end(); i++)
+                valid[i] = validateChild(node->child(i),depth);
+            });
+            for (size_t i=0; i<numChildren; i++)
+              if (!valid[i]) return false;
+            return true;
+          }
+          
+          for (size_t i=0; i<numChildren; i++)
+            if (!validateChild(node->child(i),depth)) return false;
+          return true;
+        }
+
+        /* refits all quads of a leaf list */
+        BBox3f refitQuads(QuadLeaf* leaf, size_t& bytes)
+        {
+          BBox3f bounds = empty;
+          for (;; leaf++) {
+            bounds.extend(refitQuadLeaf(leaf));
+            if (leaf->isLast()) break;
+          }
+          bytes = max(bytes, size_t((char*)(leaf+1) - accel));
+          return bounds;
+        }
+
+        BBox3f refitChild(const QBVH6::Node& child, size_t depth, size_t& bytes)
+        {
+          switch (child.type) {
+          case NODE_TYPE_INTERNAL: return refitNode(child.template innerNode<QBVH6::InternalNode6>(),depth+1,bytes);
+          case NODE_TYPE_QUAD    : return refitQuads(child.leafNodeQuad(),bytes);
+          default: assert(false); return empty;
+          }
+        }
+        
+        /* refits all children and re-quantizes the child bounds relative to the new node bounds */
+        BBox3f refitNode(QBVH6::InternalNode6* node, size_t depth, size_t& bytes)
+        {
+          bytes = max(bytes, size_t((char*)(node+1) - accel));
+
+          /* children are always stored consecutively */
+          size_t numChildren = 0;
+          while (numChildren < BVH_WIDTH && node->valid(numChildren))
+            numChildren++;
+
+          if (numChildren == 0)
+            return empty;
+
+          BBox3f childBounds[BVH_WIDTH];
+          if (depth < PARALLEL_DEPTH && !node->isFatLeaf())
+          {
+            size_t childBytes[BVH_WIDTH] = { 0 };
+            parallel_for(size_t(0), numChildren, [&] (const range<size_t>& r) {
+              for (size_t i=r.begin(); i<r.end(); i++)
+                childBounds[i] = refitChild(node->child(i),depth,childBytes[i]);
+            });
+            for (size_t i=0; i<numChildren; i++)
+              bytes = max(bytes, childBytes[i]);
+          }
+          else
+          {
+            for (size_t i=0; i<numChildren; i++)
+              childBounds[i] = refitChild(node->child(i),depth,bytes);
+          }
+          
+          BBox3f bounds = empty;
+          for (size_t i=0; i<numChildren; i++)
+            bounds.extend(childBounds[i]);
+
+          node->setNodeBounds(bounds);
+          for (size_t i=0; i<numChildren; i++)
+            node->setChildBounds(i,childBounds[i]);
+
+          return bounds;
+        }
+
+        /* returns false without modifying the BVH if it does not match the geometries */
+        bool refit(BBox3f* boundsOut, size_t* accelBufferBytesOut)
+        {
+          QBVH6* qbvh = (QBVH6*) accel;
+          if (qbvh->root().type != NODE_TYPE_INTERNAL)
+            return false;
+          
+          QBVH6::InternalNode6* root = qbvh->root().template innerNode<QBVH6::InternalNode6>();
+          if (!validateNode(root,1))
+            return false;
+          
+          size_t bytes = sizeof(QBVH6);
+          const BBox3f bounds = refitNode(root,1,bytes);
+          qbvh->bounds = bounds;
+          
+          if (boundsOut) *boundsOut = bounds;
+          if (accelBufferBytesOut) *accelBufferBytesOut = bytes;
+          return true;
+        }
+
+      private:
+        const size_t numGeometries;
+        const getSizeFunc getSize;
+        const getTypeFunc getType;
+        const getTriangleFunc getTriangle;
+        const getQuadFunc getQuad;
+        char* accel;
+        size_t accelBytes;
+      };
+
+      template<typename getSizeFunc,
+               typename getTypeFunc,
+               typename getTriangleFunc,
+               typename getQuadFunc>
+      
+      static bool refit(size_t numGeometries,
+                        const getSizeFunc& getSize,
+                        const getTypeFunc& getType,
+                        const getTriangleFunc& getTriangle,
+                        const getQuadFunc& getQuad,
+                        char* accel_ptr, size_t accel_bytes,
+                        BBox3f* boundsOut,
+                        size_t* accelBufferBytesOut)
+      {
+        RefitterT<getSizeFunc, getTypeFunc, getTriangleFunc, getQuadFunc> refitter(numGeometries, getSize, getType, getTriangle, getQuad, accel_ptr, accel_bytes);
+        return refitter.refit(boundsOut, accelBufferBytesOut);
+      }
+
+      /* Patches the absolute pointers of an acceleration structure after
+       * the acceleration structures it instantiates got moved, e.g. when
+       * a serialized acceleration structure got loaded by another
+       * process. All other references are relative to the node that
+       * stores them, thus the acceleration structure itself can get
+       * copied to any 64 byte aligned address. */
+      class InstanceRelocator
+      {
+        static const size_t PARALLEL_DEPTH = 4; //!< spawn tasks for children up to that depth
+        static const size_t MAX_DEPTH = 27;     //!< maximum depth of BVHs the builder creates
+
+      public:
+
+        /* the instantiated acceleration structure at [oldBegin,oldEnd) moved to newBegin */
+        struct Relocation
+        {
+          bool operator< (const Relocation& other) const {
+            return oldBegin < other.oldBegin;
+          }
+          
+          uint64_t oldBegin;
+          uint64_t oldEnd;
+          uint64_t newBegin;
+        };
+        
+        InstanceRelocator (char* accel, size_t bytes, const std::vector<Relocation>& relocations)
+          : accel(accel), bytes(bytes), relocations(relocations) {}
+
+        /* maps an address into an instantiated acceleration structure to its new location, other addresses stay unchanged */
+        uint64_t relocate(uint64_t ptr) const
+        {
+          auto it = std::upper_bound(relocations.begin(),relocations.end(),ptr,[](uint64_t p, const Relocation& r) { return p < r.oldBegin; });
+          if (it == relocations.begin()) return ptr;
+          --it;
+          if (ptr >= it->oldEnd) return ptr;
+          return ptr - it->oldBegin + it->newBegin;
+        }
+
+        /* relocates a pointer that gets stored into a 48 bit field */
+        uint64_t relocate48(uint64_t ptr) const
+        {
+          const uint64_t newPtr = relocate(ptr);
+          if (newPtr >> 48)
+            throw std::runtime_error("relocated acceleration structure is not inside the 48 bit address space");
+          return newPtr;
+        }
+
+        void relocateLeaf(InstanceLeaf* leaf) const
+        {
+          leaf->part0.startNodePtr = relocate48(leaf->part0.startNodePtr);
+          if (leaf->part1.bvhPtr) leaf->part1.bvhPtr = relocate48(leaf->part1.bvhPtr);
+        }
+
+        void relocateLeaf(InstanceLeafV2* leaf) const
+        {
+          leaf->part0.startNodePtr = relocate(leaf->part0.startNodePtr);
+          if (leaf->part1.bvhPtr) leaf->part1.bvhPtr = relocate48(leaf->part1.bvhPtr);
+        }
+
+        /* checks that a node of the given size lies entirely inside the acceleration structure buffer */
+        void checkNode(const char* node, size_t nodeBytes) const
+        {
+          if (node < accel || size_t(node - accel) > bytes || nodeBytes > bytes - size_t(node - accel))
+            throw std::runtime_error("node outside of acceleration structure buffer");
+        }
+
+        void relocateChild(const QBVH6::Node& child, size_t depth)
+        {
+          switch (child.type) {
+          case NODE_TYPE_INTERNAL:
+            checkNode(child.node,sizeof(QBVH6::InternalNode6));
+            relocateNode(child.template innerNode<QBVH6::InternalNode6>(),depth+1);
+            break;
+          case NODE_TYPE_INSTANCE:
+            if (((QBVH6*)accel)->rtas_format == ZE_RTAS_DEVICE_FORMAT_EXP_VERSION_1) {
+              checkNode(child.node,sizeof(InstanceLeaf));
+              relocateLeaf((InstanceLeaf*)child.node);
+            } else {
+              checkNode(child.node,sizeof(InstanceLeafV2));
+              relocateLeaf((InstanceLeafV2*)child.node);
+            }
+            break;
+          default: break; // geometry leaves store no pointers
+          }
+        }
+        
+        void relocateNode(QBVH6::InternalNode6* node, size_t depth)
+        {
+          /* a too deep BVH can only be corrupt and may even contain cycles */
+          if (depth > MAX_DEPTH)
+            throw std::runtime_error("BVH too deep");
+          
+          /* children are always stored consecutively */
+          size_t numChildren = 0;
+          while (numChildren < BVH_WIDTH && node->valid(numChildren))
+            numChildren++;
+
+          /* fat leaves of quads and procedurals store no pointers */
+          if (node->nodeType == NODE_TYPE_QUAD || node->nodeType == NODE_TYPE_PROCEDURAL)
+            return;
+          
+          if (depth < PARALLEL_DEPTH && !node->isFatLeaf())
+          {
+            parallel_for(size_t(0), numChildren, [&] (const range<size_t>& r) {
+              for (size_t i=r.begin(); i<r.end(); i++)
+                relocateChild(node->child(i),depth);
+            });
+          }
+          else
+          {
+            for (size_t i=0; i<numChildren; i++)
+              relocateChild(node->child(i),depth);
+          }
+        }
+
+        void relocate(void* dispatchGlobalsPtr)
+        {
+          QBVH6* qbvh = (QBVH6*) accel;
+          checkNode(qbvh->root().node,sizeof(QBVH6::InternalNode6));
+          relocateNode(qbvh->root().template innerNode<QBVH6::InternalNode6>(),1);
+          qbvh->dispatchGlobalsPtr = (uint64_t) dispatchGlobalsPtr;
+        }
+        
+      private:
+        char* accel;
+        size_t bytes;
+        const std::vector<Relocation>& relocations;
+      };
+
+      /* Post-build optimization of HIGH quality BVHs. A treelet consists
+       * of an internal node, its children, and their children. These
+       * grandchildren get exchanged between the children of the treelet
+       * root as long as this reduces the cost of these children in the
+       * hardware cost model of BVHStatistics, which traverses each
+       * 6-wide node in one step and each quad leaf per triangle, using
+       * the quantized bounds stored in the nodes. Only treelets near the
+       * root get optimized, where the node areas and thus the gains are
+       * largest. Only grandchildren of the same size get exchanged,
+       * which are internal nodes or single quad leaf blocks, thus they
+       * can get swapped in place. */
+      class TreeletOptimizer
+      {
+        static const size_t PARALLEL_DEPTH = 4;    //!< spawn tasks for children up to that depth
+        static const size_t MAX_ROUNDS = 2;        //!< maximal number of swap rounds per treelet
+        static const size_t MAX_TREELET_DEPTH = 5; //!< only nodes up to that depth become treelet roots
+
+        /* kind of children a treelet child has */
+        enum Kind { NONE = 0, NODES = 1, QUADS = 2 };
+        
+      public:
+        TreeletOptimizer (QBVH6* qbvh)
+          : qbvh(qbvh) {}
+
+        /* counts the children of a node, which are always stored consecutively */
+        static size_t numChildren(const QBVH6::InternalNode6* node)
+        {
+          size_t N = 0;
+          while (N < BVH_WIDTH && node->valid(N)) N++;
+          return N;
+        }
+
+        /* children can only get exchanged if they are all internal nodes or all single quad leaf blocks */
+        static Kind getKind(const QBVH6::InternalNode6* node)
+        {
+          const size_t N = numChildren(node);
+          if (node->nodeType == NODE_TYPE_MIXED)
+          {
+            for (size_t i=0; i<N; i++)
+              if (node->getChildType(i) != NODE_TYPE_INTERNAL) return NONE;
+            return NODES;
+          }
+          else if (node->nodeType == NODE_TYPE_QUAD)
+          {
+            for (size_t i=0; i<N; i++)
+              if (node->getChildStartPrim(i) != 0 || !quadLeaf(node,i)->isLast()) return NONE;
+            return QUADS;
+          }
+          return NONE;
+        }
+
+        static QBVH6::InternalNode6* childNode(const QBVH6::InternalNode6* node, size_t i) {
+          return node->child(i).template innerNode<QBVH6::InternalNode6>();
+        }
+
+        static QuadLeaf* quadLeaf(const QBVH6::InternalNode6* node, size_t i) {
+          return node->child(i).leafNodeQuad();
+        }
+
+        /* swaps two nodes in memory and fixes up their relative child offsets */
+        static void swapNodes(QBVH6::InternalNode6* a, QBVH6::InternalNode6* b)
+        {
+          const int64_t ofs = ((char*)b - (char*)a)/64;
+          std::swap(*a,*b);
+          a->childOffset = (int32_t) (a->childOffset + ofs);
+          b->childOffset = (int32_t) (b->childOffset - ofs);
+        }
+
+        static BBox3f unionBounds(const BBox3f* bounds, size_t N, size_t skip = -1, const BBox3f& replacement = empty)
+        {
+          BBox3f b = empty;
+          for (size_t i=0; i<N; i++)
+            b.extend(i == skip ? replacement : bounds[i]);
+          return b;
+        }
+
+        /* cost of a treelet child in the hardware cost model of BVHStatistics, the child gets traversed with the area of
+         * its bounds quantized inside the treelet root, and each grandchild with the area of its bounds quantized inside
+         * the child, weighted by the number of triangles for quad leaves */
+        static float childCost(const QBVH6::InternalNode6& rootGrid, const BBox3f* bounds, const float* weights, size_t N)
+        {
+          const BBox3f childBounds = unionBounds(bounds,N);
+          QBVH6::InternalNode6 root = rootGrid;
+          root.setChildBounds(0,childBounds);
+          float cost = area(root.bounds(0));
+          
+          QBVH6::InternalNode6 child(childBounds);
+          for (size_t k=0; k<N; k++) {
+            child.setChildBounds((uint32_t)k,bounds[k]);
+            cost += weights[k]*area(child.bounds((uint32_t)k));
+          }
+          return cost;
+        }
+
+        /* greedily swaps grandchildren between children of the node, returns the reduction of the treelet cost */
+        float optimizeTreelet(QBVH6::InternalNode6* node)
+        {
+          if (node->nodeType != NODE_TYPE_MIXED || getKind(node) != NODES)
+            return 0.0f;
+          
+          const size_t N = numChildren(node);
+          QBVH6::InternalNode6* children[BVH_WIDTH];
+          Kind kind[BVH_WIDTH];
+          size_t numGrandChildren[BVH_WIDTH];
+          BBox3f grandChildBounds[BVH_WIDTH][BVH_WIDTH];
+          float grandChildWeights[BVH_WIDTH][BVH_WIDTH];
+          BBox3f childBounds[BVH_WIDTH];
+
+          for (size_t c=0; c<N; c++)
+          {
+            children[c] = childNode(node,c);
+            kind[c] = getKind(children[c]);
+            numGrandChildren[c] = kind[c] != NONE ? numChildren(children[c]) : 0;
+            for (size_t k=0; k<numGrandChildren[c]; k++) {
+              grandChildBounds[c][k] = kind[c] == NODES ? childNode(children[c],k)->bounds() : children[c]->bounds(k); // quad bounds would ignore spatial splits
+              grandChildWeights[c][k] = kind[c] == NODES ? 1.0f : float(quadLeaf(children[c],k)->size());
+            }
+            childBounds[c] = kind[c] != NONE ? unionBounds(grandChildBounds[c],numGrandChildren[c]) : children[c]->bounds();
+          }
+
+          /* the bounds of the treelet root do not change, thus neither does the quantization grid of the children */
+          const QBVH6::InternalNode6 rootGrid(unionBounds(childBounds,N));
+          float cost[BVH_WIDTH];
+          for (size_t c=0; c<N; c++)
+            cost[c] = kind[c] != NONE ? childCost(rootGrid,grandChildBounds[c],grandChildWeights[c],numGrandChildren[c]) : 0.0f;
+
+          bool modified[BVH_WIDTH] = { false };
+          float gain = 0.0f;
+          for (size_t round=0; round<MAX_ROUNDS; round++)
+          {
+            bool improved = false;
+            for (size_t a=0; a<N; a++)
+            {
+              for (size_t b=a+1; b<N; b++)
+              {
+                if (kind[a] == NONE || kind[a] != kind[b]) continue;
+                
+                for (size_t i=0; i<numGrandChildren[a]; i++)
+                {
+                  for (size_t j=0; j<numGrandChildren[b]; j++)
+                  {
+                    /* the swap has to reduce the summed area of both children before the quantized cost gets evaluated */
+                    const float areaOld = area(childBounds[a]) + area(childBounds[b]);
+                    const float areaNew = area(unionBounds(grandChildBounds[a],numGrandChildren[a],i,grandChildBounds[b][j])) +
+                                          area(unionBounds(grandChildBounds[b],numGrandChildren[b],j,grandChildBounds[a][i]));
+                    if (areaNew >= areaOld*(1.0f-1E-5f)) continue;
+
+                    BBox3f boundsA[BVH_WIDTH], boundsB[BVH_WIDTH];
+                    float weightsA[BVH_WIDTH], weightsB[BVH_WIDTH];
+                    std::copy(grandChildBounds[a],grandChildBounds[a]+numGrandChildren[a],boundsA);
+                    std::copy(grandChildBounds[b],grandChildBounds[b]+numGrandChildren[b],boundsB);
+                    std::copy(grandChildWeights[a],grandChildWeights[a]+numGrandChildren[a],weightsA);
+                    std::copy(grandChildWeights[b],grandChildWeights[b]+numGrandChildren[b],weightsB);
+                    std::swap(boundsA[i],boundsB[j]);
+                    std::swap(weightsA[i],weightsB[j]);
+                    
+                    const float costA = childCost(rootGrid,boundsA,weightsA,numGrandChildren[a]);
+                    const float costB = childCost(rootGrid,boundsB,weightsB,numGrandChildren[b]);
+                    const float costOld = cost[a] + cost[b];
+                    const float costNew = costA + costB;
+                    if (costNew >= costOld*(1.0f-1E-5f)) continue;
+
+                    if (kind[a] == NODES)
+                      swapNodes(childNode(children[a],i),childNode(children[b],j));
+                    else
+                      std::swap(*quadLeaf(children[a],i),*quadLeaf(children[b],j));
+                    
+                    std::swap(grandChildBounds[a][i],grandChildBounds[b][j]);
+                    std::swap(grandChildWeights[a][i],grandChildWeights[b][j]);
+                    childBounds[a] = unionBounds(boundsA,numGrandChildren[a]);
+                    childBounds[b] = unionBounds(boundsB,numGrandChildren[b]);
+                    cost[a] = costA;
+                    cost[b] = costB;
+                    modified[a] = modified[b] = improved = true;
+                    gain += costOld-costNew;
+                  }
+                }
+              }
+            }
+            if (!improved) break;
+          }
+
+          if (gain == 0.0f)
+            return 0.0f;
+
+          /* re-quantize the bounds of the modified children and of the treelet root */
+          for (size_t c=0; c<N; c++)
+          {
+            if (!modified[c]) continue;
+            
+            uint8_t nodeMask = 0;
+            children[c]->setNodeBounds(childBounds[c]);
+            for (size_t k=0; k<numGrandChildren[c]; k++) {
+              children[c]->setChildBounds(k,grandChildBounds[c][k]);
+              nodeMask |= kind[c] == NODES ? childNode(children[c],k)->nodeMask : quadLeaf(children[c],k)->leafDesc.geomMask;
+            }
+            children[c]->nodeMask = nodeMask;
+          }
+
+          node->setNodeBounds(unionBounds(childBounds,N));
+          for (size_t c=0; c<N; c++)
+            node->setChildBounds(c,childBounds[c]);
+
+          return gain;
+        }
+
+        /* optimizes all treelets of the subtree, returns the summed gain of the treelets */
+        double optimizeNode(QBVH6::InternalNode6* node, size_t depth)
+        {
+          if (node->isFatLeaf() || depth > MAX_TREELET_DEPTH)
+            return 0.0;
+
+          double gain = optimizeTreelet(node);
+
+          const size_t N = numChildren(node);
+          if (depth < PARALLEL_DEPTH)
+          {
+            double gains[BVH_WIDTH];
+            parallel_for(size_t(0), N, [&] (const range<size_t>& r) {
+              for (size_t i=r.begin(); i<r.end(); i++)
+                gains[i] = optimizeNode(childNode(node,i),depth+1);
+            });
+            for (size_t i=0; i<N; i++)
+              gain += gains[i];
+          }
+          else
+          {
+            for (size_t i=0; i<N; i++)
+              gain += optimizeNode(childNode(node,i),depth+1);
+          }
+          return gain;
+        }
+
+        /* returns the reduction of the treelet costs, zero if the BVH did not change */
+        double optimize()
+        {
+          if (qbvh->root().type != NODE_TYPE_INTERNAL)
+            return 0.0;
+          
+          return optimizeNode(qbvh->root().template innerNode<QBVH6::InternalNode6>(),1);
+        }
+
+      private:
+        QBVH6* qbvh;
+      };
+
+      /* Reorders the nodes and leaves of a BVH such that subtrees are
+       * stored contiguously. As the children of a node are always
+       * stored consecutively, they are moved as one block. The depth
+       * first layout stores the block of a node followed by the
+       * subtrees of its children in order. The page clustered layout
+       * first fills the current 4kB page breadth first with the blocks
+       * of the top of a subtree, and lays out the subtrees below that
+       * the same way, such that most traversal steps stay inside a
+       * page. The result only depends on the BVH topology, not on the
+       * order in which the build allocated the nodes. The BVH is copied
+       * to a temporary buffer, as moved blocks overlap with blocks not
+       * moved yet. */
+      class LayoutOptimizer
+      {
+        static const size_t PAGE_BYTES = 4096;
+        static const size_t PARALLEL_DEPTH = 2;       // subtrees below that depth get laid out sequentially
+        static const size_t COPY_BLOCK_BYTES = 1<<20; // granularity of the parallel copy back
+
+        /* node whose children still have to get placed, and its copy in the temporary buffer */
+        struct Item
+        {
+          const QBVH6::InternalNode6* node;
+          size_t copy;
+        };
+        
+      public:
+        LayoutOptimizer (QBVH6* qbvh, size_t bytes, std::vector<char>& data)
+          : qbvh(qbvh), bytes(bytes), data(data) {}
+
+        /* counts the children of a node, which are always stored consecutively */
+        static size_t numChildren(const QBVH6::InternalNode6* node)
+        {
+          size_t N = 0;
+          while (N < BVH_WIDTH && node->valid(N)) N++;
+          return N;
+        }
+
+        /* returns the end of the memory of some child, leaves span all blocks up to the one marked as last */
+        static const char* childEnd(const QBVH6::InternalNode6* node, size_t i)
+        {
+          QBVH6::Node child = node->child(i);
+          switch (child.type)
+          {
+          case NODE_TYPE_INTERNAL:
+            return child.node + sizeof(QBVH6::InternalNode6);
+          
+          case NODE_TYPE_INSTANCE:
+            return child.node + sizeof(InstanceLeaf);
+            
+          case NODE_TYPE_QUAD:
+          {
+            const QuadLeaf* quad = child.leafNodeQuad();
+            while (!quad->isLast()) quad++;
+            return (const char*) (quad+1);
+          }
+          case NODE_TYPE_PROCEDURAL:
+          {
+            const ProceduralLeaf* leaf = child.leafNodeProcedural();
+            for (uint32_t currPrim = child.cur_prim; !leaf->isLast(currPrim); ) {
+              if (++currPrim >= leaf->size()) {
+                currPrim = 0;
+                leaf++;
+              }
+            }
+            return (const char*) (leaf+1);
+          }
+          default:
+            assert(false);
+            return child.node;
+          }
+        }
+
+        /* returns the memory range of all children of a node */
+        static range<const char*> childBlock(const QBVH6::InternalNode6* node)
+        {
+          const size_t N = numChildren(node);
+          const char* begin = N ? node->child(0).node : nullptr;
+          const char* end = begin;
+          for (size_t i=0; i<N; i++)
+            end = std::max(end, childEnd(node,i));
+          return range<const char*>(begin,end);
+        }
+
+        /* page clustered layout of the subtree of the first item at offset cur, all items with a larger index are below the subtree */
+        size_t layoutPageClustered(size_t first, size_t cur)
+        {
+          /* the current page gets filled breadth first, but at least one block is placed */
+          const size_t pageEnd = (cur/PAGE_BYTES+1)*PAGE_BYTES;
+          size_t next = first;
+          while (next < items.size())
+          {
+            const Item item = items[next];
+            const range<const char*> block = childBlock(item.node);
+            const size_t blockBytes = block.end() - block.begin();
+            if (next != first && cur + blockBytes > pageEnd) break;
+            next++;
+            
+            if (blockBytes == 0) continue;
+            memcpy(&data[cur], block.begin(), blockBytes);
+            ((QBVH6::InternalNode6*) &data[item.copy])->setChildOffset(&data[cur]);
+
+            for (size_t i=0; i<numChildren(item.node); i++) {
+              if (item.node->getChildType(i) != NODE_TYPE_INTERNAL) continue;
+              const char* child = item.node->child(i).node;
+              items.push_back({ (const QBVH6::InternalNode6*) child, cur + size_t(child-block.begin()) });
+            }
+            cur += blockBytes;
+          }
+
+          /* the nodes whose children did not fit start subtrees of their own */
+          const size_t last = items.size();
+          for (size_t i=next; i<last; i++)
+          {
+            const size_t base = items.size();
+            items.push_back(items[i]);
+            cur = layoutPageClustered(base, cur);
+            items.resize(base);
+          }
+          return cur;
+        }
+
+        /* bytes of all child blocks in the subtree of a node */
+        static size_t subtreeBytes(const QBVH6::InternalNode6* node)
+        {
+          const range<const char*> block = childBlock(node);
+          size_t bytes = block.end() - block.begin();
+          for (size_t i=0; i<numChildren(node); i++)
+            if (node->getChildType(i) == NODE_TYPE_INTERNAL)
+              bytes += subtreeBytes((const QBVH6::InternalNode6*) node->child(i).node);
+          return bytes;
+        }
+
+        /* places the child block of node at offset cur followed by the subtrees of its children, the
+         * subtrees of the top nodes are sized first, such that they can get laid out in parallel */
+        size_t layoutDepthFirst(const QBVH6::InternalNode6* node, size_t copy, size_t cur, size_t depth, bool parallel)
+        {
+          const range<const char*> block = childBlock(node);
+          const size_t blockBytes = block.end() - block.begin();
+          if (blockBytes == 0) return cur;
+          
+          memcpy(&data[cur], block.begin(), blockBytes);
+          ((QBVH6::InternalNode6*) &data[copy])->setChildOffset(&data[cur]);
+
+          const size_t N = numChildren(node);
+          const size_t blockOffset = cur;
+          cur += blockBytes;
+
+          if (!parallel || depth >= PARALLEL_DEPTH)
+          {
+            for (size_t i=0; i<N; i++) {
+              if (node->getChildType(i) != NODE_TYPE_INTERNAL) continue;
+              const char* child = node->child(i).node;
+              cur = layoutDepthFirst((const QBVH6::InternalNode6*) child, blockOffset + size_t(child-block.begin()), cur, depth+1, parallel);
+            }
+            return cur;
+          }
+
+          size_t offsets[BVH_WIDTH];
+          parallel_for(size_t(0), N, [&] (const range<size_t>& r) {
+            for (size_t i=r.begin(); i<r.end(); i++)
+              offsets[i] = node->getChildType(i) == NODE_TYPE_INTERNAL ? subtreeBytes((const QBVH6::InternalNode6*) node->child(i).node) : 0;
+          });
+          
+          for (size_t i=0; i<N; i++) {
+            const size_t bytes = offsets[i];
+            offsets[i] = cur;
+            cur += bytes;
+          }
+          
+          parallel_for(size_t(0), N, [&] (const range<size_t>& r) {
+            for (size_t i=r.begin(); i<r.end(); i++) {
+              if (node->getChildType(i) != NODE_TYPE_INTERNAL) continue;
+              const char* child = node->child(i).node;
+              layoutDepthFirst((const QBVH6::InternalNode6*) child, blockOffset + size_t(child-block.begin()), offsets[i], depth+1, parallel);
+            }
+          });
+          return cur;
+        }
+
+        /* returns the number of bytes used by the BVH after the layout */
+        size_t layout(ze_rtas_builder_layout_exp_t layout)
+        {
+          if (qbvh->root().type != NODE_TYPE_INTERNAL)
+            return bytes;
+
+          /* the header and root node stay in place */
+          const size_t rootEnd = QBVH6::rootNodeOffset + sizeof(QBVH6::InternalNode6);
+          data.resize(bytes);
+          memcpy(data.data(), qbvh, rootEnd);
+
+          /* sizing the top subtrees first only pays off if there are threads to lay them out in parallel */
+          const QBVH6::InternalNode6* root = qbvh->root().template innerNode<QBVH6::InternalNode6>();
+          size_t end = rootEnd;
+          if (layout == ZE_RTAS_BUILDER_LAYOUT_EXP_PAGE_CLUSTERED)
+          {
+            items.clear();
+            items.push_back({ root, QBVH6::rootNodeOffset });
+            end = layoutPageClustered(0, rootEnd);
+          }
+          else
+            end = layoutDepthFirst(root, QBVH6::rootNodeOffset, rootEnd, 1, TaskScheduler::threadCount() > 1);
+          assert(end <= bytes);
+
+          parallel_for(size_t(0), end, COPY_BLOCK_BYTES, [&] (const range<size_t>& r) {
+            memcpy((char*)qbvh + r.begin(), data.data() + r.begin(), r.size());
+          });
+          return end;
+        }
+
+      private:
+        QBVH6* qbvh;
+        size_t bytes;             // bytes used by the BVH
+        std::vector<char>& data;  // temporary copy of the BVH
+        std::vector<Item> items;  // nodes whose children still have to get placed
+      };
     };
   }
 }
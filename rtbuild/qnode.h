@@ -189,6 +189,7 @@ namespace embree
     InternalNodeCommon(NodeType type)
     {
       this->nodeType = type;
+      this->pad = 0;
       this->childOffset = 0;
       this->nodeMask = 0xFF;
       
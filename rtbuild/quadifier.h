@@ -24,57 +24,10 @@ namespace embree
     QUADIFIER_MAX_DISTANCE = 31,
   };
 
-  template<typename Ty, size_t N>
-  struct static_deque
-  {
-    __forceinline Ty pop_front() {
-      assert(size());
-      return operator[](begin++);
-    }
-
-    __forceinline void push_back(const Ty& v) {
-      assert(size() < N);
-      operator[](end++) = v;
-    }
-    
-    __forceinline size_t size() const {
-      assert(end >= begin);
-      return end-begin;
-    }
-
-    __forceinline bool full() const {
-      return size() == N;
-    }
-
-    __forceinline void erase( size_t j )
-    {
-      assert(j >= begin && j < end);
-
-      /* fast path as we mostly just merge with the subsequent triangle */
-      if (likely(j == begin))
-        begin++;
-
-      /* fastest when left side is small */
-      else if (j-begin < end-j-1) {
-        for (size_t i=j; i>=begin+1; i--) operator[](i) = operator[](i-1);
-        begin++;
-      }
-
-      /* fastest if right side is small */
-      else {
-        for (size_t i=j+1; i<end; i++) operator[](i-1) = operator[](i);
-        end--;
-      }
-    }
-    
-    __forceinline       Ty& operator[] ( const size_t i )       { return array[i%N]; }
-    __forceinline const Ty& operator[] ( const size_t i ) const { return array[i%N]; }
-    
-    Ty array[N];
-    size_t begin = 0;
-    size_t end = 0;
-  };
-            
+  /* Tests if the triangles a and b share an edge, and returns the local
+   * index in a of each vertex of b, or 3 if a does not contain it. The
+   * vertices of a are compared against each vertex of b in one SSE
+   * compare, this is the SIMD kernel of all pairing paths below. */
   __forceinline bool pair_triangles(Vec3<uint32_t> a, Vec3<uint32_t> b, uint8_t& lb0, uint8_t& lb1, uint8_t& lb2)
   {
     const vuint<4> va(a.x,a.y,a.z,0);
@@ -87,65 +40,257 @@ namespace embree
     return (lb0 == 3) + (lb1 == 3) + (lb2 == 3) <= 1;
   }
 
+  /* Pairs the triangles of the range [primID0,primID1) into quads and
+   * returns the number of quads and unpaired triangles. Two triangles
+   * can only get paired if they share an edge and their distance is at
+   * most QUADIFIER_MAX_DISTANCE, as the hardware encodes the distance
+   * with 5 bits. The triangles are processed in blocks. Blocks where
+   * each triangle pairs with its successor (e.g. triangle strips) are
+   * paired directly. Otherwise the graph of candidate pairs is computed
+   * using a hash table of the triangle edges, and a large matching of
+   * this graph is found by first pairing triangles that have only one
+   * candidate left, and otherwise pairing the first unpaired triangle
+   * with its candidate that has the fewest other candidates. Unpaired
+   * triangles at the end of a block are carried over to the next block,
+   * such that no pairs get lost at block borders. */
   template<typename GetTriangleFunc>
-  __forceinline void merge_triangle_window( uint32_t geomID, static_deque<uint32_t,32>& triangleWindow, QuadifierType* quads_o, const GetTriangleFunc& getTriangle )
+  inline size_t pair_triangles( uint32_t geomID, QuadifierType* quads_o, uint32_t primID0, uint32_t primID1, const GetTriangleFunc& getTriangle ) 
   {
-    uint32_t primID0 = triangleWindow.pop_front();
-    
-    /* load first triangle */
-    Vec3<uint32_t> tri0 = getTriangle(geomID, primID0);
-    
-    /* find a second triangle in triangle window to pair with */
-    for ( size_t slot = triangleWindow.begin; slot != triangleWindow.end; ++slot )
+    static const uint32_t BLOCK_SIZE = 512;
+    static const uint32_t HASH_SIZE = 2048;  // power of two larger than the number of edges
+    static const uint16_t INVALID = 0xFFFF;
+    uint32_t prims[BLOCK_SIZE];          // primitive ID of each slot
+    Vec3<uint32_t> tris[BLOCK_SIZE];     // vertex indices of each slot
+    uint32_t next[BLOCK_SIZE];           // bit k set if slot i+k+1 is a candidate
+    uint32_t prev[BLOCK_SIZE];           // bit k set if slot i-k-1 is a candidate
+    uint8_t  degree[BLOCK_SIZE];         // number of unpaired candidates
+    bool     paired[BLOCK_SIZE];
+    uint16_t queue[BLOCK_SIZE];          // slots with a single candidate left
+    uint16_t hashTable[HASH_SIZE];       // first edge of each hash bucket
+    uint16_t hashNext[3*BLOCK_SIZE];     // next edge of the same bucket, edge e is edge e%3 of slot e/3
+    uint64_t edgeKeys[3*BLOCK_SIZE];     // sorted vertex indices of each edge
+
+    auto hashEdge = [] (uint64_t key) -> uint32_t {
+      return uint32_t((key * 0x9E3779B97F4A7C15ull) >> 53);
+    };
+
+    size_t numQuads = 0;
+    uint32_t numSlots = 0;
+    uint32_t primID = primID0;
+
+    while (numSlots || primID < primID1)
     {
-      /* load second triangle */
-      uint32_t primID1 = triangleWindow[slot];
-      Vec3<uint32_t> tri1 = getTriangle(geomID, primID1);
+      /* fill block */
+      while (numSlots < BLOCK_SIZE && primID < primID1) {
+        prims[numSlots] = primID;
+        tris[numSlots] = getTriangle(geomID,primID);
+        numSlots++; primID++;
+      }
+      const bool lastBlock = primID >= primID1;
+
+      /* fast path for triangles in strip order, where each triangle pairs with its successor, such a matching is perfect */
+      uint32_t numStripPairs = 0;
+      for (; 2*numStripPairs+1 < numSlots; numStripPairs++)
+      {
+        const uint32_t i = 2*numStripPairs;
+        uint8_t lb0,lb1,lb2;
+        if (prims[i+1]-prims[i] > QUADIFIER_MAX_DISTANCE || !pair_triangles(tris[i],tris[i+1],lb0,lb1,lb2))
+          break;
+      }
+      if (2*numStripPairs+1 >= numSlots)
+      {
+        for (uint32_t i=0; i<2*numStripPairs; i+=2) {
+          quads_o[prims[i+0]] = (QuadifierType) (prims[i+1]-prims[i]);
+          quads_o[prims[i+1]] = QUADIFIER_PAIRED;
+        }
+        numQuads += numStripPairs;
+
+        /* a single remaining triangle may get paired in the next block */
+        const uint32_t numCarried = numSlots % 2;
+        if (numCarried) {
+          prims[0] = prims[numSlots-1];
+          tris[0] = tris[numSlots-1];
+        }
+        if (numCarried && lastBlock) {
+          quads_o[prims[0]] = QUADIFIER_TRIANGLE;
+          numQuads++;
+        }
+        numSlots = lastBlock ? 0 : numCarried;
+        continue;
+      }
+
+      /* compute candidate graph */
+      for (uint32_t i=0; i<numSlots; i++) {
+        next[i] = prev[i] = 0;
+        degree[i] = 0;
+        paired[i] = false;
+      }
       
-      /* try to pair triangles */
-      uint8_t lb0,lb1,lb2;
-      bool pair = pair_triangles(tri0,tri1,lb0,lb1,lb2);
+      for (uint32_t h=0; h<HASH_SIZE; h++)
+        hashTable[h] = INVALID;
+
+      /* a triangle is a candidate for all previous triangles in reach that share an edge */
+      for (uint32_t j=0; j<numSlots; j++)
+      {
+        const uint32_t v[3] = { tris[j].x, tris[j].y, tris[j].z };
+        for (uint32_t k=0; k<3; k++)
+        {
+          const uint32_t a = v[k], b = v[k == 2 ? 0 : k+1];
+          const uint64_t key = a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+          edgeKeys[3*j+k] = key;
+          
+          for (uint32_t f = hashTable[hashEdge(key)]; f != INVALID; f = hashNext[f])
+          {
+            if (edgeKeys[f] != key) continue;
+            const uint32_t i = f/3;
+            if (prims[j]-prims[i] > QUADIFIER_MAX_DISTANCE) continue;
+            const uint32_t bit = 1 << (j-i-1);
+            if (next[i] & bit) continue;
+            
+            uint8_t lb0,lb1,lb2;
+            if (!pair_triangles(tris[i],tris[j],lb0,lb1,lb2)) continue;
+            next[i] |= bit;
+            prev[j] |= bit;
+            degree[i]++;
+            degree[j]++;
+          }
+        }
+
+        /* insert edges after the lookups, such that a triangle does not find itself */
+        for (uint32_t e=3*j; e<3*j+3; e++) {
+          const uint32_t h = hashEdge(edgeKeys[e]);
+          hashNext[e] = hashTable[h];
+          hashTable[h] = e;
+        }
+      }
+
+      /* calls func for each unpaired candidate of slot i */
+      auto forEachCandidate = [&] (uint32_t i, auto func)
+      {
+        for (uint32_t bits = next[i]; bits; ) {
+          const uint32_t j = i+1+bscf(bits);
+          if (!paired[j]) func(j);
+        }
+        for (uint32_t bits = prev[i]; bits; ) {
+          const uint32_t j = i-1-bscf(bits);
+          if (!paired[j]) func(j);
+        }
+      };
 
-      /* the offset between the triangles cannot be too large as hardware limits bits for offset encode */
-      uint32_t prim_offset = primID1 - primID0;
-      pair &= prim_offset <= QUADIFIER_MAX_DISTANCE;
+      uint32_t queueBegin = 0, queueEnd = 0;
+      for (uint32_t i=0; i<numSlots; i++)
+        if (degree[i] == 1) queue[queueEnd++] = i;
 
-      /* store pairing if successful */
-      if (pair)
+      auto pair = [&] (uint32_t a, uint32_t b)
       {
-        assert(prim_offset > 0 && prim_offset < QUADIFIER_PAIRED);
-        quads_o[primID0] = (QuadifierType) prim_offset;
-        quads_o[primID1] = QUADIFIER_PAIRED;
-        triangleWindow.erase(slot);
-        return;
+        const uint32_t i = std::min(a,b), j = std::max(a,b);
+        quads_o[prims[i]] = (QuadifierType) (prims[j]-prims[i]);
+        quads_o[prims[j]] = QUADIFIER_PAIRED;
+        paired[i] = paired[j] = true;
+        numQuads++;
+
+        /* remove both triangles from the candidates of their neighbors */
+        auto remove = [&] (uint32_t k) {
+          if (--degree[k] == 1) queue[queueEnd++] = k;
+        };
+        forEachCandidate(i,remove);
+        forEachCandidate(j,remove);
+      };
+
+      for (uint32_t first = 0;;)
+      {
+        /* pair triangles with only one candidate left */
+        if (queueBegin < queueEnd)
+        {
+          const uint32_t i = queue[queueBegin++];
+          if (paired[i] || degree[i] == 0) continue;
+          uint32_t j = i;
+          forEachCandidate(i, [&] (uint32_t k) { j = k; });
+          pair(i,j);
+          continue;
+        }
+
+        /* otherwise pair the first triangle with its candidate of fewest other candidates */
+        while (first < numSlots && (paired[first] || degree[first] == 0)) first++;
+        if (first == numSlots) break;
+
+        uint32_t j = first;
+        forEachCandidate(first, [&] (uint32_t k) {
+          if (j == first || degree[k] < degree[j]) j = k;
+        });
+        pair(first,j);
       }
+
+      /* unpaired triangles become single triangles, except if a following block may contain a candidate */
+      uint32_t numCarried = 0;
+      for (uint32_t i=0; i<numSlots; i++)
+      {
+        if (paired[i]) continue;
+        
+        if (!lastBlock && prims[i] + QUADIFIER_MAX_DISTANCE >= primID) {
+          prims[numCarried] = prims[i];
+          tris[numCarried] = tris[i];
+          numCarried++;
+          continue;
+        }
+
+        quads_o[prims[i]] = QUADIFIER_TRIANGLE;
+        numQuads++;
+      }
+      numSlots = numCarried;
     }
-    
-    /* make a triangle if we fail to find a candiate to pair with */
-    quads_o[primID0] = QUADIFIER_TRIANGLE;
+
+    return numQuads;
   }
-  
+
+  /* Pairs triangles across the border primIDm of the two ranges
+   * [primID0,primIDm) and [primIDm,primID1) that got quadified
+   * independently. Only triangles that are still unpaired and within
+   * QUADIFIER_MAX_DISTANCE of the border are considered, thus borders
+   * further apart than 2*QUADIFIER_MAX_DISTANCE can get stitched in
+   * parallel. Returns the number of new pairs, which each reduce the
+   * number of quads and triangles of the second range by one. */
   template<typename GetTriangleFunc>
-  inline size_t pair_triangles( uint32_t geomID, QuadifierType* quads_o, uint32_t primID0, uint32_t primID1, const GetTriangleFunc& getTriangle ) 
+  inline size_t stitch_triangles( uint32_t geomID, QuadifierType* quads_o, uint32_t primID0, uint32_t primIDm, uint32_t primID1, const GetTriangleFunc& getTriangle )
   {
-    static_deque<uint32_t, 32> triangleWindow;
+    const uint32_t begin = primIDm - std::min(primIDm-primID0, uint32_t(QUADIFIER_MAX_DISTANCE));
+    const uint32_t end   = primIDm + std::min(primID1-primIDm, uint32_t(QUADIFIER_MAX_DISTANCE));
+
+    /* gather unpaired triangles after the border */
+    uint32_t numRight = 0;
+    uint32_t rightPrims[QUADIFIER_MAX_DISTANCE];
+    Vec3<uint32_t> rightTris[QUADIFIER_MAX_DISTANCE];
+    for (uint32_t j=primIDm; j<end; j++) {
+      if (quads_o[j] != QUADIFIER_TRIANGLE) continue;
+      rightPrims[numRight] = j;
+      rightTris[numRight] = getTriangle(geomID,j);
+      numRight++;
+    }
+    if (numRight == 0) return 0;
 
-    size_t numTrianglePairs = 0;
-    for (uint32_t primID=primID0; primID<primID1; primID++)
+    /* triangles furthest from the border have the fewest candidates, thus get paired first */
+    size_t numPairs = 0;
+    uint32_t unpaired = (uint32_t(1) << numRight)-1;
+    for (uint32_t i=begin; i<primIDm && unpaired; i++)
     {
-      triangleWindow.push_back(primID);
+      if (quads_o[i] != QUADIFIER_TRIANGLE) continue;
+      const Vec3<uint32_t> tri = getTriangle(geomID,i);
       
-      if (triangleWindow.full()) {
-        merge_triangle_window(geomID, triangleWindow,quads_o,getTriangle);
-        numTrianglePairs++;
+      for (uint32_t bits = unpaired; bits; )
+      {
+        const uint32_t k = bscf(bits);
+        const uint32_t j = rightPrims[k];
+        if (j-i > QUADIFIER_MAX_DISTANCE) break;
+        
+        uint8_t lb0,lb1,lb2;
+        if (!pair_triangles(tri,rightTris[k],lb0,lb1,lb2)) continue;
+        quads_o[i] = (QuadifierType) (j-i);
+        quads_o[j] = QUADIFIER_PAIRED;
+        unpaired &= ~(uint32_t(1) << k);
+        numPairs++;
+        break;
       }
     }
-    
-    while (triangleWindow.size()) {
-      merge_triangle_window(geomID, triangleWindow,quads_o,getTriangle);
-      numTrianglePairs++;
-    }
-
-    return numTrianglePairs;
+    return numPairs;
   }
 }
@@ -0,0 +1,246 @@
+// Copyright 2009-2021 Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "rtas_cache.h"
+#include "algorithms/parallel_for.h"
+
+#include <emmintrin.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <thread>
+
+namespace embree
+{
+/* cache entries are only valid for the builder that wrote them, the build system passes the library version and build id */
+#if !defined(ZE_RAYTRACING_VERSION)
+#define ZE_RAYTRACING_VERSION "unknown"
+#endif
+#if !defined(ZE_RAYTRACING_BUILD_ID)
+#define ZE_RAYTRACING_BUILD_ID __DATE__ " " __TIME__
+#endif
+
+  static const uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+  static const uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+  static const uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+  static const uint32_t PRIME32_1 = 0x9E3779B1U;
+
+  static const size_t STRIPE_BYTES = 64;        // bytes consumed by one step of the 8 hash lanes
+  static const size_t STRIPES_PER_ROUND = 16;   // the lanes get scrambled after that many stripes
+  static const size_t BLOCK_BYTES = 256*1024;   // buffers get hashed in parallel in blocks of that size
+  static const size_t BLOCK_ELEMENTS = 16*1024; // strided buffers get gathered in blocks of that many elements
+
+  /* finalization mix of MurmurHash3 */
+  static __forceinline uint64_t fmix64(uint64_t k)
+  {
+    k ^= k >> 33;
+    k *= 0xFF51AFD7ED558CCDULL;
+    k ^= k >> 33;
+    k *= 0xC4CEB9FE1A85EC53ULL;
+    k ^= k >> 33;
+    return k;
+  }
+
+  /* Hashes a byte range with 8 independent 64 bit lanes, 2 per SSE
+   * register, using the accumulation scheme of XXH3. Each lane adds
+   * the product of the lower and upper half of its data xor a key,
+   * and the unmodified data of the neighboring lane. The keys change
+   * with every stripe, such that the hash depends on the position of
+   * the data, and the lanes get scrambled regularly. */
+  static RTASCacheKey hashBlock(const char* data, size_t bytes)
+  {
+    __m128i acc[4] = {
+      _mm_set_epi64x(PRIME64_1,PRIME64_2), _mm_set_epi64x(PRIME64_3,~PRIME64_1),
+      _mm_set_epi64x(~PRIME64_2,~PRIME64_3), _mm_set_epi64x(PRIME64_1^PRIME64_3,PRIME64_2^PRIME64_3)
+    };
+    __m128i key[4] = {
+      _mm_set_epi64x(0xBE4BA423396CFEB8ULL,0x1CAD21F72C81017CULL), _mm_set_epi64x(0xDB979083E96DD4DEULL,0x1F67B3B7A4A44072ULL),
+      _mm_set_epi64x(0x78E5C0CC4EE679CBULL,0x2172FFCC7DD05A82ULL), _mm_set_epi64x(0x8E2443F7744608B8ULL,0x4C263A81E69035E0ULL)
+    };
+    const __m128i keyStep = _mm_set1_epi64x(PRIME64_2);
+    const __m128i prime = _mm_set1_epi32(PRIME32_1);
+
+    auto accumulate = [&] (const char* stripe)
+    {
+      for (size_t j=0; j<4; j++)
+      {
+        const __m128i d  = _mm_loadu_si128((const __m128i*)(stripe+16*j));
+        const __m128i dk = _mm_xor_si128(d,key[j]);
+        const __m128i product = _mm_mul_epu32(dk,_mm_shuffle_epi32(dk,_MM_SHUFFLE(0,3,0,1)));
+        acc[j] = _mm_add_epi64(acc[j],_mm_add_epi64(product,_mm_shuffle_epi32(d,_MM_SHUFFLE(1,0,3,2))));
+        key[j] = _mm_add_epi64(key[j],keyStep);
+      }
+    };
+
+    /* acc = (acc ^ (acc >> 47)) * PRIME32_1, the 64 x 32 bit multiplication is composed of two 32 x 32 bit ones */
+    auto scramble = [&] ()
+    {
+      for (size_t j=0; j<4; j++)
+      {
+        const __m128i a = _mm_xor_si128(acc[j],_mm_srli_epi64(acc[j],47));
+        const __m128i lo = _mm_mul_epu32(a,prime);
+        const __m128i hi = _mm_mul_epu32(_mm_srli_epi64(a,32),prime);
+        acc[j] = _mm_add_epi64(lo,_mm_slli_epi64(hi,32));
+      }
+    };
+
+    const size_t numStripes = bytes/STRIPE_BYTES;
+    for (size_t i=0; i<numStripes; i++)
+    {
+      accumulate(data+i*STRIPE_BYTES);
+      if ((i+1) % STRIPES_PER_ROUND == 0) scramble();
+    }
+
+    /* the last partial stripe is padded with zeros, the length is part of the final mix */
+    char last[STRIPE_BYTES];
+    memset(last,0,sizeof(last));
+    memcpy(last,data+numStripes*STRIPE_BYTES,bytes-numStripes*STRIPE_BYTES);
+    accumulate(last);
+    scramble();
+
+    uint64_t lanes[8];
+    for (size_t j=0; j<4; j++)
+      _mm_storeu_si128((__m128i*)&lanes[2*j],acc[j]);
+
+    RTASCacheKey result;
+    result.lo = bytes * PRIME64_1;
+    result.hi = ~bytes * PRIME64_3;
+    for (size_t i=0; i<8; i++) {
+      result.lo = fmix64(result.lo ^ lanes[i]);
+      result.hi = fmix64((result.hi + lanes[7-i]) * PRIME64_2);
+    }
+    return result;
+  }
+
+  void RTASCacheHasher::addBytes(const void* data, size_t bytes)
+  {
+    const size_t numBlocks = (bytes+BLOCK_BYTES-1)/BLOCK_BYTES;
+    std::vector<RTASCacheKey> keys(numBlocks);
+    parallel_for(numBlocks, [&](size_t block) {
+      const size_t begin = block*BLOCK_BYTES;
+      keys[block] = hashBlock((const char*)data+begin,std::min(BLOCK_BYTES,bytes-begin));
+    });
+
+    add(bytes);
+    for (const RTASCacheKey& key : keys)
+      addKey(key);
+  }
+
+  void RTASCacheHasher::addStrided(const void* data, size_t count, size_t elementBytes, size_t stride)
+  {
+    if (stride == elementBytes)
+      return addBytes(data,count*elementBytes);
+
+    const size_t numBlocks = (count+BLOCK_ELEMENTS-1)/BLOCK_ELEMENTS;
+    std::vector<RTASCacheKey> keys(numBlocks);
+    parallel_for(numBlocks, [&](size_t block) {
+      const size_t begin = block*BLOCK_ELEMENTS;
+      const size_t num = std::min(BLOCK_ELEMENTS,count-begin);
+      std::vector<char> elements(num*elementBytes);
+      for (size_t i=0; i<num; i++)
+        memcpy(&elements[i*elementBytes],(const char*)data+(begin+i)*stride,elementBytes);
+      keys[block] = hashBlock(elements.data(),elements.size());
+    });
+
+    add(count*elementBytes);
+    for (const RTASCacheKey& key : keys)
+      addKey(key);
+  }
+
+  /* hash of the library version and build id that gets mixed into all keys and file headers */
+  static uint64_t cacheVersion()
+  {
+    static const uint64_t version = [] {
+      const char str[] = ZE_RAYTRACING_VERSION " " ZE_RAYTRACING_BUILD_ID;
+      const RTASCacheKey key = hashBlock(str,sizeof(str)-1);
+      return key.lo ^ key.hi;
+    }();
+    return version;
+  }
+
+  RTASCacheKey RTASCacheHasher::key() const
+  {
+    RTASCacheKey key = hashBlock((const char*)values.data(),values.size()*sizeof(uint64_t));
+    key.lo ^= cacheVersion();
+    return key;
+  }
+
+  struct RTASCacheFileHeader
+  {
+    static const uint64_t MAGICK = 0x45484341435341ULL; // "ASCACHE"
+
+    uint64_t magick;
+    uint64_t version;
+    RTASCacheKey key;
+    uint64_t rtasBytes;
+    RTASCacheKey checksum; // hash of the rtasBytes following the header
+  };
+
+  static RTASCacheKey payloadChecksum(const void* rtas, size_t rtasBytes)
+  {
+    RTASCacheHasher hasher;
+    hasher.addBytes(rtas,rtasBytes);
+    return hasher.key();
+  }
+
+  static std::string cacheFilePath(const char* directory, const RTASCacheKey& key)
+  {
+    char name[64];
+    snprintf(name,sizeof(name),"%016llx%016llx.rtas",(unsigned long long)key.hi,(unsigned long long)key.lo);
+    return std::string(directory) + "/" + name;
+  }
+
+  bool loadRTASCache(const char* directory, const RTASCacheKey& key, void* rtas, size_t rtasBytesMax, size_t& rtasBytes)
+  {
+    FILE* file = fopen(cacheFilePath(directory,key).c_str(),"rb");
+    if (!file) return false;
+
+    RTASCacheFileHeader header;
+    bool valid = fread(&header,sizeof(header),1,file) == 1;
+    valid &= header.magick == RTASCacheFileHeader::MAGICK && header.version == cacheVersion();
+    valid &= header.key.lo == key.lo && header.key.hi == key.hi;
+
+    if (valid)
+    {
+      rtasBytes = header.rtasBytes;
+      if (rtasBytes <= rtasBytesMax)
+      {
+        /* truncated or corrupted files are misses, the caller builds into rtas then */
+        valid = fread(rtas,1,rtasBytes,file) == rtasBytes;
+        if (valid) {
+          const RTASCacheKey checksum = payloadChecksum(rtas,rtasBytes);
+          valid = checksum.lo == header.checksum.lo && checksum.hi == header.checksum.hi;
+        }
+      }
+    }
+    fclose(file);
+    return valid;
+  }
+
+  void storeRTASCache(const char* directory, const RTASCacheKey& key, const void* rtas, size_t rtasBytes)
+  {
+    /* the temporary name has to be unique among all threads of all processes writing the same entry */
+    const std::string path = cacheFilePath(directory,key);
+    const uint64_t unique = fmix64(std::hash<std::thread::id>()(std::this_thread::get_id()) ^ uint64_t(std::chrono::steady_clock::now().time_since_epoch().count()));
+    const std::string tmpPath = path + "." + std::to_string(unique) + ".tmp";
+
+    FILE* file = fopen(tmpPath.c_str(),"wb");
+    if (!file) return;
+
+    RTASCacheFileHeader header;
+    header.magick = RTASCacheFileHeader::MAGICK;
+    header.version = cacheVersion();
+    header.key = key;
+    header.rtasBytes = rtasBytes;
+    header.checksum = payloadChecksum(rtas,rtasBytes);
+
+    bool success = fwrite(&header,sizeof(header),1,file) == 1;
+    success &= fwrite(rtas,1,rtasBytes,file) == rtasBytes;
+    success &= fclose(file) == 0;
+
+    /* renaming fails on some platforms if another process already stored the entry */
+    if (!success || rename(tmpPath.c_str(),path.c_str()) != 0)
+      remove(tmpPath.c_str());
+  }
+}
@@ -0,0 +1,63 @@
+// Copyright 2009-2021 Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace embree
+{
+  /* 128 bit key of a cached acceleration structure */
+  struct RTASCacheKey
+  {
+    uint64_t lo = 0;
+    uint64_t hi = 0;
+  };
+
+  /* Hashes the inputs of a build. Scalar values and the hashes of
+   * large buffers are collected in order and hashed once more when
+   * the key is requested. Buffers get split into fixed size blocks
+   * that are hashed in parallel by an SSE2 kernel, thus the key does
+   * not depend on the number of threads. */
+  class RTASCacheHasher
+  {
+  public:
+
+    /* adds a scalar value */
+    void add(uint64_t value) {
+      values.push_back(value);
+    }
+
+    /* adds a contiguous buffer */
+    void addBytes(const void* data, size_t bytes);
+
+    /* adds count elements of elementBytes each that are stride bytes apart, bytes between the elements are ignored */
+    void addStrided(const void* data, size_t count, size_t elementBytes, size_t stride);
+
+    /* adds the key of another hasher */
+    void addKey(const RTASCacheKey& key) {
+      add(key.lo); add(key.hi);
+    }
+
+    RTASCacheKey key() const;
+
+  private:
+    std::vector<uint64_t> values;
+  };
+
+  /* Loads the acceleration structure stored for key in directory
+   * into rtas. Returns false if there is no valid file for the key,
+   * or if the loaded bytes do not match the checksum of the file, in
+   * which case rtas got overwritten. If the stored acceleration
+   * structure is larger than rtasBytesMax only its size is
+   * returned. */
+  bool loadRTASCache(const char* directory, const RTASCacheKey& key, void* rtas, size_t rtasBytesMax, size_t& rtasBytes);
+
+  /* Stores an acceleration structure for key in directory. The file
+   * is written under a temporary name and renamed afterwards, such
+   * that concurrent processes never read partial files. Failures are
+   * ignored, as the cache is only an optimization. */
+  void storeRTASCache(const char* directory, const RTASCacheKey& key, const void* rtas, size_t rtasBytes);
+}
@@ -6,6 +6,10 @@
 #include "rtbuild.h"
 #include "level_zero/ze_api_exp_ext.h" // handles EXP/EXT API differnces
 #include "qbvh6_builder_sah.h"
+#include "rtas_cache.h"
+
+#include <memory>
+#include <mutex>
 
 namespace embree
 {
@@ -147,28 +151,6 @@ namespace embree
     return true;
   }
 
-  inline bool buildBounds(API_TY aty, const ze_rtas_builder_procedural_geometry_info_exp_t* geom, uint32_t primID, BBox3fa& bbox, void* buildUserPtr)
-  {
-    if (primID >= geom->primCount) return false;
-    if (geom->pfnGetBoundsCb == nullptr) return false;
-
-    BBox3f bounds;
-    ze_rtas_geometry_aabbs_exp_cb_params_t params = { ZE_STRUCTURE_TYPE_RTAS_GEOMETRY_AABBS_EXP_CB_PARAMS };
-    params.primID = primID;
-    params.primIDCount = 1;
-    params.pGeomUserPtr = geom->pGeomUserPtr;
-    params.pBuildUserPtr = buildUserPtr;
-    params.pBoundsOut = (ze_rtas_aabb_exp_t*) &bounds;
-    (geom->pfnGetBoundsCb)(&params);
-    
-    if (unlikely(!isvalid(bounds.lower))) return false;
-    if (unlikely(!isvalid(bounds.upper))) return false;
-    if (unlikely(bounds.empty())) return false;
-    
-    bbox = (BBox3f&) bounds;
-    return true;
-  }
-
   inline bool buildBounds(API_TY aty, const ze_rtas_builder_instance_geometry_info_exp_t* geom, uint32_t primID, BBox3fa& bbox, void* buildUserPtr)
   {
     if (primID >= 1) return false;
@@ -188,6 +170,36 @@ namespace embree
     return true;
   }
 
+  /* bounds and projected area of a triangle or quad to sample the presplit budget, triangles
+   * get paired to quads thus their area is doubled, fails if the geometry data is not set yet */
+  inline bool getPresplitSample(API_TY aty, const ze_rtas_builder_geometry_info_exp_t* geom, uint32_t primID, BBox3fa& bounds, float& area)
+  {
+    switch (geom->geometryType) {
+    case ZE_RTAS_BUILDER_GEOMETRY_TYPE_EXP_TRIANGLES: {
+      const ze_rtas_builder_triangles_geometry_info_exp_t* mesh = (const ze_rtas_builder_triangles_geometry_info_exp_t*) geom;
+      if (mesh->pTriangleBuffer == nullptr || mesh->pVertexBuffer == nullptr) return false;
+      if (!buildBounds(aty,mesh,primID,bounds,nullptr)) return true;
+      const ze_rtas_triangle_indices_uint32_exp_t tri = getPrimitive(mesh,primID);
+      area = 2.0f*areaProjectedTriangle(getVertex(mesh,tri.v0),getVertex(mesh,tri.v1),getVertex(mesh,tri.v2));
+      return true;
+    }
+    case ZE_RTAS_BUILDER_GEOMETRY_TYPE_EXP_QUADS: {
+      const ze_rtas_builder_quads_geometry_info_exp_t* mesh = (const ze_rtas_builder_quads_geometry_info_exp_t*) geom;
+      if (mesh->pQuadBuffer == nullptr || mesh->pVertexBuffer == nullptr) return false;
+      if (!buildBounds(aty,mesh,primID,bounds,nullptr)) return true;
+      const ze_rtas_quad_indices_uint32_exp_t quad = getPrimitive(mesh,primID);
+      const Vec3f p0 = getVertex(mesh,quad.v0);
+      const Vec3f p1 = getVertex(mesh,quad.v1);
+      const Vec3f p2 = getVertex(mesh,quad.v2);
+      const Vec3f p3 = getVertex(mesh,quad.v3);
+      area = areaProjectedTriangle(p0,p1,p3) + areaProjectedTriangle(p2,p3,p1);
+      return true;
+    }
+    default:
+      return true;
+    }
+  }
+
   template<typename GeometryType>
   PrimInfo createGeometryPrimRefArray(API_TY aty, const GeometryType* geom, void* buildUserPtr, evector<PrimRef>& prims, const range<size_t>& r, size_t k, unsigned int geomID)
   {
@@ -202,6 +214,43 @@ namespace embree
     }
     return pinfo;
   }
+
+  /* procedural geometries query their bounds in blocks to amortize the callback invocation overhead */
+  PrimInfo createGeometryPrimRefArray(API_TY aty, const ze_rtas_builder_procedural_geometry_info_exp_t* geom, void* buildUserPtr, evector<PrimRef>& prims, const range<size_t>& r, size_t k, unsigned int geomID)
+  {
+    PrimInfo pinfo(empty);
+    if (geom->pfnGetBoundsCb == nullptr) return pinfo;
+
+    static const size_t BLOCK_SIZE = 256;
+    BBox3f bounds[BLOCK_SIZE];
+
+    const size_t end = min(r.end(),size_t(geom->primCount));
+    for (size_t block=r.begin(); block<end; block+=BLOCK_SIZE)
+    {
+      const size_t blockSize = min(BLOCK_SIZE,end-block);
+      
+      ze_rtas_geometry_aabbs_exp_cb_params_t params = { ZE_STRUCTURE_TYPE_RTAS_GEOMETRY_AABBS_EXP_CB_PARAMS };
+      params.primID = (uint32_t) block;
+      params.primIDCount = (uint32_t) blockSize;
+      params.pGeomUserPtr = geom->pGeomUserPtr;
+      params.pBuildUserPtr = buildUserPtr;
+      params.pBoundsOut = (ze_rtas_aabb_exp_t*) bounds;
+      (geom->pfnGetBoundsCb)(&params);
+
+      for (size_t i=0; i<blockSize; i++)
+      {
+        if (unlikely(!isvalid(bounds[i].lower))) continue;
+        if (unlikely(!isvalid(bounds[i].upper))) continue;
+        if (unlikely(bounds[i].empty())) continue;
+
+        const BBox3fa b(Vec3fa(bounds[i].lower),Vec3fa(bounds[i].upper));
+        const PrimRef prim(b,geomID,(unsigned int)(block+i));
+        pinfo.add_center2(prim);
+        prims[k++] = prim;
+      }
+    }
+    return pinfo;
+  }
   
   typedef struct _zet_base_desc_t
   {
@@ -250,6 +299,15 @@ namespace embree
     return false;
   }
 
+  /* returns the first extension structure of some type in a validated pNext chain */
+  const zet_base_desc_t_* findDescInChain(const void* pNext, ze_structure_type_t stype)
+  {
+    for (const zet_base_desc_t_* desc = (const zet_base_desc_t_*) pNext; desc; desc = (const zet_base_desc_t_*) desc->pNext) {
+      if (desc->stype == stype) return desc;
+    }
+    return nullptr;
+  }
+
   struct ze_rtas_builder
   {
     ze_rtas_builder () {
@@ -262,9 +320,34 @@ namespace embree
     bool verify() const {
       return magick == MAGICK;
     }
+
+    /* takes a build arena from the pool, builds may run concurrently with the same builder */
+    std::unique_ptr<QBVH6BuilderSAH::BuildArena> acquireArena()
+    {
+      {
+        std::lock_guard<std::mutex> lock(arenas_mutex);
+        if (!arenas.empty()) {
+          std::unique_ptr<QBVH6BuilderSAH::BuildArena> arena = std::move(arenas.back());
+          arenas.pop_back();
+          return arena;
+        }
+      }
+      return std::make_unique<QBVH6BuilderSAH::BuildArena>();
+    }
+
+    /* returns a build arena to the pool, such that its buffers get reused by the next build */
+    void releaseArena(std::unique_ptr<QBVH6BuilderSAH::BuildArena> arena)
+    {
+      std::lock_guard<std::mutex> lock(arenas_mutex);
+      arenas.push_back(std::move(arena));
+    }
     
     enum { MAGICK = 0x45FE67E1 };
     uint32_t magick = MAGICK;
+
+  private:
+    std::mutex arenas_mutex;
+    std::vector<std::unique_ptr<QBVH6BuilderSAH::BuildArena>> arenas;
   };
 
   ze_result_t validate(API_TY aty, ze_rtas_builder_exp_handle_t hBuilder)
@@ -499,21 +582,118 @@ namespace embree
       };
     };
 
+    /* sample the presplit budget of triangles and quads */
+    double presplitFactor = 1.0;
+    if (QBVH6BuilderSAH::useSpatialSplits(args->buildQuality,args->buildFlags))
+    {
+      auto getMeshPrimitiveArea = [&](uint32_t geomID, uint32_t primID, BBox3fa& bounds, float& area) -> bool {
+        return getPresplitSample(aty,geometries[geomID],primID,bounds,area);
+      };
+      presplitFactor = QBVH6BuilderSAH::estimatePresplitFactor(numGeometries, getSize, getType, getMeshPrimitiveArea);
+    }
+
     /* query memory requirements from builder */
     size_t expectedBytes = 0;
     size_t worstCaseBytes = 0;
     size_t scratchBytes = 0;
-    QBVH6BuilderSAH::estimateSize(numGeometries, getSize, getType, args->rtasFormat, args->buildQuality, args->buildFlags, expectedBytes, worstCaseBytes, scratchBytes);
+    size_t presplitBudget = 0;
+    QBVH6BuilderSAH::estimateSize(numGeometries, getSize, getType, args->rtasFormat, args->buildQuality, args->buildFlags, presplitFactor, expectedBytes, worstCaseBytes, scratchBytes, presplitBudget);
     
     /* fill return struct */
     pProp->flags = 0;
     pProp->rtasBufferSizeBytesExpected = expectedBytes;
     pProp->rtasBufferSizeBytesMaxRequired = worstCaseBytes;
     pProp->scratchBufferSizeBytes = scratchBytes;
+
+    if (auto presplit = (ze_rtas_builder_presplit_properties_t*) findDescInChain(pProp->pNext,ZE_STRUCTURE_TYPE_RTAS_BUILDER_PRESPLIT_PROPERTIES))
+      presplit->presplitBudget = presplitBudget;
+    
     return ZE_RESULT_SUCCESS;
   }
   
-  ze_result_t zeRTASBuilderBuildBody(API_TY aty, const ze_rtas_builder_build_op_exp_desc_t* args,
+  /* hashes the content of all geometries, optionally including the addresses of the descriptors and buffers,
+   * procedural geometries cannot get hashed as their bounds are provided by callbacks, and instances are
+   * only keyed by the address of the instantiated acceleration structure, not by its content */
+  RTASCacheKey computeGeometryKey(const ze_rtas_builder_build_op_exp_desc_t* args, bool hashPointers)
+  {
+    const ze_rtas_builder_geometry_info_exp_t** geometries = args->ppGeometries;
+    const uint32_t numGeometries = args->numGeometries;
+
+    std::vector<RTASCacheKey> geometryKeys(numGeometries);
+    parallel_for(numGeometries,[&](uint32_t geomID)
+    {
+      const ze_rtas_builder_geometry_info_exp_t* geom = geometries[geomID];
+      RTASCacheHasher hasher;
+      hasher.add(geom ? geom->geometryType : ~0u);
+      if (hashPointers) hasher.add(uint64_t(geom));
+      if (geom == nullptr) {
+        geometryKeys[geomID] = hasher.key();
+        return;
+      }
+      
+      switch (geom->geometryType) {
+      case ZE_RTAS_BUILDER_GEOMETRY_TYPE_EXP_TRIANGLES: {
+        const ze_rtas_builder_triangles_geometry_info_exp_t* mesh = (const ze_rtas_builder_triangles_geometry_info_exp_t*) geom;
+        hasher.add(mesh->geometryFlags); hasher.add(mesh->geometryMask);
+        hasher.add(mesh->triangleFormat); hasher.add(mesh->vertexFormat);
+        if (hashPointers) {
+          hasher.add(uint64_t(mesh->pTriangleBuffer)); hasher.add(mesh->triangleStride);
+          hasher.add(uint64_t(mesh->pVertexBuffer)); hasher.add(mesh->vertexStride);
+        }
+        hasher.addStrided(mesh->pTriangleBuffer,mesh->triangleCount,sizeof(ze_rtas_triangle_indices_uint32_exp_t),mesh->triangleStride);
+        hasher.addStrided(mesh->pVertexBuffer,mesh->vertexCount,sizeof(Vec3f),mesh->vertexStride);
+        break;
+      }
+      case ZE_RTAS_BUILDER_GEOMETRY_TYPE_EXP_QUADS: {
+        const ze_rtas_builder_quads_geometry_info_exp_t* mesh = (const ze_rtas_builder_quads_geometry_info_exp_t*) geom;
+        hasher.add(mesh->geometryFlags); hasher.add(mesh->geometryMask);
+        hasher.add(mesh->quadFormat); hasher.add(mesh->vertexFormat);
+        if (hashPointers) {
+          hasher.add(uint64_t(mesh->pQuadBuffer)); hasher.add(mesh->quadStride);
+          hasher.add(uint64_t(mesh->pVertexBuffer)); hasher.add(mesh->vertexStride);
+        }
+        hasher.addStrided(mesh->pQuadBuffer,mesh->quadCount,sizeof(ze_rtas_quad_indices_uint32_exp_t),mesh->quadStride);
+        hasher.addStrided(mesh->pVertexBuffer,mesh->vertexCount,sizeof(Vec3f),mesh->vertexStride);
+        break;
+      }
+      case ZE_RTAS_BUILDER_GEOMETRY_TYPE_EXP_INSTANCE: {
+        const ze_rtas_builder_instance_geometry_info_exp_t* inst = (const ze_rtas_builder_instance_geometry_info_exp_t*) geom;
+        hasher.add(inst->instanceFlags); hasher.add(inst->geometryMask); hasher.add(inst->instanceUserID);
+        const AffineSpace3fa xfm = getTransform(inst);
+        const float values[18] = {
+          xfm.l.vx.x, xfm.l.vx.y, xfm.l.vx.z, xfm.l.vy.x, xfm.l.vy.y, xfm.l.vy.z,
+          xfm.l.vz.x, xfm.l.vz.y, xfm.l.vz.z, xfm.p.x, xfm.p.y, xfm.p.z,
+          inst->pBounds->lower.x, inst->pBounds->lower.y, inst->pBounds->lower.z,
+          inst->pBounds->upper.x, inst->pBounds->upper.y, inst->pBounds->upper.z
+        };
+        for (float value : values)
+          hasher.add(*(const uint32_t*)&value);
+        hasher.add(uint64_t(inst->pAccelerationStructure));
+        break;
+      }
+      default: throw std::runtime_error("geometry type cannot get hashed");
+      };
+      geometryKeys[geomID] = hasher.key();
+    });
+
+    RTASCacheHasher hasher;
+    hasher.add(numGeometries);
+    for (const RTASCacheKey& key : geometryKeys)
+      hasher.addKey(key);
+    return hasher.key();
+  }
+
+  /* hashes all inputs the content of the acceleration structure depends on */
+  RTASCacheKey computeCacheKey(const ze_rtas_builder_build_op_exp_desc_t* args, ze_rtas_builder_layout_exp_t layout, bool deterministic, void* dispatchGlobalsPtr)
+  {
+    RTASCacheHasher hasher;
+    hasher.add(args->rtasFormat); hasher.add(args->buildQuality); hasher.add(args->buildFlags);
+    hasher.add(layout); hasher.add(deterministic); hasher.add(uint64_t(dispatchGlobalsPtr));
+    hasher.addKey(computeGeometryKey(args,false));
+    return hasher.key();
+  }
+
+  ze_result_t zeRTASBuilderBuildBody(API_TY aty, ze_rtas_builder* builder, const ze_rtas_builder_build_op_exp_desc_t* args,
                                             void *pScratchBuffer, size_t scratchBufferSizeBytes,
                                             void *pRtasBuffer, size_t rtasBufferSizeBytes,
                                             void *pBuildUserPtr, ze_rtas_aabb_exp_t *pBounds, size_t *pRtasBufferSizeBytes) try
@@ -631,26 +811,142 @@ namespace embree
       return QBVH6BuilderSAH::Instance(local2world,accel,geom->geometryMask,geom->instanceUserID); // FIXME: pass instance flags
     };
 
+    /* refit existing acceleration structure if requested */
+    if (findDescInChain(args->pNext,ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_UPDATE_DESC))
+    {
+      if (!pRtasBuffer || rtasBufferSizeBytes < sizeof(QBVH6) || ((QBVH6*)pRtasBuffer)->rtas_format != (ze_raytracing_accel_format_internal_t) args->rtasFormat)
+        return ZE_RESULT_ERROR_INVALID_ARGUMENT;
+      
+      for (uint32_t geomID=0; geomID<numGeometries; geomID++) {
+        if (getSize(geomID) == 0) continue;
+        const QBVH6BuilderSAH::Type type = getType(geomID);
+        if (type != QBVH6BuilderSAH::TRIANGLE && type != QBVH6BuilderSAH::QUAD)
+          return ZE_RESULT_ERROR_UNSUPPORTED_FEATURE;
+      }
+      
+      /* the acceleration structure stays unmodified if it does not match the geometries */
+      if (!QBVH6BuilderSAH::refit(numGeometries, getSize, getType, getTriangle, getQuad, (char*)pRtasBuffer, rtasBufferSizeBytes, (BBox3f*) pBounds, pRtasBufferSizeBytes))
+        return ZE_RESULT_ERROR_INVALID_ARGUMENT;
+      
+      return ZE_RESULT_SUCCESS;
+    }
+
     /* dispatch globals ptr for debugging purposes */
     void* dispatchGlobalsPtr = nullptr;
 #if defined(EMBREE_SYCL_ALLOC_DISPATCH_GLOBALS)
-    if (args->pNext) {
-      zet_base_desc_t_* next = (zet_base_desc_t_*) args->pNext;
-      if (next->stype == ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_DEBUG_DESC) {
-        ze_rtas_builder_build_op_debug_desc_t* debug_ext = (ze_rtas_builder_build_op_debug_desc_t*) next;
-        dispatchGlobalsPtr = debug_ext->dispatchGlobalsPtr;
+    if (auto debug_ext = (const ze_rtas_builder_build_op_debug_desc_t*) findDescInChain(args->pNext,ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_DEBUG_DESC))
+      dispatchGlobalsPtr = debug_ext->dispatchGlobalsPtr;
+#endif
+
+    /* a measure build only computes the exact acceleration structure size */
+    const bool measure = findDescInChain(args->pNext,ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_MEASURE_DESC) != nullptr;
+
+    /* optional output of build timings and counters */
+    auto buildStats = (ze_rtas_builder_build_op_stats_desc_t*) findDescInChain(args->pNext,ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_STATS_DESC);
+
+    /* optional reordering of the acceleration structure memory */
+    ze_rtas_builder_layout_exp_t layout = ZE_RTAS_BUILDER_LAYOUT_EXP_DEFAULT;
+    if (auto layout_ext = (const ze_rtas_builder_build_op_layout_desc_t*) findDescInChain(args->pNext,ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_LAYOUT_DESC))
+      layout = layout_ext->layout;
+
+    /* optional build whose output does not depend on the thread count */
+    const bool deterministic = findDescInChain(args->pNext,ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_DETERMINISTIC_DESC) != nullptr;
+
+    /* procedural geometries cannot get hashed as their bounds are provided by callbacks, and presplitting
+     * copies nodes of instantiated acceleration structures, which may get rebuilt in place at the same address */
+    const bool presplit = QBVH6BuilderSAH::useSpatialSplits(args->buildQuality,args->buildFlags);
+    bool hashable = true;
+    for (uint32_t geomID=0; hashable && geomID<numGeometries; geomID++)
+    {
+      const ze_rtas_builder_geometry_info_exp_t* geom = geometries[geomID];
+      if (geom == nullptr) continue;
+      hashable = geom->geometryType != ZE_RTAS_BUILDER_GEOMETRY_TYPE_EXP_PROCEDURAL;
+      hashable &= !presplit || geom->geometryType != ZE_RTAS_BUILDER_GEOMETRY_TYPE_EXP_INSTANCE;
+    }
+
+    /* optional cache of the acceleration structure, geometries that cannot get hashed are never cached */
+    auto cache_ext = (const ze_rtas_builder_build_op_cache_desc_t*) findDescInChain(args->pNext,ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_CACHE_DESC);
+    const bool cached = cache_ext && !measure && hashable;
+
+    RTASCacheKey cacheKey;
+    double cacheSeconds = 0.0;
+    if (cached)
+    {
+      const double t0 = getSeconds();
+      cacheKey = computeCacheKey(args,layout,deterministic,dispatchGlobalsPtr);
+      size_t rtasBytes = 0;
+      const bool hit = loadRTASCache(cache_ext->pCacheDirectory,cacheKey,pRtasBuffer,rtasBufferSizeBytes,rtasBytes);
+      cacheSeconds = getSeconds()-t0;
+
+      if (hit)
+      {
+        if (buildStats) {
+          const ze_structure_type_t stype = buildStats->stype;
+          const void* pNext = buildStats->pNext;
+          memset(buildStats,0,sizeof(ze_rtas_builder_build_op_stats_desc_t));
+          buildStats->stype = stype;
+          buildStats->pNext = pNext;
+          buildStats->cacheNs = buildStats->totalNs = uint64_t(cacheSeconds*1E9);
+          buildStats->rtasBytesAllocated = rtasBytes;
+          buildStats->cacheHit = true;
+        }
+        if (pRtasBufferSizeBytes) *pRtasBufferSizeBytes = rtasBytes;
+        if (rtasBytes > rtasBufferSizeBytes)
+          return ZE_RESULT_EXP_RTAS_BUILD_RETRY;
+        
+        if (pBounds) *(BBox3f*)pBounds = ((QBVH6*)pRtasBuffer)->bounds;
+        return ZE_RESULT_SUCCESS;
       }
     }
-#endif
 
+    /* the scratch buffer is only resumable by builds of the same geometry content in the same buffers */
+    auto getContentHash = [&](uint64_t& hash) -> bool {
+      if (!hashable) return false;
+      const RTASCacheKey key = computeGeometryKey(args,true);
+      hash = key.lo ^ key.hi;
+      return true;
+    };
+
+    /* the cache needs the acceleration structure size even if the application does not query it */
+    size_t rtasBytes = 0;
+    if (pRtasBufferSizeBytes == nullptr && cached)
+      pRtasBufferSizeBytes = &rtasBytes;
+
+    /* sample the presplit budget of triangles and quads */
+    double presplitFactor = 1.0;
+    if (QBVH6BuilderSAH::useSpatialSplits(args->buildQuality,args->buildFlags))
+    {
+      auto getMeshPrimitiveArea = [&](uint32_t geomID, uint32_t primID, BBox3fa& bounds, float& area) -> bool {
+        return getPresplitSample(aty,geometries[geomID],primID,bounds,area);
+      };
+      presplitFactor = QBVH6BuilderSAH::estimatePresplitFactor(numGeometries, getSize, getType, getMeshPrimitiveArea);
+    }
+    
+    /* reuse the temporary host buffers of previous builds of this builder */
+    std::unique_ptr<QBVH6BuilderSAH::BuildArena> arena = builder->acquireArena();
+    
     bool verbose = false;
     bool success = QBVH6BuilderSAH::build(numGeometries, nullptr, 
                            getSize, getType, 
-                           createPrimRefArray, getTriangle, getTriangleIndices, getQuad, getProcedural, getInstance,
+                           createPrimRefArray, getTriangle, getTriangleIndices, getQuad, getProcedural, getInstance, getContentHash,
                            (char*)pRtasBuffer, rtasBufferSizeBytes,
                            pScratchBuffer, scratchBufferSizeBytes,
                            (BBox3f*) pBounds, pRtasBufferSizeBytes,
-                           args->rtasFormat, args->buildQuality, args->buildFlags, verbose, dispatchGlobalsPtr);
+                           args->rtasFormat, args->buildQuality, args->buildFlags, verbose, dispatchGlobalsPtr, measure, arena.get(), buildStats, layout, deterministic, presplitFactor);
+    builder->releaseArena(std::move(arena));
+
+    if (success && cached)
+    {
+      const double t0 = getSeconds();
+      storeRTASCache(cache_ext->pCacheDirectory,cacheKey,pRtasBuffer,*pRtasBufferSizeBytes);
+      cacheSeconds += getSeconds()-t0;
+    }
+    
+    if (buildStats && cached) {
+      buildStats->cacheNs = uint64_t(cacheSeconds*1E9);
+      buildStats->totalNs += buildStats->cacheNs;
+    }
+    
     if (!success) {
       return ZE_RESULT_EXP_RTAS_BUILD_RETRY;
     }
@@ -661,6 +957,29 @@ namespace embree
     return ZE_RESULT_ERROR_UNKNOWN;
   }
   
+  ze_result_t validateBuildOp(API_TY aty, const ze_rtas_builder_build_op_exp_desc_t* args, void *pScratchBuffer, void *pRtasBuffer, size_t *pRtasBufferSizeBytes)
+  {
+    VALIDATE(aty,args);
+    VALIDATE_PTR(aty,pScratchBuffer);
+
+    /* measure builds do not need an acceleration structure buffer, but have to return its size */
+    if (findDescInChain(args->pNext,ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_MEASURE_DESC)) {
+      VALIDATE_PTR(aty,pRtasBufferSizeBytes);
+    } else {
+      VALIDATE_PTR(aty,pRtasBuffer);
+    }
+
+    if (auto layout = (const ze_rtas_builder_build_op_layout_desc_t*) findDescInChain(args->pNext,ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_LAYOUT_DESC)) {
+      if (uint32_t(layout->layout) > uint32_t(ZE_RTAS_BUILDER_LAYOUT_EXP_PAGE_CLUSTERED))
+        return ZE_RESULT_ERROR_INVALID_ENUMERATION;
+    }
+
+    if (auto cache = (const ze_rtas_builder_build_op_cache_desc_t*) findDescInChain(args->pNext,ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_CACHE_DESC)) {
+      VALIDATE_PTR(aty,cache->pCacheDirectory);
+    }
+    return ZE_RESULT_SUCCESS;
+  }
+  
   ze_result_t zeRTASBuilderBuildImpl(API_TY aty, ze_rtas_builder_exp_handle_t hBuilder,
                                                                      const ze_rtas_builder_build_op_exp_desc_t* args,
                                                                      void *pScratchBuffer, size_t scratchBufferSizeBytes,
@@ -670,9 +989,9 @@ namespace embree
   {
     /* input validation */
     VALIDATE(aty,hBuilder);
-    VALIDATE(aty,args);
-    VALIDATE_PTR(aty,pScratchBuffer);
-    VALIDATE_PTR(aty,pRtasBuffer);
+    ze_result_t result = validateBuildOp(aty,args,pScratchBuffer,pRtasBuffer,pRtasBufferSizeBytes);
+    if (result != ZE_RESULT_SUCCESS) return result;
+    ze_rtas_builder* builder = (ze_rtas_builder*) hBuilder;
     
     /* if parallel operation is provided then execute using thread arena inside task group ... */
     if (hParallelOperation)
@@ -687,7 +1006,7 @@ namespace embree
       op->object_in_use.store(true);
       
       g_arena.execute([&](){ op->group.run([=](){
-        op->errorCode = zeRTASBuilderBuildBody(aty,args,
+        op->errorCode = zeRTASBuilderBuildBody(aty,builder,args,
                                                        pScratchBuffer, scratchBufferSizeBytes,
                                                        pRtasBuffer, rtasBufferSizeBytes,
                                                        pBuildUserPtr, pBounds, pRtasBufferSizeBytes);
@@ -699,7 +1018,7 @@ namespace embree
     else
     {
       ze_result_t errorCode = ZE_RESULT_SUCCESS;
-      g_arena.execute([&](){ errorCode = zeRTASBuilderBuildBody(aty,args,
+      g_arena.execute([&](){ errorCode = zeRTASBuilderBuildBody(aty,builder,args,
                                                                         pScratchBuffer, scratchBufferSizeBytes,
                                                                         pRtasBuffer, rtasBufferSizeBytes,
                                                                         pBuildUserPtr, pBounds, pRtasBufferSizeBytes);
@@ -708,6 +1027,133 @@ namespace embree
     }
   }
 
+  /* runs all builds of the batch in a single task graph, largest builds first */
+  ze_result_t zeRTASBuilderBuildBatchBody(API_TY aty, ze_rtas_builder* builder, uint32_t numBuildOps, ze_rtas_builder_batch_build_op_exp_t* pBuildOps) try
+  {
+    /* estimate the cost of each build by its number of primitives */
+    std::vector<std::pair<size_t,uint32_t>> order(numBuildOps);
+    for (uint32_t i=0; i<numBuildOps; i++)
+    {
+      const ze_rtas_builder_build_op_exp_desc_t* args = pBuildOps[i].pBuildOpDescriptor;
+      size_t numPrimitives = 0;
+      for (uint32_t geomID=0; geomID<args->numGeometries; geomID++)
+        if (args->ppGeometries[geomID]) numPrimitives += getNumPrimitives(args->ppGeometries[geomID]);
+      order[i] = std::make_pair(numPrimitives,i);
+    }
+
+    /* starting the large builds first lets the small builds fill up the
+     * threads that the inner parallel loops of the large builds leave idle */
+    std::sort(order.begin(),order.end(),std::greater<std::pair<size_t,uint32_t>>());
+
+    parallel_for(numBuildOps,[&](uint32_t k) {
+      ze_rtas_builder_batch_build_op_exp_t& op = pBuildOps[order[k].second];
+      op.result = zeRTASBuilderBuildBody(aty,builder,op.pBuildOpDescriptor,
+                                         op.pScratchBuffer, op.scratchBufferSizeBytes,
+                                         op.pRtasBuffer, op.rtasBufferSizeBytes,
+                                         op.pBuildUserPtr, op.pBounds, op.pRtasBufferSizeBytes);
+    });
+
+    /* report the first failing build in batch order */
+    for (uint32_t i=0; i<numBuildOps; i++)
+      if (pBuildOps[i].result != ZE_RESULT_SUCCESS)
+        return pBuildOps[i].result;
+    
+    return ZE_RESULT_SUCCESS;
+  }
+  catch (std::exception& e) {
+    return ZE_RESULT_ERROR_UNKNOWN;
+  }
+
+  ze_result_t zeRTASBuilderBuildBatchImpl(API_TY aty, ze_rtas_builder_exp_handle_t hBuilder,
+                                          uint32_t numBuildOps, ze_rtas_builder_batch_build_op_exp_t* pBuildOps,
+                                          ze_rtas_parallel_operation_exp_handle_t hParallelOperation)
+  {
+    /* input validation */
+    VALIDATE(aty,hBuilder);
+    if (numBuildOps) VALIDATE_PTR(aty,pBuildOps);
+    
+    for (uint32_t i=0; i<numBuildOps; i++)
+    {
+      ze_rtas_builder_batch_build_op_exp_t& op = pBuildOps[i];
+      op.result = validateBuildOp(aty,op.pBuildOpDescriptor,op.pScratchBuffer,op.pRtasBuffer,op.pRtasBufferSizeBytes);
+      if (op.result != ZE_RESULT_SUCCESS) return op.result;
+    }
+    ze_rtas_builder* builder = (ze_rtas_builder*) hBuilder;
+
+    /* if parallel operation is provided then execute using thread arena inside task group ... */
+    if (hParallelOperation)
+    {
+      VALIDATE(aty,hParallelOperation);
+      
+      ze_rtas_parallel_operation_t* op = (ze_rtas_parallel_operation_t*) hParallelOperation;
+      
+      if (op->object_in_use.load())
+        return ZE_RESULT_ERROR_HANDLE_OBJECT_IN_USE;
+      
+      op->object_in_use.store(true);
+      
+      g_arena.execute([&](){ op->group.run([=](){
+        op->errorCode = zeRTASBuilderBuildBatchBody(aty,builder,numBuildOps,pBuildOps);
+                                            });
+                       });
+      return ZE_RESULT_EXP_RTAS_BUILD_DEFERRED;
+    }
+    /* ... otherwise we just execute inside task arena to avoid spawning of TBB worker threads */
+    else
+    {
+      ze_result_t errorCode = ZE_RESULT_SUCCESS;
+      g_arena.execute([&](){ errorCode = zeRTASBuilderBuildBatchBody(aty,builder,numBuildOps,pBuildOps); });
+      return errorCode;
+    }
+  }
+
+  ze_result_t zeRTASRelocateBody(void* pRtasBuffer, size_t rtasBufferSizeBytes, const std::vector<QBVH6BuilderSAH::InstanceRelocator::Relocation>& relocations, void* dispatchGlobalsPtr) try
+  {
+    QBVH6BuilderSAH::InstanceRelocator relocator((char*)pRtasBuffer,rtasBufferSizeBytes,relocations);
+    relocator.relocate(dispatchGlobalsPtr);
+    return ZE_RESULT_SUCCESS;
+  }
+  catch (std::exception& e) {
+    return ZE_RESULT_ERROR_UNKNOWN;
+  }
+
+  ze_result_t zeRTASRelocateImpl(API_TY aty, void* pRtasBuffer, size_t rtasBufferSizeBytes,
+                                 uint32_t numRelocations, const ze_rtas_relocation_exp_t* pRelocations,
+                                 void* dispatchGlobalsPtr)
+  {
+    /* input validation */
+    VALIDATE_PTR(aty,pRtasBuffer);
+    if (numRelocations) VALIDATE_PTR(aty,pRelocations);
+
+    if (rtasBufferSizeBytes < sizeof(QBVH6))
+      return ZE_RESULT_ERROR_INVALID_SIZE;
+
+    const ze_raytracing_accel_format_internal_t rtasFormat = ((QBVH6*)pRtasBuffer)->rtas_format;
+    if (rtasFormat != ZE_RTAS_DEVICE_FORMAT_EXP_VERSION_1 && rtasFormat != ZE_RTAS_DEVICE_FORMAT_EXP_VERSION_2)
+      return ZE_RESULT_EXP_ERROR_OPERANDS_INCOMPATIBLE;
+
+    /* sorted relocations allow a binary search for each instance */
+    std::vector<QBVH6BuilderSAH::InstanceRelocator::Relocation> relocations(numRelocations);
+    for (uint32_t i=0; i<numRelocations; i++) {
+      VALIDATE_PTR(aty,pRelocations[i].pOldRtasBuffer);
+      VALIDATE_PTR(aty,pRelocations[i].pNewRtasBuffer);
+      if ((uint64_t) pRelocations[i].pOldRtasBuffer + pRelocations[i].rtasBufferSizeBytes < (uint64_t) pRelocations[i].pOldRtasBuffer)
+        return ZE_RESULT_ERROR_INVALID_SIZE;
+      relocations[i].oldBegin = (uint64_t) pRelocations[i].pOldRtasBuffer;
+      relocations[i].oldEnd   = (uint64_t) pRelocations[i].pOldRtasBuffer + pRelocations[i].rtasBufferSizeBytes;
+      relocations[i].newBegin = (uint64_t) pRelocations[i].pNewRtasBuffer;
+    }
+    std::sort(relocations.begin(),relocations.end());
+
+    for (size_t i=1; i<relocations.size(); i++)
+      if (relocations[i-1].oldEnd > relocations[i].oldBegin)
+        return ZE_RESULT_ERROR_INVALID_ARGUMENT;
+
+    ze_result_t errorCode = ZE_RESULT_SUCCESS;
+    g_arena.execute([&](){ errorCode = zeRTASRelocateBody(pRtasBuffer,rtasBufferSizeBytes,relocations,dispatchGlobalsPtr); });
+    return errorCode;
+  }
+
   ze_result_t zeRTASParallelOperationCreateImpl(API_TY aty, ze_driver_handle_t hDriver, ze_rtas_parallel_operation_exp_handle_t* phParallelOperation)
   {
     /* input validation */
@@ -790,6 +1236,23 @@ namespace embree
                                   pBuildUserPtr, (ze_rtas_aabb_exp_t*) pBounds, pRtasBufferSizeBytes);
   }
 
+  RTHWIF_API_EXPORT ze_result_t ZE_APICALL zeRTASBuilderBuildBatchExtImpl(ze_rtas_builder_ext_handle_t hBuilder,
+                                                                          uint32_t numBuildOps, ze_rtas_builder_batch_build_op_ext_t* pBuildOps,
+                                                                          ze_rtas_parallel_operation_ext_handle_t hParallelOperation)
+  {
+    return zeRTASBuilderBuildBatchImpl(EXT_API,
+                                       (ze_rtas_builder_exp_handle_t) hBuilder,
+                                       numBuildOps, (ze_rtas_builder_batch_build_op_exp_t*) pBuildOps,
+                                       (ze_rtas_parallel_operation_exp_handle_t) hParallelOperation);
+  }
+
+  RTHWIF_API_EXPORT ze_result_t ZE_APICALL zeRTASRelocateExtImpl(void* pRtasBuffer, size_t rtasBufferSizeBytes,
+                                                                 uint32_t numRelocations, const ze_rtas_relocation_ext_t* pRelocations,
+                                                                 void* dispatchGlobalsPtr)
+  {
+    return zeRTASRelocateImpl(EXT_API, pRtasBuffer, rtasBufferSizeBytes, numRelocations, pRelocations, dispatchGlobalsPtr);
+  }
+
   RTHWIF_API_EXPORT ze_result_t ZE_APICALL zeRTASParallelOperationCreateExtImpl(ze_driver_handle_t hDriver, ze_rtas_parallel_operation_ext_handle_t* phParallelOperation) {
     return zeRTASParallelOperationCreateImpl(EXT_API, hDriver, (ze_rtas_parallel_operation_exp_handle_t*) phParallelOperation);
   }
@@ -839,6 +1302,20 @@ namespace embree
                                      pBuildUserPtr, pBounds, pRtasBufferSizeBytes);
   }
 
+  RTHWIF_API_EXPORT ze_result_t ZE_APICALL zeRTASBuilderBuildBatchExpImpl(ze_rtas_builder_exp_handle_t hBuilder,
+                                                                          uint32_t numBuildOps, ze_rtas_builder_batch_build_op_exp_t* pBuildOps,
+                                                                          ze_rtas_parallel_operation_exp_handle_t hParallelOperation)
+  {
+    return zeRTASBuilderBuildBatchImpl(EXP_API, hBuilder, numBuildOps, pBuildOps, hParallelOperation);
+  }
+
+  RTHWIF_API_EXPORT ze_result_t ZE_APICALL zeRTASRelocateExpImpl(void* pRtasBuffer, size_t rtasBufferSizeBytes,
+                                                                 uint32_t numRelocations, const ze_rtas_relocation_exp_t* pRelocations,
+                                                                 void* dispatchGlobalsPtr)
+  {
+    return zeRTASRelocateImpl(EXP_API, pRtasBuffer, rtasBufferSizeBytes, numRelocations, pRelocations, dispatchGlobalsPtr);
+  }
+
   RTHWIF_API_EXPORT ze_result_t ZE_APICALL zeRTASParallelOperationCreateExpImpl(ze_driver_handle_t hDriver, ze_rtas_parallel_operation_exp_handle_t* phParallelOperation) {
     return zeRTASParallelOperationCreateImpl(EXP_API, hDriver, phParallelOperation);
   }
@@ -854,4 +1331,12 @@ namespace embree
   RTHWIF_API_EXPORT ze_result_t ZE_APICALL zeRTASParallelOperationJoinExpImpl( ze_rtas_parallel_operation_exp_handle_t hParallelOperation) {
     return zeRTASParallelOperationJoinImpl( EXP_API, hParallelOperation);
   }
+
+  RTHWIF_API_EXPORT ze_result_t ZE_APICALL zeRTASBuilderSetThreadCountImpl(uint32_t numThreads)
+  {
+    const int N = numThreads ? (int) numThreads : tbb::this_task_arena::max_concurrency();
+    g_arena.terminate();
+    g_arena.initialize(N,N);
+    return ZE_RESULT_SUCCESS;
+  }
 }
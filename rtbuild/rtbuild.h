@@ -54,6 +54,32 @@ RTHWIF_API_EXPORT ze_result_t ZE_APICALL zeRTASBuilderBuildExtImpl(ze_rtas_build
                                                                    ze_rtas_parallel_operation_ext_handle_t hParallelOperation,
                                                                    void *pBuildUserPtr, ze_rtas_aabb_ext_t *pBounds, size_t *pRtasBufferSizeBytes);
 
+/* The batch build functions run all builds of the pBuildOps array in a
+ * single task graph, such that many small builds run concurrently and
+ * large builds additionally use inner parallelism. The function returns
+ * ZE_RESULT_SUCCESS if all builds succeeded, otherwise the result of
+ * the first failing build. When a parallel operation is passed the
+ * builds are deferred like for zeRTASBuilderBuildExt, and the pBuildOps
+ * array and all buffers have to stay valid until the parallel operation
+ * got joined. */
+RTHWIF_API_EXPORT ze_result_t ZE_APICALL zeRTASBuilderBuildBatchExtImpl(ze_rtas_builder_ext_handle_t hBuilder,
+                                                                        uint32_t numBuildOps, ze_rtas_builder_batch_build_op_ext_t* pBuildOps,
+                                                                        ze_rtas_parallel_operation_ext_handle_t hParallelOperation);
+
+/* Instance leaves store the absolute address of the instantiated
+ * acceleration structures, all other references are relative. The
+ * relocate functions patch the instances of the acceleration structure
+ * in pRtasBuffer according to the pRelocations array, instances of
+ * acceleration structures not listed stay unchanged. The dispatch
+ * globals pointer of the acceleration structure is set to
+ * dispatchGlobalsPtr. This allows to copy, store, and load
+ * acceleration structures with instances without rebuilding them. The
+ * acceleration structure has to be accessible by the host and no
+ * other operation may access it during relocation. */
+RTHWIF_API_EXPORT ze_result_t ZE_APICALL zeRTASRelocateExtImpl(void* pRtasBuffer, size_t rtasBufferSizeBytes,
+                                                               uint32_t numRelocations, const ze_rtas_relocation_ext_t* pRelocations,
+                                                               void* dispatchGlobalsPtr);
+
 RTHWIF_API_EXPORT ze_result_t ZE_APICALL zeRTASParallelOperationCreateExtImpl(ze_driver_handle_t hDriver, ze_rtas_parallel_operation_ext_handle_t* phParallelOperation);
 
 RTHWIF_API_EXPORT ze_result_t ZE_APICALL zeRTASParallelOperationDestroyExtImpl( ze_rtas_parallel_operation_ext_handle_t hParallelOperation );
@@ -82,6 +108,16 @@ RTHWIF_API_EXPORT ze_result_t ZE_APICALL zeRTASBuilderBuildExpImpl(ze_rtas_build
                                                                    ze_rtas_parallel_operation_exp_handle_t hParallelOperation,
                                                                    void *pBuildUserPtr, ze_rtas_aabb_exp_t *pBounds, size_t *pRtasBufferSizeBytes);
 
+/* EXP version of zeRTASBuilderBuildBatchExtImpl */
+RTHWIF_API_EXPORT ze_result_t ZE_APICALL zeRTASBuilderBuildBatchExpImpl(ze_rtas_builder_exp_handle_t hBuilder,
+                                                                        uint32_t numBuildOps, ze_rtas_builder_batch_build_op_exp_t* pBuildOps,
+                                                                        ze_rtas_parallel_operation_exp_handle_t hParallelOperation);
+
+/* EXP version of zeRTASRelocateExtImpl */
+RTHWIF_API_EXPORT ze_result_t ZE_APICALL zeRTASRelocateExpImpl(void* pRtasBuffer, size_t rtasBufferSizeBytes,
+                                                               uint32_t numRelocations, const ze_rtas_relocation_exp_t* pRelocations,
+                                                               void* dispatchGlobalsPtr);
+
 RTHWIF_API_EXPORT ze_result_t ZE_APICALL zeRTASParallelOperationCreateExpImpl(ze_driver_handle_t hDriver, ze_rtas_parallel_operation_exp_handle_t* phParallelOperation);
 
 RTHWIF_API_EXPORT ze_result_t ZE_APICALL zeRTASParallelOperationDestroyExpImpl( ze_rtas_parallel_operation_exp_handle_t hParallelOperation );
@@ -89,3 +125,10 @@ RTHWIF_API_EXPORT ze_result_t ZE_APICALL zeRTASParallelOperationDestroyExpImpl(
 RTHWIF_API_EXPORT ze_result_t ZE_APICALL zeRTASParallelOperationGetPropertiesExpImpl( ze_rtas_parallel_operation_exp_handle_t hParallelOperation, ze_rtas_parallel_operation_exp_properties_t* pProperties );
 
 RTHWIF_API_EXPORT ze_result_t ZE_APICALL zeRTASParallelOperationJoinExpImpl( ze_rtas_parallel_operation_exp_handle_t hParallelOperation);
+
+/* Test hook that re-creates the task arena the builder runs in with
+ * numThreads threads, 0 restores the default number of threads. The
+ * number of threads determines how the builder partitions its work,
+ * thus this allows to test that deterministic builds do not depend on
+ * it. No other operation of the builder may run concurrently. */
+RTHWIF_API_EXPORT ze_result_t ZE_APICALL zeRTASBuilderSetThreadCountImpl(uint32_t numThreads);
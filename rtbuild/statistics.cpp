@@ -81,7 +81,7 @@ namespace embree
     cout.setf(std::ios::fixed, std::ios::floatfield);
     cout.fill(' ');
     
-    double totalSAH   = internalNode.nodeSAH + quadLeaf.leafSAH + proceduralLeaf.leafSAH + instanceLeaf.leafSAH;
+    double totalSAH   = sah();
     size_t totalBytes = internalNode.bytes() + quadLeaf.bytes() + proceduralLeaf.bytes() + instanceLeaf.bytes();
     size_t totalNodes = internalNode.numNodes + quadLeaf.numLeaves + proceduralLeaf.numLeaves + instanceLeaf.numLeaves;
     size_t totalPrimitives = quadLeaf.numPrimsUsed + proceduralLeaf.numPrimsUsed + instanceLeaf.numPrimsUsed;
@@ -95,6 +95,7 @@ namespace embree
     cout << "  primRefSplits               = " << std::setprecision(2) << percent(numBuildPrimitivesPostSplit,numBuildPrimitives) << "%" << std::endl;
     cout << "  numBVHPrimitives            = " << totalPrimitives << std::endl;
     cout << "  spatialSplits               = " << std::setprecision(2) << percent(totalPrimitives,numScenePrimitives) << "%" << std::endl;    
+    cout << "  pageCrossings               = " << std::setprecision(3) << pageCrossingSAH << std::endl;
     cout << std::endl;
      
     cout << "                      #nodes     SAH   total       bytes     used    total   b/node  b/child   b/prim  #child     fill" << std::endl;
@@ -125,6 +126,8 @@ namespace embree
     size_t totalPrimitives = quadLeaf.numPrimsUsed + proceduralLeaf.numPrimsUsed + instanceLeaf.numPrimsUsed;
     cout << "bvh_spatial_split_factor = " << percent(totalPrimitives,numBuildPrimitives) << std::endl;
     
+    cout << "bvh_page_crossing_sah = " << pageCrossingSAH << std::endl;
+    
     cout << "bvh_internal_sah = " << internalNode.nodeSAH << std::endl;
     cout << "bvh_internal_num = " << internalNode.numNodes << std::endl;
     cout << "bvh_internal_num_children_used = " << internalNode.numChildrenUsed << std::endl;
@@ -102,7 +102,12 @@ namespace embree
     };
 
     BVHStatistics ()
-    : numScenePrimitives(0), numBuildPrimitives(0), numBuildPrimitivesPostSplit(0) {}
+    : numScenePrimitives(0), numBuildPrimitives(0), numBuildPrimitivesPostSplit(0), pageCrossingSAH(0.0) {}
+        
+    /* total SAH cost, each internal node and leaf costs one traversal step of the hardware */
+    double sah() const {
+      return internalNode.sah() + quadLeaf.sah() + proceduralLeaf.sah() + instanceLeaf.sah();
+    }
         
     void print    (std::ostream& cout) const;
     void print_raw(std::ostream& cout) const;
@@ -114,5 +119,8 @@ namespace embree
     LeafStat quadLeaf;
     LeafStat proceduralLeaf;
     LeafStat instanceLeaf;
+
+    /* expected number of traversal steps per ray that go from a node to a child in a different 4kB page, weighted like the SAH */
+    double pageCrossingSAH;
   };
 }
@@ -39,6 +39,10 @@
 #include <map>
 #include <iostream>
 #include <fstream>
+#include <filesystem>
+#include <chrono>
+#include <algorithm>
+#include <atomic>
 
 namespace embree {
   double getSeconds();
@@ -139,6 +143,31 @@ enum class TestType
   BUILD_TEST_PROCEDURALS,            // test BVH builder with procedurals
   BUILD_TEST_INSTANCES,              // test BVH builder with instances
   BUILD_TEST_MIXED,                  // test BVH builder with mixed scene (triangles, procedurals, and instances)
+  BUILD_TEST_COMPACT,                // test compact builds return the exact size
+  BUILD_TEST_REFIT,                  // test refitting triangles after their vertices moved
+  BUILD_TEST_RESUME,                 // test resuming builds after ZE_RESULT_EXP_RTAS_BUILD_RETRY
+  BUILD_TEST_BATCH,                  // test batch build of instantiated scenes
+  BUILD_TEST_LAYOUT,                 // test all layouts of the acceleration structure
+  BUILD_TEST_DETERMINISTIC,          // test deterministic builds do not depend on the number of threads
+  BUILD_TEST_CACHE,                  // test hits and misses of the RTAS cache
+  BUILD_TEST_CACHE_INSTANCES,        // test the RTAS cache with instances
+  BUILD_TEST_TREELET,                // test the treelet optimization of high quality builds
+  BUILD_TEST_RELOCATE,               // test relocating instances after the instantiated scenes moved
+  BUILD_TEST_PROCEDURAL_BATCH,       // test procedural bounds get queried in blocks of primitives
+  BUILD_TEST_MORTON,                 // test low quality builds with many equal Morton codes
+  BUILD_TEST_ARENA,                  // test builds reusing the temporary buffers of the builder
+  BUILD_TEST_STATS,                  // test the statistics returned by builds
+  BUILD_TEST_MORTON_REMAINDER,       // test the Morton code kernels with any number of primitives
+  BUILD_TEST_QUAD_PAIRING,           // test the quadifier pairs all triangles of a plane
+  BUILD_TEST_QUAD_STITCHING,         // test multi threaded quadification pairs triangles across task borders
+  BUILD_TEST_COMPACT_PRIMREFS,       // test compacting the primitive references of invalid primitives
+  BUILD_TEST_THREAD_BLOCKS,          // test per-thread allocation blocks near the smallest buffer enabling them
+  BUILD_TEST_OPEN_INSTANCES,         // test opening instances that share acceleration structures
+  BUILD_TEST_PRESPLIT,               // test presplitting long thin triangles
+  BUILD_TEST_PRESPLIT_SCRATCH,       // test presplitting with the reported scratch size
+  BUILD_TEST_PRESPLIT_BUDGET,        // test the presplit budget of different meshes
+  BUILD_TEST_SPATIAL_SPLITS,         // test spatial splits of high quality builds
+  BUILD_TEST_FALLBACK_SPLITS,        // test fallback splits of duplicated triangles
   BENCHMARK_TRIANGLES,               // benchmark BVH builder with triangles
   BENCHMARK_PROCEDURALS,             // benchmark BVH builder with procedurals
 };
@@ -146,7 +175,8 @@ enum class TestType
 enum class BuildMode
 {
   BUILD_EXPECTED_SIZE,
-  BUILD_WORST_CASE_SIZE
+  BUILD_WORST_CASE_SIZE,
+  BUILD_MEASURED_SIZE
 };
 
 struct TestInput
@@ -533,6 +563,17 @@ struct Geometry
   Type type;
 };
 
+/* counts the bounds queries of a procedural triangle mesh */
+struct BoundsQueryCounter
+{
+  BoundsQueryCounter (size_t numPrimitives)
+    : primitives(numPrimitives) {}
+
+  std::vector<std::atomic<uint32_t>> primitives; // number of queries of each primitive
+  std::atomic<uint32_t> callbacks{0};            // number of callback invocations
+  std::atomic<uint32_t> invalidRanges{0};        // callbacks with empty or out of range primitive ranges
+};
+
 struct TriangleMesh : public Geometry
 {
 public:
@@ -567,6 +608,16 @@ public:
     assert(params->stype == ZE_STRUCTURE_TYPE_RTAS_GEOMETRY_AABBS_EXP_CB_PARAMS);
     const TriangleMesh* mesh = (TriangleMesh*) params->pGeomUserPtr;
 
+    if (BoundsQueryCounter* counter = mesh->boundsQueries)
+    {
+      counter->callbacks++;
+      if (params->primIDCount == 0 || size_t(params->primID)+params->primIDCount > mesh->size())
+        counter->invalidRanges++;
+      else
+        for (uint32_t i=0; i<params->primIDCount; i++)
+          counter->primitives[params->primID+i]++;
+    }
+
     for (uint32_t i=0; i<params->primIDCount; i++)
     {
       const uint32_t primID = params->primID+i;
@@ -760,6 +811,7 @@ public:
 public:
   ze_rtas_builder_geometry_exp_flags_t gflags = 0;
   bool procedural = false;
+  BoundsQueryCounter* boundsQueries = nullptr; // optionally counts the bounds queries of procedurals
   
   typedef usm_allocator<sycl::int4, sycl::usm::alloc::shared> triangles_alloc_ty;
   triangles_alloc_ty triangles_alloc;
@@ -867,6 +919,40 @@ struct InstanceGeometryT : public Geometry
   std::shared_ptr<Scene> scene;
 };
 
+/* geometry that is part of the acceleration structure but never gets hit by the test rays */
+struct HiddenGeometry : public Geometry
+{
+  HiddenGeometry (std::shared_ptr<Geometry> geometry)
+    : Geometry(geometry->type), geometry(geometry) {}
+
+  virtual ~HiddenGeometry() {}
+
+  void* operator new(size_t size) {
+    return sycl::aligned_alloc_shared(64,size,device,context,sycl::ext::oneapi::property::usm::device_read_only());
+  }
+  void operator delete(void* ptr) {
+    sycl::free(ptr,context);
+  }
+
+  virtual void getDesc(GEOMETRY_DESC* desc) override {
+    geometry->getDesc(desc);
+  }
+
+  virtual void buildAccel(sycl::device& device, sycl::context& context, BuildMode buildMode, ze_rtas_builder_build_quality_hint_exp_t quality) override {
+    geometry->buildAccel(device,context,buildMode,quality);
+  }
+
+  /* the test rays never hit hidden geometries, thus they map no triangles */
+  virtual void buildTriMap(Transform local_to_world, std::vector<uint32_t> id_stack, uint32_t instUserID, bool procedural_instance, std::vector<Hit>& tri_map) override {
+  }
+
+  size_t getNumPrimitives() const override {
+    return geometry->getNumPrimitives();
+  }
+
+  std::shared_ptr<Geometry> geometry;
+};
+
 std::shared_ptr<TriangleMesh> createTrianglePlane (const sycl::float3& p0, const sycl::float3& dx, const sycl::float3& dy, size_t width, size_t height)
 {
   std::shared_ptr<TriangleMesh> mesh(new TriangleMesh);
@@ -1135,6 +1221,13 @@ struct Scene
         mesh->procedural = i%2;
   }
 
+  /* inserts a geometry the test rays never hit at a random position */
+  void addHidden(std::shared_ptr<Geometry> geometry)
+  {
+    const size_t geomID = RandomSampler_getUInt(rng) % (geometries.size()+1);
+    geometries.insert(geometries.begin()+geomID, std::shared_ptr<Geometry>(new HiddenGeometry(geometry)));
+  }
+
   void addNullGeometries(uint32_t D)
   {
     size_t N = geometries.size();
@@ -1149,8 +1242,14 @@ struct Scene
 
   void buildAccel(sycl::device& device, sycl::context& context, BuildMode buildMode, bool benchmark = false)
   {
-     ze_rtas_builder_build_quality_hint_exp_t quality = (ze_rtas_builder_build_quality_hint_exp_t) (RandomSampler_getUInt(rng) % 3);
-     
+    /* keep acceleration structures of batch builds and of scenes rebuilt in place */
+    if (keepAccel)
+      return;
+    
+    /* scenes with a fixed build quality do not use the random number generator, thus can get built concurrently */
+    ze_rtas_builder_build_quality_hint_exp_t quality = (ze_rtas_builder_build_quality_hint_exp_t) buildQuality;
+    if (buildQuality < 0) quality = (ze_rtas_builder_build_quality_hint_exp_t) (RandomSampler_getUInt(rng) % 3);
+    
     /* fill geometry descriptor buffer */
     std::vector<GEOMETRY_DESC> desc(size());
     std::vector<const ze_rtas_builder_geometry_info_exp_t*> geom(size());
@@ -1188,18 +1287,21 @@ struct Scene
     args.pNext = nullptr;
     args.rtasFormat = rtasProp.rtasFormat;
     args.buildQuality = quality;
-    args.buildFlags = 0;
+    args.buildFlags = buildFlags;
     args.ppGeometries = (const ze_rtas_builder_geometry_info_exp_t**) geom.data();
     args.numGeometries = geom.size();
+    args.pNext = buildExt;
 
     /* just for debugging purposes */
 #if defined(EMBREE_SYCL_ALLOC_DISPATCH_GLOBALS)
     ze_rtas_builder_build_op_debug_desc_t buildOpDebug = { ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_DEBUG_DESC };
+    buildOpDebug.pNext = buildExt;
     buildOpDebug.dispatchGlobalsPtr = dispatchGlobalsPtr;
     args.pNext = &buildOpDebug;
 #endif
     
     ze_rtas_builder_exp_properties_t size = { ZE_STRUCTURE_TYPE_RTAS_BUILDER_EXP_PROPERTIES };
+    size.pNext = propertiesExt;
     err = ZeWrapper::zeRTASBuilderGetBuildPropertiesExp(hBuilder,&args,&size);
     if (err != ZE_RESULT_SUCCESS)
       throw std::runtime_error("BVH size estimate failed");
@@ -1209,11 +1311,15 @@ struct Scene
 
     /* allocate scratch buffer */
     size_t sentinelBytes = 1024; // add that many zero bytes to catch buffer overruns
-    std::vector<char> scratchBuffer(size.scratchBufferSizeBytes+sentinelBytes);
+    const size_t scratchBytes = size_t(scratchBytesScale*double(size.scratchBufferSizeBytes));
+    std::vector<char> scratchBuffer(scratchBytes+sentinelBytes);
     memset(scratchBuffer.data(),0,scratchBuffer.size());
 
+    free_accel_buffer(accel,context);
     accel = nullptr;
-    size_t accelBytes = 0;
+    accelBytes = 0;
+    accelBytesWorstCase = size.rtasBufferSizeBytesMaxRequired;
+    numRetries = 0;
     
     /* build with different modes */
     switch (buildMode)
@@ -1263,7 +1369,7 @@ struct Scene
     }
     case BuildMode::BUILD_EXPECTED_SIZE: {
       
-      size_t bytes = size.rtasBufferSizeBytesExpected;
+      size_t bytes = initialAccelBytes ? initialAccelBytes : size_t(expectedBytesScale*double(size.rtasBufferSizeBytesExpected));
       for (size_t i=0; i<=16; i++) // FIXME: reduce worst cast iteration number
       {
         if (i == 16)
@@ -1303,6 +1409,7 @@ struct Scene
           throw std::runtime_error("failed build returned wrong new estimate");
 
         bytes = accelBufferBytesOut;
+        numRetries++;
       }
       
       if (err != ZE_RESULT_SUCCESS)
@@ -1310,14 +1417,65 @@ struct Scene
 
       break;
     }
+    case BuildMode::BUILD_MEASURED_SIZE: {
+
+      /* the measure build returns the exact size of a following build with the same scratch buffer */
+      ze_rtas_builder_build_op_measure_desc_t measure = { ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_MEASURE_DESC };
+      measure.pNext = args.pNext;
+      ze_rtas_builder_build_op_exp_desc_t measureArgs = args;
+      measureArgs.pNext = &measure;
+
+      for (size_t i=0; i<2; i++)
+      {
+        /* allocate BVH data of measured size */
+        if (i == 1) {
+          accelBytes = accelBufferBytesOut;
+          accel = alloc_accel_buffer(accelBytes+sentinelBytes,device,context);
+          memset(accel,0,accelBytes+sentinelBytes);
+        }
+        
+        /* measure first, then build accel */
+        err = ZeWrapper::zeRTASBuilderBuildExp(hBuilder,i == 0 ? &measureArgs : &args,
+                                        scratchBuffer.data(),scratchBuffer.size(),
+                                        accel, accelBytes,
+                                        parallelOperation,
+                                        nullptr, &bounds, &accelBufferBytesOut);
+
+        if (parallelOperation)
+        {
+          assert(err == ZE_RESULT_EXP_RTAS_BUILD_DEFERRED);
+          
+          ze_rtas_parallel_operation_exp_properties_t prop = { ZE_STRUCTURE_TYPE_RTAS_PARALLEL_OPERATION_EXP_PROPERTIES };
+          err = ZeWrapper::zeRTASParallelOperationGetPropertiesExp(parallelOperation,&prop);
+          if (err != ZE_RESULT_SUCCESS)
+            throw std::runtime_error("get max concurrency failed");
+          
+          tbb::parallel_for(0u, prop.maxConcurrency, 1u, [&](uint32_t) {
+            err = ZeWrapper::zeRTASParallelOperationJoinExp(parallelOperation);
+          });
+        }
+
+        if (err == ZE_RESULT_EXP_RTAS_BUILD_RETRY)
+          throw std::runtime_error("build of measured size requires retry");
+        
+        if (err != ZE_RESULT_SUCCESS)
+          throw std::runtime_error(i == 0 ? "measure error" : "build error");
+      }
+
+      if (accelBufferBytesOut != accelBytes)
+        throw std::runtime_error("build size differs from measured size");
+
+      break;
+    }
     }
 
     this->bounds = bounds;
+    this->accelBytesUsed = accelBufferBytesOut;
 
     if (!benchmark)
     {
       /* scratch buffer bounds check */
-      for (size_t i=size.scratchBufferSizeBytes; i<size.scratchBufferSizeBytes+sentinelBytes; i++) {
+      for (size_t i=scratchBytes; i<scratchBytes+sentinelBytes; i++) {
         if (scratchBuffer[i] == 0x00) continue;
         throw std::runtime_error("scratch buffer bounds check failed");
       }
@@ -1334,6 +1492,204 @@ struct Scene
     }
   }
   
+  /* builds the acceleration structures of all instantiated scenes with a single batch build */
+  void buildInstancedScenesBatch(sycl::device& device, sycl::context& context)
+  {
+    std::vector<std::shared_ptr<Scene>> scenes;
+    for (size_t geomID=0; geomID<size(); geomID++)
+      if (std::shared_ptr<InstanceGeometry> instance = std::dynamic_pointer_cast<InstanceGeometry>(geometries[geomID]))
+        scenes.push_back(instance->scene);
+
+    ze_device_handle_t hDevice = sycl::get_native<sycl::backend::ext_oneapi_level_zero>(device);
+
+    ze_rtas_device_exp_properties_t rtasProp = { ZE_STRUCTURE_TYPE_RTAS_DEVICE_EXP_PROPERTIES };
+    ze_device_properties_t devProp = { ZE_STRUCTURE_TYPE_DEVICE_PROPERTIES, &rtasProp };
+    ze_result_t err = ZeWrapper::zeDeviceGetProperties(hDevice, &devProp );
+    if (err != ZE_RESULT_SUCCESS)
+      throw std::runtime_error("zeDeviceGetProperties failed");
+
+    const size_t numScenes = scenes.size();
+    std::vector<std::vector<GEOMETRY_DESC>> desc(numScenes);
+    std::vector<std::vector<const ze_rtas_builder_geometry_info_exp_t*>> geom(numScenes);
+    std::vector<ze_rtas_builder_build_op_exp_desc_t> args(numScenes);
+    std::vector<std::vector<char>> scratchBuffers(numScenes);
+    std::vector<ze_rtas_aabb_exp_t> bounds(numScenes);
+    std::vector<size_t> accelBufferBytesOut(numScenes);
+    std::vector<ze_rtas_builder_batch_build_op_exp_t> buildOps(numScenes);
+#if defined(EMBREE_SYCL_ALLOC_DISPATCH_GLOBALS)
+    std::vector<ze_rtas_builder_build_op_debug_desc_t> buildOpDebug(numScenes);
+#endif
+
+    for (size_t i=0; i<numScenes; i++)
+    {
+      Scene& scene = *scenes[i];
+
+      /* fill geometry descriptor buffer */
+      desc[i].resize(scene.size());
+      geom[i].resize(scene.size());
+      for (size_t geomID=0; geomID<scene.size(); geomID++)
+      {
+        const std::shared_ptr<Geometry>& g = scene.geometries[geomID];
+        if (g == nullptr) {
+          geom[i][geomID] = nullptr;
+          continue;
+        }
+        g->getDesc(&desc[i][geomID]);
+        geom[i][geomID] = (const ze_rtas_builder_geometry_info_exp_t*) &desc[i][geomID];
+      }
+
+      memset(&args[i],0,sizeof(args[i]));
+      args[i].stype = ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_EXP_DESC;
+      args[i].pNext = nullptr;
+      args[i].rtasFormat = rtasProp.rtasFormat;
+      args[i].buildQuality = (ze_rtas_builder_build_quality_hint_exp_t) (RandomSampler_getUInt(rng) % 3);
+      args[i].buildFlags = 0;
+      args[i].ppGeometries = (const ze_rtas_builder_geometry_info_exp_t**) geom[i].data();
+      args[i].numGeometries = geom[i].size();
+
+#if defined(EMBREE_SYCL_ALLOC_DISPATCH_GLOBALS)
+      buildOpDebug[i] = { ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_DEBUG_DESC };
+      buildOpDebug[i].dispatchGlobalsPtr = dispatchGlobalsPtr;
+      args[i].pNext = &buildOpDebug[i];
+#endif
+
+      ze_rtas_builder_exp_properties_t size = { ZE_STRUCTURE_TYPE_RTAS_BUILDER_EXP_PROPERTIES };
+      err = ZeWrapper::zeRTASBuilderGetBuildPropertiesExp(hBuilder,&args[i],&size);
+      if (err != ZE_RESULT_SUCCESS)
+        throw std::runtime_error("BVH size estimate failed");
+
+      /* worst case size, thus no build of the batch has to get retried */
+      scratchBuffers[i].resize(size.scratchBufferSizeBytes);
+      free_accel_buffer(scene.accel,context);
+      scene.accelBytes = size.rtasBufferSizeBytesMaxRequired;
+      scene.accel = alloc_accel_buffer(scene.accelBytes,device,context);
+      memset(scene.accel,0,scene.accelBytes);
+
+      buildOps[i].pBuildOpDescriptor = &args[i];
+      buildOps[i].pScratchBuffer = scratchBuffers[i].data();
+      buildOps[i].scratchBufferSizeBytes = scratchBuffers[i].size();
+      buildOps[i].pRtasBuffer = scene.accel;
+      buildOps[i].rtasBufferSizeBytes = scene.accelBytes;
+      buildOps[i].pBuildUserPtr = nullptr;
+      buildOps[i].pBounds = &bounds[i];
+      buildOps[i].pRtasBufferSizeBytes = &accelBufferBytesOut[i];
+      buildOps[i].result = ZE_RESULT_SUCCESS;
+    }
+
+    /* build all accels */
+    err = ZeWrapper::zeRTASBuilderBuildBatchExp(hBuilder,(uint32_t)numScenes,buildOps.data(),parallelOperation);
+    
+    if (parallelOperation)
+    {
+      assert(err == ZE_RESULT_EXP_RTAS_BUILD_DEFERRED);
+      
+      ze_rtas_parallel_operation_exp_properties_t prop = { ZE_STRUCTURE_TYPE_RTAS_PARALLEL_OPERATION_EXP_PROPERTIES };
+      err = ZeWrapper::zeRTASParallelOperationGetPropertiesExp(parallelOperation,&prop);
+      if (err != ZE_RESULT_SUCCESS)
+        throw std::runtime_error("get max concurrency failed");
+      
+      tbb::parallel_for(0u, prop.maxConcurrency, 1u, [&](uint32_t) {
+        err = ZeWrapper::zeRTASParallelOperationJoinExp(parallelOperation);
+      });
+    }
+    
+    if (err != ZE_RESULT_SUCCESS)
+      throw std::runtime_error("batch build error");
+
+    for (size_t i=0; i<numScenes; i++)
+    {
+      if (buildOps[i].result != ZE_RESULT_SUCCESS)
+        throw std::runtime_error("build error in batch");
+      
+      if (accelBufferBytesOut[i] > scenes[i]->accelBytes)
+        throw std::runtime_error("wrong acceleration structure size returned");
+      
+      scenes[i]->bounds = bounds[i];
+      scenes[i]->accelBytesUsed = accelBufferBytesOut[i];
+      scenes[i]->keepAccel = true;
+    }
+  }
+
+  /* refits the acceleration structure to the current vertex positions of the triangle meshes */
+  void refitAccel(sycl::device& device, sycl::context& context)
+  {
+    /* fill geometry descriptor buffer */
+    std::vector<GEOMETRY_DESC> desc(size());
+    std::vector<const ze_rtas_builder_geometry_info_exp_t*> geom(size());
+    for (size_t geomID=0; geomID<size(); geomID++)
+    {
+      const std::shared_ptr<Geometry>& g = geometries[geomID];
+      
+      /* skip NULL geometries */
+      if (g == nullptr) {
+        geom[geomID] = nullptr;
+        continue;
+      }
+
+      g->getDesc(&desc[geomID]);
+      geom[geomID] = (const ze_rtas_builder_geometry_info_exp_t*) &desc[geomID];
+    }
+
+    ze_device_handle_t hDevice = sycl::get_native<sycl::backend::ext_oneapi_level_zero>(device);
+
+    ze_rtas_device_exp_properties_t rtasProp = { ZE_STRUCTURE_TYPE_RTAS_DEVICE_EXP_PROPERTIES };
+    ze_device_properties_t devProp = { ZE_STRUCTURE_TYPE_DEVICE_PROPERTIES, &rtasProp };
+    ze_result_t err = ZeWrapper::zeDeviceGetProperties(hDevice, &devProp );
+    if (err != ZE_RESULT_SUCCESS)
+      throw std::runtime_error("zeDeviceGetProperties failed");
+
+    ze_rtas_builder_build_op_update_desc_t update = { ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_UPDATE_DESC };
+    update.pNext = buildExt;
+    
+    ze_rtas_builder_build_op_exp_desc_t args;
+    memset(&args,0,sizeof(args));
+    args.stype = ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_EXP_DESC;
+    args.pNext = &update;
+    args.rtasFormat = rtasProp.rtasFormat;
+    args.buildQuality = ZE_RTAS_BUILDER_BUILD_QUALITY_HINT_EXP_MEDIUM;
+    args.buildFlags = buildFlags;
+    args.ppGeometries = (const ze_rtas_builder_geometry_info_exp_t**) geom.data();
+    args.numGeometries = geom.size();
+
+    ze_rtas_builder_exp_properties_t size = { ZE_STRUCTURE_TYPE_RTAS_BUILDER_EXP_PROPERTIES };
+    err = ZeWrapper::zeRTASBuilderGetBuildPropertiesExp(hBuilder,&args,&size);
+    if (err != ZE_RESULT_SUCCESS)
+      throw std::runtime_error("BVH size estimate failed");
+    
+    std::vector<char> scratchBuffer(size.scratchBufferSizeBytes);
+
+    /* refit accel in place */
+    ze_rtas_aabb_exp_t bounds;
+    size_t accelBufferBytesOut = 0;
+    err = ZeWrapper::zeRTASBuilderBuildExp(hBuilder,&args,
+                                           scratchBuffer.data(),scratchBuffer.size(),
+                                           accel, accelBytes,
+                                           parallelOperation,
+                                           nullptr, &bounds, &accelBufferBytesOut);
+    
+    if (parallelOperation)
+    {
+      assert(err == ZE_RESULT_EXP_RTAS_BUILD_DEFERRED);
+      
+      ze_rtas_parallel_operation_exp_properties_t prop = { ZE_STRUCTURE_TYPE_RTAS_PARALLEL_OPERATION_EXP_PROPERTIES };
+      err = ZeWrapper::zeRTASParallelOperationGetPropertiesExp(parallelOperation,&prop);
+      if (err != ZE_RESULT_SUCCESS)
+        throw std::runtime_error("get max concurrency failed");
+      
+      tbb::parallel_for(0u, prop.maxConcurrency, 1u, [&](uint32_t) {
+        err = ZeWrapper::zeRTASParallelOperationJoinExp(parallelOperation);
+      });
+    }
+    
+    if (err != ZE_RESULT_SUCCESS)
+      throw std::runtime_error("refit error");
+
+    if (accelBufferBytesOut > accelBytes)
+      throw std::runtime_error("refit returned wrong acceleration structure size");
+
+    this->bounds = bounds;
+  }
+  
   void buildTriMap(Transform local_to_world, std::vector<uint32_t> id_stack, uint32_t instUserID, bool procedural_instance, std::vector<Hit>& tri_map)
   {    
     for (uint32_t geomID=0; geomID<geometries.size(); geomID++)
@@ -1370,6 +1726,20 @@ struct Scene
 
   ze_rtas_aabb_exp_t bounds;
   void* accel;
+  size_t accelBytes = 0;      // allocated bytes of the acceleration structure buffer
+  size_t accelBytesUsed = 0;  // size of the acceleration structure returned by the build
+  size_t accelBytesWorstCase = 0; // worst case size of the acceleration structure reported for the build
+  uint32_t numRetries = 0;    // number of builds that returned ZE_RESULT_EXP_RTAS_BUILD_RETRY
+
+  /* build settings of the extension tests */
+  int buildQuality = -1;                                 // random build quality if negative
+  ze_rtas_builder_build_op_exp_flags_t buildFlags = 0;
+  const void* buildExt = nullptr;                        // extension structures chained to the build operation descriptor
+  void* propertiesExt = nullptr;                         // extension structures chained to the build properties
+  double expectedBytesScale = 1.0;                       // scales the expected size of the first build to force retries
+  size_t initialAccelBytes = 0;                          // size of the first build instead of the scaled expected size if not zero
+  double scratchBytesScale = 1.0;                        // scales the reported scratch buffer size
+  bool keepAccel = false;                                // further builds keep the current acceleration structure
 };
 
 void exception_handler(sycl::exception_list exceptions)
@@ -1912,10 +2282,11 @@ uint32_t executeTest(sycl::device& device, sycl::queue& queue, sycl::context& co
   return numErrors;
 }
 
-uint32_t executeBuildTest(sycl::device& device, sycl::queue& queue, sycl::context& context, TestType test, BuildMode buildMode, uint32_t numPrimitives, int testID)
+std::shared_ptr<Scene> createBuildTestScene(TestType test, uint32_t numPrimitives, int testID, const Transform& xfm = Transform())
 {
   const uint32_t width = 2*(uint32_t)ceilf(sqrtf(numPrimitives));
   std::shared_ptr<TriangleMesh> plane = createTrianglePlane(sycl::float3(0,0,0), sycl::float3(width,0,0), sycl::float3(0,width,0), width, width);
+  plane->transform(xfm);
   if (test == TestType::BUILD_TEST_PROCEDURALS) plane->procedural = true;
   plane->selectRandom(numPrimitives);
   if (testID%2) plane->unshareVertices();
@@ -1938,8 +2309,12 @@ uint32_t executeBuildTest(sycl::device& device, sycl::queue& queue, sycl::contex
   }
 
   scene->addNullGeometries(16);
-  scene->buildAccel(device,context,buildMode,false);
+  return scene;
+}
 
+/* traces one ray per primitive of the build test scene and compares the hits with the expected ones */
+uint32_t traceBuildTest(sycl::device& device, sycl::queue& queue, sycl::context& context, std::shared_ptr<Scene> scene, uint32_t numPrimitives)
+{
   /* calculate test input and expected output */
   TestInput* in = (TestInput*) sycl::aligned_alloc(64,numPrimitives*sizeof(TestInput),device,context,sycl::usm::alloc::shared);
   memset(in, 0, numPrimitives*sizeof(TestInput));
@@ -1984,93 +2359,1048 @@ uint32_t executeBuildTest(sycl::device& device, sycl::queue& queue, sycl::contex
   return numErrors;
 }
 
-uint32_t executeBuildTest(sycl::device& device, sycl::queue& queue, sycl::context& context, TestType test, BuildMode buildMode)
+/* compact builds have to return the exact size without unused bytes, and are never larger than default builds */
+uint32_t executeCompactTest(sycl::device& device, sycl::queue& queue, sycl::context& context, BuildMode buildMode, uint32_t numPrimitives, int testID)
 {
+  std::shared_ptr<Scene> scene = createBuildTestScene(TestType::BUILD_TEST_TRIANGLES,numPrimitives,testID);
+  scene->buildQuality = RandomSampler_getUInt(rng) % 3;
+  scene->buildAccel(device,context,buildMode,false);
+  const size_t defaultBytes = scene->accelBytesUsed;
+
+  ze_rtas_builder_build_op_stats_desc_t stats = { ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_STATS_DESC };
+  scene->buildFlags = ZE_RTAS_BUILDER_BUILD_OP_EXP_FLAG_COMPACT;
+  scene->buildExt = &stats;
+  scene->buildAccel(device,context,buildMode,false);
+
   uint32_t numErrors = 0;
-  for (uint32_t i=0; i<128; i++) {
+  if (scene->accelBytesUsed > defaultBytes) {
+    std::cout << "compact build returned " << scene->accelBytesUsed << " bytes but default build only " << defaultBytes << " bytes" << std::endl;
+    numErrors++;
+  }
+  if (stats.rtasBytesUnused != 0) {
+    std::cout << "compact build left " << stats.rtasBytesUnused << " bytes unused" << std::endl;
+    numErrors++;
+  }
+  if (stats.rtasBytesAllocated != scene->accelBytesUsed) {
+    std::cout << "compact build returned " << scene->accelBytesUsed << " bytes but allocated " << stats.rtasBytesAllocated << " bytes" << std::endl;
+    numErrors++;
+  }
 
-    const uint32_t numPrimitives = i>10 ? i*i : i;
-    std::cout << "testing " << numPrimitives << " primitives" << std::endl;
-    numErrors += executeBuildTest(device,queue,context,test,buildMode,numPrimitives,i);
+  /* the buffer is zero initialized, thus the build wrote no byte after the returned size and the last cache line of it is in use */
+  const char* accel = (const char*) scene->getAccel();
+  const size_t lineBytes = std::min(scene->accelBytesUsed,size_t(64));
+  if (std::any_of(accel+scene->accelBytesUsed, accel+scene->accelBytes, [](char c) { return c != 0; })) {
+    std::cout << "compact build wrote data after the returned size of " << scene->accelBytesUsed << " bytes" << std::endl;
+    numErrors++;
   }
-  return numErrors;
+  if (numPrimitives && std::all_of(accel+scene->accelBytesUsed-lineBytes, accel+scene->accelBytesUsed, [](char c) { return c == 0; })) {
+    std::cout << "compact build returned " << scene->accelBytesUsed << " bytes but left the last ones unused" << std::endl;
+    numErrors++;
+  }
+  return numErrors + traceBuildTest(device,queue,context,scene,numPrimitives);
 }
 
-uint32_t executeBenchmark(sycl::device& device, sycl::queue& queue, sycl::context& context, TestType test)
+/* builds that run out of memory have to resume from the primitive references in the scratch buffer */
+uint32_t executeResumeTest(sycl::device& device, sycl::queue& queue, sycl::context& context, uint32_t numPrimitives, int testID)
 {
-  for (uint32_t i=0; i<=20; i++)
-  {
-    const uint32_t numPrimitives = 1<<i;
+  std::shared_ptr<Scene> scene = createBuildTestScene(TestType::BUILD_TEST_TRIANGLES,numPrimitives,testID);
 
-    switch (test) {
-    default: break;
-    case TestType::BENCHMARK_TRIANGLES  : std::cout << "benchmarking " << numPrimitives << " triangles: "; break;
-    case TestType::BENCHMARK_PROCEDURALS: std::cout << "benchmarking " << numPrimitives << " procedurals: "; break;
-    };
+  /* spatial splits of high quality builds modify the primitive references, such builds never resume */
+  ze_rtas_builder_build_op_stats_desc_t stats = { ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_STATS_DESC };
+  scene->buildQuality = ZE_RTAS_BUILDER_BUILD_QUALITY_HINT_EXP_MEDIUM;
+  scene->buildExt = &stats;
+  scene->expectedBytesScale = 0.01; // the first build gets a buffer that is much too small
+  scene->buildAccel(device,context,BuildMode::BUILD_EXPECTED_SIZE,false);
 
-    const uint32_t width = 2*(uint32_t)ceilf(sqrtf(numPrimitives));
-    std::shared_ptr<TriangleMesh> plane = createTrianglePlane(sycl::float3(0,0,0), sycl::float3(width,0,0), sycl::float3(0,width,0), width, width);
-    if (test == TestType::BENCHMARK_PROCEDURALS) plane->procedural = true;
-    plane->selectSequential(numPrimitives);
-    
-    std::shared_ptr<Scene> scene(new Scene);
-    scene->add(plane);
-    
-    scene->buildAccel(device,context,BuildMode::BUILD_WORST_CASE_SIZE,true);
+  uint32_t numErrors = 0;
+  if (numPrimitives && scene->numRetries == 0) {
+    std::cout << "build did not retry with a too small buffer" << std::endl;
+    numErrors++;
   }
-  return 0;
+  if (scene->numRetries && !stats.resumed) {
+    std::cout << "build did not resume after " << scene->numRetries << " retries" << std::endl;
+    numErrors++;
+  }
+  return numErrors + traceBuildTest(device,queue,context,scene,numPrimitives);
 }
 
-enum Flags : uint32_t {
-  FLAGS_NONE,
-  DEPTH_TEST_LESS_EQUAL = 1 << 0  // when set we use <= for depth test, otherwise <
-};
-
-struct DispatchGlobals
+/* builds the instantiated scenes with a single batch build and the instances on top */
+uint32_t executeBatchTest(sycl::device& device, sycl::queue& queue, sycl::context& context, BuildMode buildMode, uint32_t numPrimitives, int testID)
 {
-  uint64_t rtMemBasePtr;               // base address of the allocated stack memory
-  uint64_t callStackHandlerKSP;             // this is the KSP of the continuation handler that is invoked by BTD when the read KSP is 0
-  uint32_t asyncStackSize;             // async-RT stack size in 64 byte blocks
-  uint32_t numDSSRTStacks : 16;        // number of stacks per DSS
-  uint32_t syncRayQueryCount : 4;      // number of ray queries in the sync-RT stack: 0-15 mapped to: 1-16
-  unsigned _reserved_mbz : 12;
-  uint32_t maxBVHLevels;               // the maximal number of supported instancing levels (0->8, 1->1, 2->2, ...)
-  Flags flags;                         // per context control flags
-};
+  std::shared_ptr<Scene> scene = createBuildTestScene(TestType::BUILD_TEST_INSTANCES,numPrimitives,testID);
+  scene->buildInstancedScenesBatch(device,context);
+  scene->buildAccel(device,context,buildMode,false);
+  return traceBuildTest(device,queue,context,scene,numPrimitives);
+}
 
-void* allocDispatchGlobals(sycl::device device, sycl::context context)
+/* builds and traces the scene with each layout of the acceleration structure */
+uint32_t executeLayoutTest(sycl::device& device, sycl::queue& queue, sycl::context& context, BuildMode buildMode, uint32_t numPrimitives, int testID)
 {
-  size_t maxBVHLevels = 2; //RTC_MAX_INSTANCE_LEVEL_COUNT+1;
-  
-  size_t rtstack_bytes = (64+maxBVHLevels*(64+32)+63)&-64;
-  size_t num_rtstacks = 1<<17; // this is sufficiently large also for PVC
-  size_t dispatchGlobalSize = 128+num_rtstacks*rtstack_bytes;
-  
-  void* dispatchGlobalsPtr = alloc_accel_buffer(dispatchGlobalSize,device,context);
-  memset(dispatchGlobalsPtr, 0, dispatchGlobalSize);
+  std::shared_ptr<Scene> scene = createBuildTestScene(TestType::BUILD_TEST_MIXED,numPrimitives,testID);
 
-  DispatchGlobals* dg = (DispatchGlobals*) dispatchGlobalsPtr;
-  dg->rtMemBasePtr = (uint64_t) dispatchGlobalsPtr + dispatchGlobalSize;
-  dg->callStackHandlerKSP = 0;
-  dg->asyncStackSize = 0;
-  dg->numDSSRTStacks = 0;
-  dg->syncRayQueryCount = 0;
-  dg->_reserved_mbz = 0;
-  dg->maxBVHLevels = maxBVHLevels;
-  dg->flags = DEPTH_TEST_LESS_EQUAL;
-  
-  return dispatchGlobalsPtr;
+  const ze_rtas_builder_layout_exp_t layouts[] = {
+    ZE_RTAS_BUILDER_LAYOUT_EXP_DEFAULT,
+    ZE_RTAS_BUILDER_LAYOUT_EXP_DEPTH_FIRST,
+    ZE_RTAS_BUILDER_LAYOUT_EXP_PAGE_CLUSTERED
+  };
+
+  uint32_t numErrors = 0;
+  for (size_t i=0; i<sizeof(layouts)/sizeof(layouts[0]); i++)
+  {
+    ze_rtas_builder_build_op_layout_desc_t layout = { ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_LAYOUT_DESC };
+    layout.layout = layouts[i];
+    scene->buildExt = &layout;
+    scene->buildAccel(device,context,buildMode,false);
+    scene->buildExt = nullptr;
+    numErrors += traceBuildTest(device,queue,context,scene,numPrimitives);
+  }
+  return numErrors;
 }
 
-int main(int argc, char* argv[]) try
+/* deterministic builds have to return the same acceleration structure for any number of threads */
+uint32_t executeDeterministicTest(sycl::device& device, sycl::queue& queue, sycl::context& context, BuildMode buildMode, uint32_t numPrimitives, int testID)
 {
-  TestType test = TestType::TRIANGLES_COMMITTED_HIT;
-  InstancingType inst = InstancingType::NONE;
-  BuildMode buildMode = BuildMode::BUILD_EXPECTED_SIZE;
-  ZeWrapper::RTAS_BUILD_MODE rtas_build_mode = ZeWrapper::RTAS_BUILD_MODE::LEVEL_ZERO;
-  
-  bool jit_cache = false;
-  uint32_t numThreads = tbb::this_task_arena::max_concurrency();
+  std::shared_ptr<Scene> scene = createBuildTestScene(TestType::BUILD_TEST_TRIANGLES,numPrimitives,testID);
+
+  ze_rtas_builder_build_op_deterministic_desc_t deterministic = { ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_DETERMINISTIC_DESC };
+  scene->buildQuality = RandomSampler_getUInt(rng) % 3;
+  scene->buildExt = &deterministic;
+  scene->buildAccel(device,context,buildMode,false);
+  const std::vector<char> accel0((char*)scene->getAccel(), (char*)scene->getAccel() + scene->accelBytesUsed);
+
+  /* build again on a single thread, which changes how the builder partitions its work */
+  if (ZeWrapper::zeRTASBuilderSetThreadCount(1) != ZE_RESULT_SUCCESS)
+    throw std::runtime_error("setting builder thread count failed");
+  scene->buildAccel(device,context,buildMode,false);
+  ZeWrapper::zeRTASBuilderSetThreadCount(0);
+
+  uint32_t numErrors = 0;
+  if (scene->accelBytesUsed != accel0.size() || memcmp(scene->getAccel(),accel0.data(),accel0.size()) != 0) {
+    std::cout << "single threaded build differs from multi threaded build" << std::endl;
+    numErrors++;
+  }
+  return numErrors + traceBuildTest(device,queue,context,scene,numPrimitives);
+}
+
+/* creates a new cache directory for each test, as concurrently running tests would otherwise share cache entries */
+std::filesystem::path createCacheDirectory()
+{
+  const std::filesystem::path cacheDir = std::filesystem::temp_directory_path() / ("rthwif_test_cache_" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()));
+  std::filesystem::create_directories(cacheDir);
+  return cacheDir;
+}
+
+/* rebuilding unchanged geometries has to hit the RTAS cache, while moved vertices have to miss it */
+uint32_t executeCacheTest(sycl::device& device, sycl::queue& queue, sycl::context& context, BuildMode buildMode, uint32_t numPrimitives, int testID)
+{
+  const std::filesystem::path cacheDir = createCacheDirectory();
+  const std::string cacheDirName = cacheDir.string();
+  
+  std::shared_ptr<Scene> scene = createBuildTestScene(TestType::BUILD_TEST_TRIANGLES,numPrimitives,testID);
+
+  ze_rtas_builder_build_op_stats_desc_t stats = { ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_STATS_DESC };
+  ze_rtas_builder_build_op_cache_desc_t cache = { ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_CACHE_DESC };
+  cache.pNext = &stats;
+  cache.pCacheDirectory = cacheDirName.c_str();
+  scene->buildQuality = RandomSampler_getUInt(rng) % 3;
+  scene->buildExt = &cache;
+
+  uint32_t numErrors = 0;
+  const bool expectCacheHit[3] = { false, true, false };
+  for (size_t i=0; i<3; i++)
+  {
+    if (i == 2) {
+      for (uint32_t geomID=0; geomID<scene->size(); geomID++) {
+        if (std::shared_ptr<TriangleMesh> mesh = std::dynamic_pointer_cast<TriangleMesh>((*scene)[geomID])) {
+          for (size_t j=0; j<mesh->vertices.size(); j++)
+            mesh->vertices[j].z() += 1.0f;
+        }
+      }
+    }
+    
+    scene->buildAccel(device,context,buildMode,false);
+    
+    if (bool(stats.cacheHit) != expectCacheHit[i]) {
+      std::cout << "build " << i << (expectCacheHit[i] ? " missed" : " hit") << " the RTAS cache" << std::endl;
+      numErrors++;
+    }
+    numErrors += traceBuildTest(device,queue,context,scene,numPrimitives);
+  }
+  
+  std::filesystem::remove_all(cacheDir);
+  return numErrors;
+}
+
+/* instance builds are keyed by the address of the instantiated acceleration structures, thus a
+ * rebuild of those in place that keeps their bounds hits the cache, except for high quality builds,
+ * which copy nodes of the instantiated acceleration structures and are never cached */
+uint32_t executeCacheInstancesTest(sycl::device& device, sycl::queue& queue, sycl::context& context, uint32_t numPrimitives, int testID)
+{
+  const std::filesystem::path cacheDir = createCacheDirectory();
+  const std::string cacheDirName = cacheDir.string();
+  
+  std::shared_ptr<Scene> scene = createBuildTestScene(TestType::BUILD_TEST_INSTANCES,numPrimitives,testID);
+
+  ze_rtas_builder_build_op_stats_desc_t stats = { ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_STATS_DESC };
+  ze_rtas_builder_build_op_cache_desc_t cache = { ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_CACHE_DESC };
+  cache.pNext = &stats;
+  cache.pCacheDirectory = cacheDirName.c_str();
+  scene->buildQuality = RandomSampler_getUInt(rng) % 3;
+  scene->buildExt = &cache;
+  const bool cacheable = scene->buildQuality != ZE_RTAS_BUILDER_BUILD_QUALITY_HINT_EXP_HIGH;
+
+  /* worst case sized buffers, such that the instantiated acceleration structures can get rebuilt in place */
+  const BuildMode buildMode = BuildMode::BUILD_WORST_CASE_SIZE;
+  
+  uint32_t numErrors = 0;
+  const bool expectCacheHit[3] = { false, cacheable, cacheable };
+  for (size_t i=0; i<3; i++)
+  {
+    for (uint32_t geomID=0; geomID<scene->size(); geomID++)
+    {
+      std::shared_ptr<Scene::InstanceGeometry> instance = std::dynamic_pointer_cast<Scene::InstanceGeometry>((*scene)[geomID]);
+      if (instance == nullptr) continue;
+      Scene& instScene = *instance->scene;
+      
+      /* keep the instantiated acceleration structures of the first build */
+      if (i < 2) {
+        instScene.keepAccel = i == 1;
+        continue;
+      }
+
+      /* reversing the triangle order changes the content but not the bounds of the instantiated scene */
+      for (uint32_t instGeomID=0; instGeomID<instScene.size(); instGeomID++) {
+        if (std::shared_ptr<TriangleMesh> mesh = std::dynamic_pointer_cast<TriangleMesh>(instScene[instGeomID]))
+          std::reverse(mesh->triangles.begin(),mesh->triangles.end());
+      }
+      
+      void* accel = instScene.accel;
+      const size_t accelBytes = instScene.accelBytes;
+      instScene.accel = nullptr;
+      instScene.keepAccel = false;
+      instScene.buildAccel(device,context,buildMode,false);
+
+      if (instScene.accelBytesUsed > accelBytes)
+        throw std::runtime_error("in place rebuild does not fit into the acceleration structure buffer");
+
+      memcpy(accel,instScene.accel,instScene.accelBytesUsed);
+      free_accel_buffer(instScene.accel,context);
+      instScene.accel = accel;
+      instScene.accelBytes = accelBytes;
+      instScene.keepAccel = true;
+    }
+    
+    scene->buildAccel(device,context,buildMode,false);
+    
+    if (bool(stats.cacheHit) != expectCacheHit[i]) {
+      std::cout << "instance build " << i << (expectCacheHit[i] ? " missed" : " hit") << " the RTAS cache" << std::endl;
+      numErrors++;
+    }
+    numErrors += traceBuildTest(device,queue,context,scene,numPrimitives);
+  }
+  
+  std::filesystem::remove_all(cacheDir);
+  return numErrors;
+}
+
+/* moves the instantiated acceleration structures and relocates the instances to their new addresses */
+uint32_t executeRelocateTest(sycl::device& device, sycl::queue& queue, sycl::context& context, BuildMode buildMode, uint32_t numPrimitives, int testID)
+{
+  std::shared_ptr<Scene> scene = createBuildTestScene(TestType::BUILD_TEST_INSTANCES,numPrimitives,testID);
+  scene->buildAccel(device,context,buildMode,false);
+
+  std::vector<ze_rtas_relocation_exp_t> relocations;
+  for (uint32_t geomID=0; geomID<scene->size(); geomID++)
+  {
+    std::shared_ptr<Scene::InstanceGeometry> instance = std::dynamic_pointer_cast<Scene::InstanceGeometry>((*scene)[geomID]);
+    if (instance == nullptr) continue;
+
+    Scene& instScene = *instance->scene;
+    const size_t bytes = (instScene.accelBytesUsed+127) & -128;
+    void* accel = alloc_accel_buffer(bytes,device,context);
+    memcpy(accel,instScene.accel,instScene.accelBytesUsed);
+
+    ze_rtas_relocation_exp_t relocation;
+    relocation.pOldRtasBuffer = instScene.accel;
+    relocation.pNewRtasBuffer = accel;
+    relocation.rtasBufferSizeBytes = instScene.accelBytesUsed;
+    relocations.push_back(relocation);
+
+    /* clear the old copy, thus rays traversing it miss */
+    memset(instScene.accel,0,instScene.accelBytesUsed);
+    free_accel_buffer(instScene.accel,context);
+    instScene.accel = accel;
+    instScene.accelBytes = bytes;
+  }
+
+  ze_result_t err = ZeWrapper::zeRTASRelocateExp(scene->getAccel(),scene->accelBytesUsed,(uint32_t)relocations.size(),relocations.data(),dispatchGlobalsPtr);
+  if (err != ZE_RESULT_SUCCESS)
+    throw std::runtime_error("relocation failed");
+  
+  return traceBuildTest(device,queue,context,scene,numPrimitives);
+}
+
+/* moves the vertices, refits the acceleration structure, and traces the refitted one */
+uint32_t executeRefitTest(sycl::device& device, sycl::queue& queue, sycl::context& context, BuildMode buildMode, uint32_t numPrimitives, int testID)
+{
+  std::shared_ptr<Scene> scene = createBuildTestScene(TestType::BUILD_TEST_TRIANGLES,numPrimitives,testID);
+  scene->buildAccel(device,context,buildMode,false);
+
+  /* only move along z, thus the triangles still do not overlap along the test rays */
+  for (uint32_t geomID=0; geomID<scene->size(); geomID++)
+  {
+    if (std::shared_ptr<TriangleMesh> mesh = std::dynamic_pointer_cast<TriangleMesh>((*scene)[geomID])) {
+      for (size_t i=0; i<mesh->vertices.size(); i++)
+        mesh->vertices[i].z() = 4.0f*RandomSampler_getFloat(rng)-2.0f;
+    }
+  }
+
+  scene->refitAccel(device,context);
+  return traceBuildTest(device,queue,context,scene,numPrimitives);
+}
+
+/* the treelet optimization of high quality builds swaps subtrees after the build, the optimized BVH has to trace correctly */
+uint32_t executeTreeletTest(sycl::device& device, sycl::queue& queue, sycl::context& context, BuildMode buildMode, uint32_t numPrimitives, int testID)
+{
+  std::shared_ptr<Scene> scene = createBuildTestScene(TestType::BUILD_TEST_MIXED,numPrimitives,testID);
+
+  ze_rtas_builder_build_op_stats_desc_t stats = { ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_STATS_DESC };
+  scene->buildQuality = ZE_RTAS_BUILDER_BUILD_QUALITY_HINT_EXP_HIGH;
+  scene->buildExt = &stats;
+  scene->buildAccel(device,context,buildMode,false);
+
+  uint32_t numErrors = 0;
+  if (stats.sahAfter > stats.sahBefore*1.0001) {
+    std::cout << "treelet optimization increased SAH from " << stats.sahBefore << " to " << stats.sahAfter << std::endl;
+    numErrors++;
+  }
+  return numErrors + traceBuildTest(device,queue,context,scene,numPrimitives);
+}
+
+/* the quadifier pairs all triangles of a plane, with the triangles in strip order or shuffled within small blocks */
+uint32_t executeQuadPairingTest(sycl::device& device, sycl::queue& queue, sycl::context& context, uint32_t numPrimitives, int testID)
+{
+  const uint32_t width = (uint32_t)ceilf(sqrtf(0.5f*numPrimitives));
+  const uint32_t numTriangles = 2*width*width;
+  std::shared_ptr<TriangleMesh> plane = createTrianglePlane(sycl::float3(0,0,0), sycl::float3(width,0,0), sycl::float3(0,width,0), width, width);
+
+  const uint32_t blockSize = 16;
+  if (testID%2) {
+    for (uint32_t i=0; i<numTriangles; i++) {
+      const uint32_t begin = i-i%blockSize, end = std::min(begin+blockSize,numTriangles);
+      std::swap(plane->triangles[i],plane->triangles[begin+RandomSampler_getUInt(rng)%(end-begin)]);
+    }
+  }
+
+  std::shared_ptr<Scene> scene(new Scene);
+  scene->add(plane);
+  scene->addNullGeometries(16);
+
+  /* a single thread quadifies all triangles in one pass, and worst case sized buffers avoid resumed builds, which skip the quadification */
+  ze_rtas_builder_build_op_stats_desc_t stats = { ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_STATS_DESC };
+  scene->buildQuality = RandomSampler_getUInt(rng) % 3;
+  scene->buildExt = &stats;
+  if (ZeWrapper::zeRTASBuilderSetThreadCount(1) != ZE_RESULT_SUCCESS)
+    throw std::runtime_error("setting builder thread count failed");
+  scene->buildAccel(device,context,BuildMode::BUILD_WORST_CASE_SIZE,false);
+  ZeWrapper::zeRTASBuilderSetThreadCount(0);
+
+  uint32_t numErrors = 0;
+  if (stats.numQuadPairs != numTriangles/2) {
+    std::cout << "quadifier paired " << stats.numQuadPairs << " of " << numTriangles/2 << " triangle pairs" << (testID%2 ? " of shuffled" : " in strip order") << std::endl;
+    numErrors++;
+  }
+  return numErrors + traceBuildTest(device,queue,context,scene,numTriangles);
+}
+
+/* each builder thread quadifies a range of triangles, the pairs across the range borders have to get stitched,
+ * such that multi threaded builds pair all triangles of planes in strip order */
+uint32_t executeQuadStitchingTest(sycl::device& device, sycl::queue& queue, sycl::context& context, uint32_t numPrimitives, int testID)
+{
+  const uint32_t width = (uint32_t)ceilf(sqrtf(0.25f*numPrimitives));
+  const uint32_t numPlaneTriangles = 2*width*width;
+
+  /* the second plane lets task ranges start inside a geometry at any offset */
+  std::shared_ptr<Scene> scene(new Scene);
+  const uint32_t numPlanes = testID%2 ? 2 : 1;
+  for (uint32_t i=0; i<numPlanes; i++)
+  {
+    std::shared_ptr<TriangleMesh> plane = createTrianglePlane(sycl::float3(i*width,0,0), sycl::float3(width,0,0), sycl::float3(0,width,0), width, width);
+    for (size_t j=0; j<plane->triangles.size(); j++)
+      plane->triangles[j].w() += i*numPlaneTriangles;
+    scene->add(plane);
+  }
+  scene->addNullGeometries(16);
+  const uint32_t numTriangles = numPlanes*numPlaneTriangles;
+
+  ze_rtas_builder_build_op_stats_desc_t stats = { ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_STATS_DESC };
+  scene->buildQuality = RandomSampler_getUInt(rng) % 3;
+  scene->buildExt = &stats;
+  if (ZeWrapper::zeRTASBuilderSetThreadCount(16) != ZE_RESULT_SUCCESS)
+    throw std::runtime_error("setting builder thread count failed");
+  scene->buildAccel(device,context,BuildMode::BUILD_WORST_CASE_SIZE,false);
+  ZeWrapper::zeRTASBuilderSetThreadCount(0);
+
+  uint32_t numErrors = 0;
+  if (stats.numQuadPairs != numTriangles/2) {
+    std::cout << "multi threaded quadification paired " << stats.numQuadPairs << " of " << numTriangles/2 << " triangle pairs" << std::endl;
+    numErrors++;
+  }
+  return numErrors + traceBuildTest(device,queue,context,scene,numTriangles);
+}
+
+/* invalid primitives get filtered by compacting the primitive references, which must not disturb the valid ones */
+uint32_t executeCompactPrimRefsTest(sycl::device& device, sycl::queue& queue, sycl::context& context, uint32_t numPrimitives, int testID)
+{
+  std::shared_ptr<Scene> scene = createBuildTestScene(TestType::BUILD_TEST_MIXED,numPrimitives,testID);
+
+  size_t numScenePrimitives = 0;
+  for (uint32_t geomID=0; geomID<scene->size(); geomID++)
+    if ((*scene)[geomID]) numScenePrimitives += (*scene)[geomID]->getNumPrimitives();
+
+  /* meshes below the test rays with a random subset of invalid primitives, their vertices are not shared, thus
+   * none of their triangles get paired */
+  size_t numValidHiddenPrimitives = 0;
+  const uint32_t width = 2*(uint32_t)ceilf(sqrtf(numPrimitives))+1;
+  for (uint32_t i=0; i<4; i++)
+  {
+    std::shared_ptr<TriangleMesh> mesh = createTrianglePlane(sycl::float3(0,0,-8.0f-i), sycl::float3(width,0,0), sycl::float3(0,width,0), width, width);
+    mesh->procedural = i%2;
+    mesh->unshareVertices();
+    for (size_t j=0; j<mesh->size(); j++)
+    {
+      if (j && RandomSampler_getUInt(rng)%2) {
+        numValidHiddenPrimitives++;
+        continue;
+      }
+      /* bounds of procedurals are only invalid if all their vertices are */
+      mesh->vertices[mesh->triangles[j].x()].x() = NAN;
+      mesh->vertices[mesh->triangles[j].y()].x() = NAN;
+      mesh->vertices[mesh->triangles[j].z()].x() = NAN;
+    }
+    scene->addHidden(mesh);
+  }
+
+  ze_rtas_builder_build_op_stats_desc_t stats = { ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_STATS_DESC };
+  scene->buildQuality = RandomSampler_getUInt(rng) % 3;
+  scene->buildExt = &stats;
+  if (ZeWrapper::zeRTASBuilderSetThreadCount(16) != ZE_RESULT_SUCCESS)
+    throw std::runtime_error("setting builder thread count failed");
+  scene->buildAccel(device,context,BuildMode::BUILD_WORST_CASE_SIZE,false);
+  ZeWrapper::zeRTASBuilderSetThreadCount(0);
+
+  uint32_t numErrors = 0;
+  if (!stats.compacted) {
+    std::cout << "invalid primitives got filtered without compaction" << std::endl;
+    numErrors++;
+  }
+  if (stats.numPrimitives != numScenePrimitives+numValidHiddenPrimitives-stats.numQuadPairs) {
+    std::cout << stats.numPrimitives << " primitives left after compaction instead of " << numScenePrimitives+numValidHiddenPrimitives-stats.numQuadPairs << std::endl;
+    numErrors++;
+  }
+  return numErrors + traceBuildTest(device,queue,context,scene,numPrimitives);
+}
+
+/* the builder only serves allocations from per-thread blocks if the buffer also fits the waste of these blocks,
+ * thus builds into any buffer of at least the measured size must not retry, in particular near the smallest
+ * buffer that enables the blocks */
+uint32_t executeThreadBlockTest(sycl::device& device, sycl::queue& queue, sycl::context& context, uint32_t numPrimitives, int testID)
+{
+  std::shared_ptr<Scene> scene = createBuildTestScene(TestType::BUILD_TEST_TRIANGLES,numPrimitives,testID);
+
+  ze_rtas_builder_build_op_stats_desc_t stats = { ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_STATS_DESC };
+  scene->buildQuality = ZE_RTAS_BUILDER_BUILD_QUALITY_HINT_EXP_MEDIUM;
+  scene->buildExt = &stats;
+  if (ZeWrapper::zeRTASBuilderSetThreadCount(8) != ZE_RESULT_SUCCESS)
+    throw std::runtime_error("setting builder thread count failed");
+  scene->buildAccel(device,context,BuildMode::BUILD_MEASURED_SIZE,false);
+  const size_t measuredBytes = scene->accelBytesUsed;
+
+  uint32_t numErrors = 0;
+  auto build = [&] (size_t bytes) -> bool
+  {
+    scene->initialAccelBytes = bytes;
+    scene->buildAccel(device,context,BuildMode::BUILD_EXPECTED_SIZE,false);
+    if (scene->numRetries) {
+      std::cout << "build into " << bytes << " bytes retried, although the measured size is " << measuredBytes << " bytes" << std::endl;
+      numErrors++;
+    }
+    return stats.rtasBytesUnused != 0;
+  };
+
+  /* bisect the smallest buffer that enables the per-thread blocks */
+  size_t lower = measuredBytes, upper = 2*scene->accelBytesWorstCase;
+  if (build(upper))
+  {
+    while (upper-lower > 64) {
+      const size_t middle = (lower+upper)/2;
+      if (build(middle)) upper = middle;
+      else               lower = middle;
+    }
+    build(upper);
+    numErrors += traceBuildTest(device,queue,context,scene,numPrimitives);
+  }
+  build(lower);
+  ZeWrapper::zeRTASBuilderSetThreadCount(0);
+  return numErrors + traceBuildTest(device,queue,context,scene,numPrimitives);
+}
+
+/* high quality builds open each instantiated acceleration structure once for all its instances, thus instances
+ * sharing an acceleration structure have to get opened like instances of separate copies of it */
+uint32_t executeOpenInstancesTest(sycl::device& device, sycl::queue& queue, sycl::context& context, BuildMode buildMode, uint32_t numPrimitives, int testID)
+{
+  std::shared_ptr<Scene> scene = createBuildTestScene(TestType::BUILD_TEST_INSTANCES,numPrimitives,testID);
+
+  ze_rtas_builder_build_op_stats_desc_t stats = { ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_STATS_DESC };
+  ze_rtas_builder_build_op_deterministic_desc_t deterministic = { ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_DETERMINISTIC_DESC };
+  deterministic.pNext = &stats;
+  scene->buildQuality = ZE_RTAS_BUILDER_BUILD_QUALITY_HINT_EXP_HIGH;
+  scene->buildExt = &deterministic;
+  scene->buildAccel(device,context,buildMode,false);
+  uint32_t numErrors = traceBuildTest(device,queue,context,scene,numPrimitives);
+
+  /* keep the instantiated acceleration structures, such that their copies stay equal */
+  std::vector<std::shared_ptr<Scene::InstanceGeometry>> instances;
+  for (uint32_t geomID=0; geomID<scene->size(); geomID++) {
+    if (std::shared_ptr<Scene::InstanceGeometry> instance = std::dynamic_pointer_cast<Scene::InstanceGeometry>((*scene)[geomID])) {
+      instance->scene->keepAccel = true;
+      instances.push_back(instance);
+    }
+  }
+
+  const size_t numGeometries = scene->size();
+  size_t numPrimRefs[2] = { 0, 0 };
+  size_t accelBytesUsed[2] = { 0, 0 };
+  for (size_t copies=0; copies<2; copies++)
+  {
+    scene->geometries.resize(numGeometries);
+    for (size_t i=0; i<std::min(instances.size(),size_t(4)); i++)
+    {
+      const Scene::InstanceGeometry& instance = *instances[i];
+      std::shared_ptr<Scene> instScene = instance.scene;
+      if (copies)
+      {
+        instScene = std::shared_ptr<Scene>(new Scene);
+        instScene->accel = alloc_accel_buffer(instance.scene->accelBytes,device,context);
+        memcpy(instScene->accel,instance.scene->accel,instance.scene->accelBytesUsed);
+        instScene->accelBytes = instance.scene->accelBytes;
+        instScene->accelBytesUsed = instance.scene->accelBytesUsed;
+        instScene->bounds = instance.scene->bounds;
+        instScene->keepAccel = true;
+      }
+
+      /* the scaled instance lies in the plane z=-8 below the test rays, and is large enough to get opened */
+      const float scale = 256.0f;
+      const Transform& xfm = instance.local2world;
+      const sycl::float3 p(scale*xfm.p.x(), scale*xfm.p.y(), scale*xfm.p.z()-8.0f);
+      const Transform local2world(scale*xfm.vx, scale*xfm.vy, scale*xfm.vz, p);
+      scene->geometries.push_back(std::shared_ptr<Geometry>(new HiddenGeometry(std::shared_ptr<Geometry>(new Scene::InstanceGeometry(local2world,instScene,false,instance.instUserID)))));
+    }
+    
+    scene->buildAccel(device,context,buildMode,false);
+    numPrimRefs[copies] = stats.numPrimRefs;
+    accelBytesUsed[copies] = scene->accelBytesUsed;
+    numErrors += traceBuildTest(device,queue,context,scene,numPrimitives);
+  }
+
+  if (numPrimRefs[0] != numPrimRefs[1] || accelBytesUsed[0] != accelBytesUsed[1]) {
+    std::cout << "instances sharing acceleration structures got " << numPrimRefs[0] << " primitive references and " << accelBytesUsed[0] << " bytes, "
+              << "instances of copies " << numPrimRefs[1] << " primitive references and " << accelBytesUsed[1] << " bytes" << std::endl;
+    numErrors++;
+  }
+  return numErrors;
+}
+
+/* skews the plane of the build test scene into long thin triangles along the diagonal, which presplitting splits */
+Transform createSkewTransform()
+{
+  const float c = cosf(0.25f*float(M_PI)), s = sinf(0.25f*float(M_PI));
+  return Transform(sycl::float3(16.0f*c,16.0f*s,0), sycl::float3(-s/16.0f,c/16.0f,0), sycl::float3(0,0,1), sycl::float3(0,0,0));
+}
+
+/* presplitting splits each primitive once into its final sub-primitives, such that the deterministic build
+ * of a scene with long thin triangles does not depend on the number of threads */
+uint32_t executePresplitTest(sycl::device& device, sycl::queue& queue, sycl::context& context, BuildMode buildMode, uint32_t numPrimitives, int testID)
+{
+  std::shared_ptr<Scene> scene = createBuildTestScene(TestType::BUILD_TEST_TRIANGLES,numPrimitives,testID,createSkewTransform());
+
+  ze_rtas_builder_build_op_stats_desc_t stats = { ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_STATS_DESC };
+  ze_rtas_builder_build_op_deterministic_desc_t deterministic = { ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_DETERMINISTIC_DESC };
+  deterministic.pNext = &stats;
+  scene->buildQuality = ZE_RTAS_BUILDER_BUILD_QUALITY_HINT_EXP_HIGH;
+  scene->buildExt = &deterministic;
+  if (ZeWrapper::zeRTASBuilderSetThreadCount(16) != ZE_RESULT_SUCCESS)
+    throw std::runtime_error("setting builder thread count failed");
+  scene->buildAccel(device,context,buildMode,false);
+  const std::vector<char> accel0((char*)scene->getAccel(), (char*)scene->getAccel() + scene->accelBytesUsed);
+
+  uint32_t numErrors = 0;
+  if (stats.numPrimRefs <= stats.numPrimitives && numPrimitives) {
+    std::cout << "presplitting did not split any of " << stats.numPrimitives << " long thin primitives" << std::endl;
+    numErrors++;
+  }
+
+  ZeWrapper::zeRTASBuilderSetThreadCount(1);
+  scene->buildAccel(device,context,buildMode,false);
+  ZeWrapper::zeRTASBuilderSetThreadCount(0);
+
+  if (scene->accelBytesUsed != accel0.size() || memcmp(scene->getAccel(),accel0.data(),accel0.size()) != 0) {
+    std::cout << "presplit build on a single thread differs from the build on 16 threads" << std::endl;
+    numErrors++;
+  }
+  return numErrors + traceBuildTest(device,queue,context,scene,numPrimitives);
+}
+
+/* high quality builds split long thin triangles that cross large parts of a dense plane, on scenes large
+ * enough for the spatial splits to pay off */
+uint32_t executeSpatialSplitTest(sycl::device& device, sycl::queue& queue, sycl::context& context, BuildMode buildMode, uint32_t numPrimitives, int testID)
+{
+  const uint32_t width = (uint32_t) ceilf(sqrtf(0.5f*numPrimitives));
+  std::shared_ptr<TriangleMesh> plane = createTrianglePlane(sycl::float3(0,0,0), sycl::float3(width,0,0), sycl::float3(0,width,0), width, width);
+
+  std::shared_ptr<Scene> scene(new Scene);
+  scene->add(plane);
+
+  /* the test rays start above z=-1, thus never hit this star of thin triangles below the plane */
+  std::shared_ptr<TriangleMesh> star(new TriangleMesh);
+  const uint32_t numStarTriangles = 128;
+  for (uint32_t i=0; i<numStarTriangles; i++)
+  {
+    const float a = float(M_PI)*i/numStarTriangles, c = 0.5f*width, r = 0.5f*width, w = 0.05f;
+    const float dx = cosf(a), dy = sinf(a);
+    const sycl::float3 v0(c-r*dx-w*dy, c-r*dy+w*dx, -4.0f);
+    const sycl::float3 v1(c+r*dx, c+r*dy, -4.0f);
+    const sycl::float3 v2(c-r*dx+w*dy, c-r*dy-w*dx, -4.0f);
+    star->addTriangle(Triangle(v0,v1,v2,i));
+  }
+  scene->addHidden(star);
+  
+  uint32_t numErrors = 0;
+  ze_rtas_builder_build_op_stats_desc_t stats = { ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_STATS_DESC };
+  scene->buildExt = &stats;
+
+  scene->buildQuality = ZE_RTAS_BUILDER_BUILD_QUALITY_HINT_EXP_MEDIUM;
+  scene->buildAccel(device,context,buildMode,false);
+  if (stats.numSpatialSplits != 0) {
+    std::cout << "medium quality build performed " << stats.numSpatialSplits << " spatial splits" << std::endl;
+    numErrors++;
+  }
+
+  scene->buildQuality = ZE_RTAS_BUILDER_BUILD_QUALITY_HINT_EXP_HIGH;
+  scene->buildAccel(device,context,buildMode,false);
+  if (width >= 90 && stats.numSpatialSplits == 0) {
+    std::cout << "no spatial splits of " << numStarTriangles << " thin triangles crossing " << plane->size() << " triangles" << std::endl;
+    numErrors++;
+  }
+  return numErrors + traceBuildTest(device,queue,context,scene,plane->size());
+}
+
+/* the presplit budget depends on the shape of the primitives, well tessellated meshes get no budget */
+uint32_t executePresplitBudgetTest(sycl::device& device, sycl::queue& queue, sycl::context& context, BuildMode buildMode, uint32_t numPrimitives, int testID)
+{
+  uint32_t numErrors = 0;
+  std::shared_ptr<Scene> scene;
+  for (int i=0; i<3; i++)
+  {
+    const bool skewed = i == 2;
+    const ze_rtas_builder_build_quality_hint_exp_t quality = i == 0 ? ZE_RTAS_BUILDER_BUILD_QUALITY_HINT_EXP_MEDIUM : ZE_RTAS_BUILDER_BUILD_QUALITY_HINT_EXP_HIGH;
+    scene = createBuildTestScene(TestType::BUILD_TEST_TRIANGLES,numPrimitives,testID,skewed ? createSkewTransform() : Transform());
+
+    ze_rtas_builder_presplit_properties_t presplit = { ZE_STRUCTURE_TYPE_RTAS_BUILDER_PRESPLIT_PROPERTIES };
+    ze_rtas_builder_build_op_stats_desc_t stats = { ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_STATS_DESC };
+    scene->buildQuality = quality;
+    scene->buildExt = &stats;
+    scene->propertiesExt = &presplit;
+    scene->buildAccel(device,context,buildMode,false);
+
+    if (skewed && numPrimitives && presplit.presplitBudget == 0) {
+      std::cout << "no presplit budget for " << numPrimitives << " long thin triangles" << std::endl;
+      numErrors++;
+    }
+    if (!skewed && presplit.presplitBudget != 0) {
+      std::cout << "presplit budget of " << presplit.presplitBudget << " for " << numPrimitives << " well tessellated triangles" << std::endl;
+      numErrors++;
+    }
+    if (stats.numPrimRefs > stats.numPrimitives + presplit.presplitBudget) {
+      std::cout << "presplitting created " << stats.numPrimRefs << " primitive references for " << stats.numPrimitives << " primitives and a budget of " << presplit.presplitBudget << std::endl;
+      numErrors++;
+    }
+  }
+  return numErrors + traceBuildTest(device,queue,context,scene,numPrimitives);
+}
+
+/* presplitting keeps all its temporary data in the scratch buffer, thus a build with exactly the reported
+ * scratch size has to give the same acceleration structure as a build with a larger scratch buffer */
+uint32_t executePresplitScratchTest(sycl::device& device, sycl::queue& queue, sycl::context& context, BuildMode buildMode, uint32_t numPrimitives, int testID)
+{
+  std::shared_ptr<Scene> scene = createBuildTestScene(TestType::BUILD_TEST_INSTANCES,numPrimitives,testID,createSkewTransform());
+
+  ze_rtas_builder_build_op_deterministic_desc_t deterministic = { ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_DETERMINISTIC_DESC };
+  scene->buildQuality = ZE_RTAS_BUILDER_BUILD_QUALITY_HINT_EXP_HIGH;
+  scene->buildExt = &deterministic;
+  scene->buildAccel(device,context,buildMode,false);
+  const std::vector<char> accel0((char*)scene->getAccel(), (char*)scene->getAccel() + scene->accelBytesUsed);
+
+  /* keep the instantiated acceleration structures, such that the instance addresses stay equal */
+  for (uint32_t geomID=0; geomID<scene->size(); geomID++) {
+    if (std::shared_ptr<Scene::InstanceGeometry> instance = std::dynamic_pointer_cast<Scene::InstanceGeometry>((*scene)[geomID]))
+      instance->scene->keepAccel = true;
+  }
+
+  scene->scratchBytesScale = 2.0;
+  scene->buildAccel(device,context,buildMode,false);
+
+  uint32_t numErrors = 0;
+  if (scene->accelBytesUsed != accel0.size() || memcmp(scene->getAccel(),accel0.data(),accel0.size()) != 0) {
+    std::cout << "presplit build with the reported scratch size differs from the build with a larger scratch buffer" << std::endl;
+    numErrors++;
+  }
+  return numErrors + traceBuildTest(device,queue,context,scene,numPrimitives);
+}
+
+/* duplicated triangles cannot get split by the SAH, thus the builder sorts them into a deterministic order
+ * and splits them in the middle, which has to give the same result however the node children got split concurrently */
+uint32_t executeFallbackSplitTest(sycl::device& device, sycl::queue& queue, sycl::context& context, BuildMode buildMode, uint32_t numPrimitives, int testID)
+{
+  std::shared_ptr<Scene> scene = createBuildTestScene(TestType::BUILD_TEST_TRIANGLES,numPrimitives,testID);
+
+  /* the test rays start above z=-1, thus never hit these triangles below the plane */
+  std::shared_ptr<TriangleMesh> duplicates = createTrianglePlane(sycl::float3(0,0,-8), sycl::float3(1,0,0), sycl::float3(0,1,0), 1, 1);
+  for (uint32_t i=0; i<4096; i++)
+    duplicates->addTriangle(duplicates->getTriangle(0));
+  scene->addHidden(duplicates);
+
+  ze_rtas_builder_build_op_deterministic_desc_t deterministic = { ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_DETERMINISTIC_DESC };
+  scene->buildQuality = ZE_RTAS_BUILDER_BUILD_QUALITY_HINT_EXP_MEDIUM;
+  scene->buildExt = &deterministic;
+  if (ZeWrapper::zeRTASBuilderSetThreadCount(16) != ZE_RESULT_SUCCESS)
+    throw std::runtime_error("setting builder thread count failed");
+  scene->buildAccel(device,context,buildMode,false);
+  const std::vector<char> accel0((char*)scene->getAccel(), (char*)scene->getAccel() + scene->accelBytesUsed);
+
+  ZeWrapper::zeRTASBuilderSetThreadCount(1);
+  scene->buildAccel(device,context,buildMode,false);
+  ZeWrapper::zeRTASBuilderSetThreadCount(0);
+
+  uint32_t numErrors = 0;
+  if (scene->accelBytesUsed != accel0.size() || memcmp(scene->getAccel(),accel0.data(),accel0.size()) != 0) {
+    std::cout << "fallback splits of duplicated triangles depend on the number of threads" << std::endl;
+    numErrors++;
+  }
+  return numErrors + traceBuildTest(device,queue,context,scene,numPrimitives);
+}
+
+/* the statistics of a build have to be consistent with the scene and with the returned acceleration structure size */
+uint32_t executeStatsTest(sycl::device& device, sycl::queue& queue, sycl::context& context, uint32_t numPrimitives, int testID)
+{
+  std::shared_ptr<Scene> scene = createBuildTestScene(TestType::BUILD_TEST_MIXED,numPrimitives,testID);
+
+  /* worst case sized buffers, such that the build never retries */
+  ze_rtas_builder_build_op_stats_desc_t stats = { ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_STATS_DESC };
+  scene->buildQuality = RandomSampler_getUInt(rng) % 3;
+  scene->buildExt = &stats;
+  scene->buildAccel(device,context,BuildMode::BUILD_WORST_CASE_SIZE,false);
+
+  /* instances count as a single primitive */
+  size_t numScenePrimitives = 0;
+  for (uint32_t geomID=0; geomID<scene->size(); geomID++)
+    if ((*scene)[geomID]) numScenePrimitives += (*scene)[geomID]->getNumPrimitives();
+
+  uint32_t numErrors = 0;
+  if (stats.numPrimitives+stats.numQuadPairs != numScenePrimitives) {
+    std::cout << stats.numPrimitives << " primitives and " << stats.numQuadPairs << " quad pairs reported for " << numScenePrimitives << " primitives" << std::endl;
+    numErrors++;
+  }
+  if (stats.numPrimRefs < stats.numPrimitives) {
+    std::cout << "presplitting reduced " << stats.numPrimitives << " primitives to " << stats.numPrimRefs << " primitive references" << std::endl;
+    numErrors++;
+  }
+  if (stats.numSpatialSplits && scene->buildQuality != ZE_RTAS_BUILDER_BUILD_QUALITY_HINT_EXP_HIGH) {
+    std::cout << stats.numSpatialSplits << " spatial splits reported for a build that is not of high quality" << std::endl;
+    numErrors++;
+  }
+  if (stats.rtasBytesAllocated != scene->accelBytesUsed || stats.rtasBytesUnused > stats.rtasBytesAllocated) {
+    std::cout << stats.rtasBytesAllocated << " allocated and " << stats.rtasBytesUnused << " unused bytes reported for an acceleration structure of " << scene->accelBytesUsed << " bytes" << std::endl;
+    numErrors++;
+  }
+
+  const uint64_t phaseNs = stats.quadificationNs + stats.primRefGenNs + stats.primRefCompactNs + stats.presplitNs + stats.bvhBuildNs + stats.optimizeNs + stats.layoutNs + stats.cacheNs;
+  if (phaseNs > stats.totalNs) {
+    std::cout << "build phases took " << phaseNs << "ns but the whole build only " << stats.totalNs << "ns" << std::endl;
+    numErrors++;
+  }
+
+  /* the scene has no invalid primitives, and the build neither resumed nor used the cache */
+  if (stats.compacted || stats.resumed || stats.cacheHit) {
+    std::cout << "build reported compaction, resume, or cache hit" << std::endl;
+    numErrors++;
+  }
+  return numErrors + traceBuildTest(device,queue,context,scene,numPrimitives);
+}
+
+/* the builder keeps its temporary buffers across builds, thus alternating and concurrent builds of
+ * differently sized scenes must not interfere with each other */
+uint32_t executeArenaTest(sycl::device& device, sycl::queue& queue, sycl::context& context, BuildMode buildMode, uint32_t numPrimitives, int testID)
+{
+  const uint32_t numScenePrimitives[] = { numPrimitives, numPrimitives/4, numPrimitives/2, numPrimitives/16 };
+  const size_t numScenes = sizeof(numScenePrimitives)/sizeof(numScenePrimitives[0]);
+
+  /* low quality builds use the Morton code buffers and the other builds the quadification tables */
+  std::vector<std::shared_ptr<Scene>> scenes;
+  for (size_t i=0; i<numScenes; i++) {
+    const TestType test = i%2 ? TestType::BUILD_TEST_PROCEDURALS : TestType::BUILD_TEST_TRIANGLES;
+    scenes.push_back(createBuildTestScene(test,numScenePrimitives[i],testID+(int)i));
+    scenes.back()->buildQuality = (testID+i)%3;
+  }
+
+  uint32_t numErrors = 0;
+  for (size_t i=0; i<numScenes; i++) {
+    scenes[i]->buildAccel(device,context,buildMode,false);
+    numErrors += traceBuildTest(device,queue,context,scenes[i],numScenePrimitives[i]);
+  }
+
+  /* all builds share the same parallel operation, thus can only run concurrently without one */
+  if (parallelOperation)
+    return numErrors;
+  
+  tbb::parallel_for(size_t(0), numScenes, [&](size_t i) {
+    scenes[i]->buildAccel(device,context,buildMode,false);
+  });
+  for (size_t i=0; i<numScenes; i++)
+    numErrors += traceBuildTest(device,queue,context,scenes[i],numScenePrimitives[i]);
+  return numErrors;
+}
+
+/* the vectorized Morton code kernels of low quality builds process the primitives in blocks, thus the number
+ * of primitives varies to cover every block remainder, and a wrong remainder changes the deterministic build
+ * whose ranges differ between thread counts */
+uint32_t executeMortonRemainderTest(sycl::device& device, sycl::queue& queue, sycl::context& context, BuildMode buildMode, uint32_t numPrimitives, int testID)
+{
+  numPrimitives += testID%16;
+  const TestType test = testID%2 ? TestType::BUILD_TEST_PROCEDURALS : TestType::BUILD_TEST_TRIANGLES;
+  std::shared_ptr<Scene> scene = createBuildTestScene(test,numPrimitives,testID);
+
+  ze_rtas_builder_build_op_deterministic_desc_t deterministic = { ZE_STRUCTURE_TYPE_RTAS_BUILDER_BUILD_OP_DETERMINISTIC_DESC };
+  scene->buildQuality = ZE_RTAS_BUILDER_BUILD_QUALITY_HINT_EXP_LOW;
+  scene->buildExt = &deterministic;
+  scene->buildAccel(device,context,buildMode,false);
+  const std::vector<char> accel0((char*)scene->getAccel(), (char*)scene->getAccel() + scene->accelBytesUsed);
+
+  if (ZeWrapper::zeRTASBuilderSetThreadCount(1) != ZE_RESULT_SUCCESS)
+    throw std::runtime_error("setting builder thread count failed");
+  scene->buildAccel(device,context,buildMode,false);
+  ZeWrapper::zeRTASBuilderSetThreadCount(0);
+
+  uint32_t numErrors = 0;
+  if (scene->accelBytesUsed != accel0.size() || memcmp(scene->getAccel(),accel0.data(),accel0.size()) != 0) {
+    std::cout << "low quality build of " << numPrimitives << " primitives depends on the number of threads" << std::endl;
+    numErrors++;
+  }
+  return numErrors + traceBuildTest(device,queue,context,scene,numPrimitives);
+}
+
+/* low quality builds sort the primitives by Morton codes, a far away geometry lets many primitives of
+ * the traced scene share their code */
+uint32_t executeMortonTest(sycl::device& device, sycl::queue& queue, sycl::context& context, BuildMode buildMode, uint32_t numPrimitives, int testID)
+{
+  std::shared_ptr<Scene> scene = createBuildTestScene(TestType::BUILD_TEST_MIXED,numPrimitives,testID);
+
+  /* the test rays start above z=-1 and inside the plane, thus never hit this geometry */
+  std::shared_ptr<TriangleMesh> far = createTrianglePlane(sycl::float3(-8192,-8192,-8192), sycl::float3(4,0,0), sycl::float3(0,4,0), 4, 4);
+  far->procedural = testID%2;
+
+  /* duplicated triangles have equal Morton codes */
+  for (uint32_t i=0; i<64; i++)
+    far->addTriangle(far->getTriangle(0));
+  scene->addHidden(far);
+  
+  scene->buildQuality = ZE_RTAS_BUILDER_BUILD_QUALITY_HINT_EXP_LOW;
+  scene->buildAccel(device,context,buildMode,false);
+  return traceBuildTest(device,queue,context,scene,numPrimitives);
+}
+
+/* procedurals get their bounds queried in blocks of consecutive primitives, where each pass over the
+ * primitives queries every primitive exactly once */
+uint32_t executeProceduralBatchTest(sycl::device& device, sycl::queue& queue, sycl::context& context, BuildMode buildMode, uint32_t numPrimitives, int testID)
+{
+  const size_t blockSize = 256; // maximal number of primitives the builder queries per callback
+  
+  std::shared_ptr<Scene> scene = createBuildTestScene(TestType::BUILD_TEST_PROCEDURALS,numPrimitives,testID);
+
+  std::vector<std::shared_ptr<BoundsQueryCounter>> counters;
+  for (uint32_t geomID=0; geomID<scene->size(); geomID++) {
+    if (std::shared_ptr<TriangleMesh> mesh = std::dynamic_pointer_cast<TriangleMesh>((*scene)[geomID])) {
+      counters.push_back(std::make_shared<BoundsQueryCounter>(mesh->size()));
+      mesh->boundsQueries = counters.back().get();
+    }
+  }
+
+  /* a single thread queries the primitives of each geometry in consecutive blocks */
+  if (ZeWrapper::zeRTASBuilderSetThreadCount(1) != ZE_RESULT_SUCCESS)
+    throw std::runtime_error("setting builder thread count failed");
+  scene->buildAccel(device,context,buildMode,false);
+  ZeWrapper::zeRTASBuilderSetThreadCount(0);
+
+  uint32_t passes = 0;
+  for (auto& counter : counters) {
+    if (counter->primitives.size()) {
+      passes = counter->primitives[0];
+      break;
+    }
+  }
+
+  uint32_t numErrors = 0;
+  if (numPrimitives && passes == 0) {
+    std::cout << "bounds of procedurals never got queried" << std::endl;
+    numErrors++;
+  }
+  
+  size_t numCallbacks = 0, expectedCallbacks = 0;
+  for (auto& counter : counters)
+  {
+    if (counter->invalidRanges) {
+      std::cout << counter->invalidRanges << " bounds callbacks queried an invalid primitive range" << std::endl;
+      numErrors++;
+    }
+    for (size_t primID=0; primID<counter->primitives.size(); primID++) {
+      if (counter->primitives[primID] == passes) continue;
+      std::cout << "bounds of procedural " << primID << " got queried " << counter->primitives[primID] << " times instead of " << passes << " times" << std::endl;
+      numErrors++;
+      break;
+    }
+    numCallbacks += counter->callbacks;
+    expectedCallbacks += passes*((counter->primitives.size()+blockSize-1)/blockSize);
+  }
+  if (numCallbacks != expectedCallbacks) {
+    std::cout << "bounds callback got invoked " << numCallbacks << " times instead of " << expectedCallbacks << " times" << std::endl;
+    numErrors++;
+  }
+  return numErrors + traceBuildTest(device,queue,context,scene,numPrimitives);
+}
+
+uint32_t executeBuildTest(sycl::device& device, sycl::queue& queue, sycl::context& context, TestType test, BuildMode buildMode, uint32_t numPrimitives, int testID)
+{
+  switch (test) {
+  default: break;
+  case TestType::BUILD_TEST_COMPACT: return executeCompactTest(device,queue,context,buildMode,numPrimitives,testID);
+  case TestType::BUILD_TEST_REFIT  : return executeRefitTest  (device,queue,context,buildMode,numPrimitives,testID);
+  case TestType::BUILD_TEST_RESUME : return executeResumeTest (device,queue,context,numPrimitives,testID);
+  case TestType::BUILD_TEST_BATCH  : return executeBatchTest  (device,queue,context,buildMode,numPrimitives,testID);
+  case TestType::BUILD_TEST_LAYOUT : return executeLayoutTest (device,queue,context,buildMode,numPrimitives,testID);
+  case TestType::BUILD_TEST_DETERMINISTIC: return executeDeterministicTest(device,queue,context,buildMode,numPrimitives,testID);
+  case TestType::BUILD_TEST_CACHE  : return executeCacheTest  (device,queue,context,buildMode,numPrimitives,testID);
+  case TestType::BUILD_TEST_CACHE_INSTANCES: return executeCacheInstancesTest(device,queue,context,numPrimitives,testID);
+  case TestType::BUILD_TEST_TREELET: return executeTreeletTest(device,queue,context,buildMode,numPrimitives,testID);
+  case TestType::BUILD_TEST_RELOCATE: return executeRelocateTest(device,queue,context,buildMode,numPrimitives,testID);
+  case TestType::BUILD_TEST_PROCEDURAL_BATCH: return executeProceduralBatchTest(device,queue,context,buildMode,numPrimitives,testID);
+  case TestType::BUILD_TEST_MORTON: return executeMortonTest(device,queue,context,buildMode,numPrimitives,testID);
+  case TestType::BUILD_TEST_ARENA: return executeArenaTest(device,queue,context,buildMode,numPrimitives,testID);
+  case TestType::BUILD_TEST_STATS: return executeStatsTest(device,queue,context,numPrimitives,testID);
+  case TestType::BUILD_TEST_MORTON_REMAINDER: return executeMortonRemainderTest(device,queue,context,buildMode,numPrimitives,testID);
+  case TestType::BUILD_TEST_QUAD_PAIRING: return executeQuadPairingTest(device,queue,context,numPrimitives,testID);
+  case TestType::BUILD_TEST_QUAD_STITCHING: return executeQuadStitchingTest(device,queue,context,numPrimitives,testID);
+  case TestType::BUILD_TEST_COMPACT_PRIMREFS: return executeCompactPrimRefsTest(device,queue,context,numPrimitives,testID);
+  case TestType::BUILD_TEST_THREAD_BLOCKS: return executeThreadBlockTest(device,queue,context,numPrimitives,testID);
+  case TestType::BUILD_TEST_OPEN_INSTANCES: return executeOpenInstancesTest(device,queue,context,buildMode,numPrimitives,testID);
+  case TestType::BUILD_TEST_PRESPLIT: return executePresplitTest(device,queue,context,buildMode,numPrimitives,testID);
+  case TestType::BUILD_TEST_PRESPLIT_SCRATCH: return executePresplitScratchTest(device,queue,context,buildMode,numPrimitives,testID);
+  case TestType::BUILD_TEST_PRESPLIT_BUDGET: return executePresplitBudgetTest(device,queue,context,buildMode,numPrimitives,testID);
+  case TestType::BUILD_TEST_SPATIAL_SPLITS: return executeSpatialSplitTest(device,queue,context,buildMode,numPrimitives,testID);
+  case TestType::BUILD_TEST_FALLBACK_SPLITS: return executeFallbackSplitTest(device,queue,context,buildMode,numPrimitives,testID);
+  };
+  
+  std::shared_ptr<Scene> scene = createBuildTestScene(test,numPrimitives,testID);
+  scene->buildAccel(device,context,buildMode,false);
+  return traceBuildTest(device,queue,context,scene,numPrimitives);
+}
+
+uint32_t executeBuildTest(sycl::device& device, sycl::queue& queue, sycl::context& context, TestType test, BuildMode buildMode)
+{
+  uint32_t numErrors = 0;
+  for (uint32_t i=0; i<128; i++) {
+
+    const uint32_t numPrimitives = i>10 ? i*i : i;
+    std::cout << "testing " << numPrimitives << " primitives" << std::endl;
+    numErrors += executeBuildTest(device,queue,context,test,buildMode,numPrimitives,i);
+  }
+  return numErrors;
+}
+
+uint32_t executeBenchmark(sycl::device& device, sycl::queue& queue, sycl::context& context, TestType test)
+{
+  for (uint32_t i=0; i<=20; i++)
+  {
+    const uint32_t numPrimitives = 1<<i;
+
+    switch (test) {
+    default: break;
+    case TestType::BENCHMARK_TRIANGLES  : std::cout << "benchmarking " << numPrimitives << " triangles: "; break;
+    case TestType::BENCHMARK_PROCEDURALS: std::cout << "benchmarking " << numPrimitives << " procedurals: "; break;
+    };
+
+    const uint32_t width = 2*(uint32_t)ceilf(sqrtf(numPrimitives));
+    std::shared_ptr<TriangleMesh> plane = createTrianglePlane(sycl::float3(0,0,0), sycl::float3(width,0,0), sycl::float3(0,width,0), width, width);
+    if (test == TestType::BENCHMARK_PROCEDURALS) plane->procedural = true;
+    plane->selectSequential(numPrimitives);
+    
+    std::shared_ptr<Scene> scene(new Scene);
+    scene->add(plane);
+    
+    scene->buildAccel(device,context,BuildMode::BUILD_WORST_CASE_SIZE,true);
+  }
+  return 0;
+}
+
+enum Flags : uint32_t {
+  FLAGS_NONE,
+  DEPTH_TEST_LESS_EQUAL = 1 << 0  // when set we use <= for depth test, otherwise <
+};
+
+struct DispatchGlobals
+{
+  uint64_t rtMemBasePtr;               // base address of the allocated stack memory
+  uint64_t callStackHandlerKSP;             // this is the KSP of the continuation handler that is invoked by BTD when the read KSP is 0
+  uint32_t asyncStackSize;             // async-RT stack size in 64 byte blocks
+  uint32_t numDSSRTStacks : 16;        // number of stacks per DSS
+  uint32_t syncRayQueryCount : 4;      // number of ray queries in the sync-RT stack: 0-15 mapped to: 1-16
+  unsigned _reserved_mbz : 12;
+  uint32_t maxBVHLevels;               // the maximal number of supported instancing levels (0->8, 1->1, 2->2, ...)
+  Flags flags;                         // per context control flags
+};
+
+void* allocDispatchGlobals(sycl::device device, sycl::context context)
+{
+  size_t maxBVHLevels = 2; //RTC_MAX_INSTANCE_LEVEL_COUNT+1;
+  
+  size_t rtstack_bytes = (64+maxBVHLevels*(64+32)+63)&-64;
+  size_t num_rtstacks = 1<<17; // this is sufficiently large also for PVC
+  size_t dispatchGlobalSize = 128+num_rtstacks*rtstack_bytes;
+  
+  void* dispatchGlobalsPtr = alloc_accel_buffer(dispatchGlobalSize,device,context);
+  memset(dispatchGlobalsPtr, 0, dispatchGlobalSize);
+
+  DispatchGlobals* dg = (DispatchGlobals*) dispatchGlobalsPtr;
+  dg->rtMemBasePtr = (uint64_t) dispatchGlobalsPtr + dispatchGlobalSize;
+  dg->callStackHandlerKSP = 0;
+  dg->asyncStackSize = 0;
+  dg->numDSSRTStacks = 0;
+  dg->syncRayQueryCount = 0;
+  dg->_reserved_mbz = 0;
+  dg->maxBVHLevels = maxBVHLevels;
+  dg->flags = DEPTH_TEST_LESS_EQUAL;
+  
+  return dispatchGlobalsPtr;
+}
+
+int main(int argc, char* argv[]) try
+{
+  TestType test = TestType::TRIANGLES_COMMITTED_HIT;
+  InstancingType inst = InstancingType::NONE;
+  BuildMode buildMode = BuildMode::BUILD_EXPECTED_SIZE;
+  ZeWrapper::RTAS_BUILD_MODE rtas_build_mode = ZeWrapper::RTAS_BUILD_MODE::LEVEL_ZERO;
+  
+  bool jit_cache = false;
+  uint32_t numThreads = tbb::this_task_arena::max_concurrency();
   
   /* command line parsing */
   if (argc == 1) {
@@ -2114,6 +3444,81 @@ int main(int argc, char* argv[]) try
     else if (strcmp(argv[i], "--build_test_mixed") == 0) {
       test = TestType::BUILD_TEST_MIXED;
     }
+    else if (strcmp(argv[i], "--build_test_compact") == 0) {
+      test = TestType::BUILD_TEST_COMPACT;
+    }
+    else if (strcmp(argv[i], "--build_test_refit") == 0) {
+      test = TestType::BUILD_TEST_REFIT;
+    }
+    else if (strcmp(argv[i], "--build_test_resume") == 0) {
+      test = TestType::BUILD_TEST_RESUME;
+    }
+    else if (strcmp(argv[i], "--build_test_batch") == 0) {
+      test = TestType::BUILD_TEST_BATCH;
+    }
+    else if (strcmp(argv[i], "--build_test_layout") == 0) {
+      test = TestType::BUILD_TEST_LAYOUT;
+    }
+    else if (strcmp(argv[i], "--build_test_deterministic") == 0) {
+      test = TestType::BUILD_TEST_DETERMINISTIC;
+    }
+    else if (strcmp(argv[i], "--build_test_cache") == 0) {
+      test = TestType::BUILD_TEST_CACHE;
+    }
+    else if (strcmp(argv[i], "--build_test_cache_instances") == 0) {
+      test = TestType::BUILD_TEST_CACHE_INSTANCES;
+    }
+    else if (strcmp(argv[i], "--build_test_treelet") == 0) {
+      test = TestType::BUILD_TEST_TREELET;
+    }
+    else if (strcmp(argv[i], "--build_test_relocate") == 0) {
+      test = TestType::BUILD_TEST_RELOCATE;
+    }
+    else if (strcmp(argv[i], "--build_test_procedural_batch") == 0) {
+      test = TestType::BUILD_TEST_PROCEDURAL_BATCH;
+    }
+    else if (strcmp(argv[i], "--build_test_morton") == 0) {
+      test = TestType::BUILD_TEST_MORTON;
+    }
+    else if (strcmp(argv[i], "--build_test_arena") == 0) {
+      test = TestType::BUILD_TEST_ARENA;
+    }
+    else if (strcmp(argv[i], "--build_test_stats") == 0) {
+      test = TestType::BUILD_TEST_STATS;
+    }
+    else if (strcmp(argv[i], "--build_test_morton_remainder") == 0) {
+      test = TestType::BUILD_TEST_MORTON_REMAINDER;
+    }
+    else if (strcmp(argv[i], "--build_test_quad_pairing") == 0) {
+      test = TestType::BUILD_TEST_QUAD_PAIRING;
+    }
+    else if (strcmp(argv[i], "--build_test_quad_stitching") == 0) {
+      test = TestType::BUILD_TEST_QUAD_STITCHING;
+    }
+    else if (strcmp(argv[i], "--build_test_compact_primrefs") == 0) {
+      test = TestType::BUILD_TEST_COMPACT_PRIMREFS;
+    }
+    else if (strcmp(argv[i], "--build_test_thread_blocks") == 0) {
+      test = TestType::BUILD_TEST_THREAD_BLOCKS;
+    }
+    else if (strcmp(argv[i], "--build_test_open_instances") == 0) {
+      test = TestType::BUILD_TEST_OPEN_INSTANCES;
+    }
+    else if (strcmp(argv[i], "--build_test_presplit") == 0) {
+      test = TestType::BUILD_TEST_PRESPLIT;
+    }
+    else if (strcmp(argv[i], "--build_test_presplit_scratch") == 0) {
+      test = TestType::BUILD_TEST_PRESPLIT_SCRATCH;
+    }
+    else if (strcmp(argv[i], "--build_test_presplit_budget") == 0) {
+      test = TestType::BUILD_TEST_PRESPLIT_BUDGET;
+    }
+    else if (strcmp(argv[i], "--build_test_spatial_splits") == 0) {
+      test = TestType::BUILD_TEST_SPATIAL_SPLITS;
+    }
+    else if (strcmp(argv[i], "--build_test_fallback_splits") == 0) {
+      test = TestType::BUILD_TEST_FALLBACK_SPLITS;
+    }
     else if (strcmp(argv[i], "--benchmark_triangles") == 0) {
       test = TestType::BENCHMARK_TRIANGLES;
     }
@@ -2135,6 +3540,9 @@ int main(int argc, char* argv[]) try
     else if (strcmp(argv[i], "--build_mode_expected") == 0) {
       buildMode = BuildMode::BUILD_EXPECTED_SIZE;
     }
+    else if (strcmp(argv[i], "--build_mode_measured") == 0) {
+      buildMode = BuildMode::BUILD_MEASURED_SIZE;
+    }
     else if (strcmp(argv[i], "--jit-cache") == 0) {
       if (++i >= argc) throw std::runtime_error("Error: --jit-cache <int>: syntax error");
       jit_cache = atoi(argv[i]);